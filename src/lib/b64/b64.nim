@@ -0,0 +1,287 @@
+# -*- nim -*-
+#
+# $Id$
+#
+# Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+# All rights reserved.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# The author or authors of this code dedicate any and all copyright interest
+# in this code to the public domain. We make this dedication for the benefit
+# of the public at large and to the detriment of our heirs and successors.
+# We intend this dedication to be an overt act of relinquishment in
+# perpetuity of all present and future rights to this code under copyright
+# law.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+## Base64 codec with SSSE3 and AVX2 kernels (see cpu module for the run
+## time selection.) The encoder writes lines of b64LineLen characters
+## separated by CRLF, without a line break at the end. The decoder skips
+## everything outside the base64 alphabet, and padding may appear between
+## chunks of a text.
+##
+## The streaming functions keep an incomplete triplet or quad in a
+## B64State, so a text can be processed in parts of any size.
+
+import
+  cpu  / [cpu],
+  misc / [prjcfg]
+
+const
+  b64Header = "private/b64_codec.h".nimSrcDirname
+  b64Cflags = "-I " & "private".nimSrcDirname &
+              " -I " & "../cpu/private".nimSrcDirname
+
+{.passC: b64Cflags.}
+{.compile: "private/b64_codec.c".nimSrcDirname.}
+
+const
+  b64LineLen* = 76                   ## characters per encoded line
+
+type
+  B64State* = tuple                  ## streaming state, all zero to start
+    carry:  array[4,uint8]           # bytes or sextets not processed, yet
+    nCarry: uint32
+    col:    uint32                   # characters on current output line
+
+# ----------------------------------------------------------------------------
+# Interface b64_codec
+# ----------------------------------------------------------------------------
+
+# Encode n bytes, up to two bytes are kept in the state for the next call.
+#
+#   st -- state
+#   o  -- output buffer
+#   i  -- input data
+#   n  -- length of input data
+#
+proc b64_encode(st: ptr B64State; o, i: pointer; n: csize): csize
+  {.cdecl, header: b64Header, importc.}
+
+# Same as b64_encode() for the input XORed with a key stream.
+#
+#   st -- state
+#   o  -- output buffer
+#   i  -- input data
+#   k  -- key stream, same length as input data
+#   n  -- length of input data
+#
+proc b64_encode_xor(st: ptr B64State; o, i, k: pointer; n: csize): csize
+  {.cdecl, header: b64Header, importc.}
+
+# Write padded quad for the bytes kept in the state and reset the state.
+#
+#   st -- state
+#   o  -- output buffer, at least 6 characters
+#
+proc b64_encode_done(st: ptr B64State; o: pointer): csize
+  {.cdecl, header: b64Header, importc.}
+
+# Decode n characters, an incomplete quad is kept in the state.
+#
+#   st -- state
+#   o  -- output buffer
+#   i  -- input characters
+#   n  -- number of input characters
+#
+proc b64_decode(st: ptr B64State; o, i: pointer; n: csize): csize
+  {.cdecl, header: b64Header, importc.}
+
+# Write the bytes of an unpadded quad kept in the state and reset the state.
+#
+#   st -- state
+#   o  -- output buffer, at least 2 bytes
+#
+proc b64_decode_done(st: ptr B64State; o: pointer): csize
+  {.cdecl, header: b64Header, importc.}
+
+# Bind the kernels to the best ones supported by the CPU
+proc b64_dispatch_init()
+  {.cdecl, header: b64Header, importc.}
+
+# Name of the kernels bound
+proc b64_kernel_name(): cstring
+  {.cdecl, header: b64Header, importc.}
+
+# ----------------------------------------------------------------------------
+# Public functions
+# ----------------------------------------------------------------------------
+
+proc b64EncodeLen*(n: int): int =
+  ## the number of characters b64Encode() produces for n bytes, an upper
+  ## bound for b64Encode() followed by b64EncodeDone() on a fresh state
+  if 0 < n:
+    let q = (n + 2) div 3
+    result = 4 * q + 2 * ((q - 1) div (b64LineLen div 4))
+
+proc b64DecodeLen*(n: int): int =
+  ## an upper bound for the number of bytes b64Decode() produces for n
+  ## characters
+  if 0 < n:
+    result = 3 * ((n + 3) div 4)
+
+proc b64Encode*(st: var B64State; dst, src: pointer; n: int): int {.inline.} =
+  ## Encode n bytes at src into dst, up to two bytes are kept in st for the
+  ## next call. A line break is inserted before a quad that would exceed
+  ## b64LineLen columns. Returns the number of characters written, at most
+  ## b64EncodeLen(n + 2).
+  b64_encode(addr st, dst, src, n.csize).int
+
+proc b64EncodeXor*(st: var B64State;
+                   dst, src, key: pointer; n: int): int {.inline.} =
+  ## Same as b64Encode() for the n bytes at src XORed with the n bytes at
+  ## key, typically a cipher key stream. So cipher text is encoded on the
+  ## fly without being stored.
+  b64_encode_xor(addr st, dst, src, key, n.csize).int
+
+proc b64EncodeDone*(st: var B64State; dst: pointer): int {.inline.} =
+  ## Write the padded quad for the bytes kept in st (at most 6 characters)
+  ## and reset st. Returns the number of characters written.
+  b64_encode_done(addr st, dst).int
+
+proc b64Decode*(st: var B64State; dst, src: pointer; n: int): int {.inline.} =
+  ## Decode n characters at src into dst, an incomplete quad is kept in st
+  ## for the next call. Returns the number of bytes written, at most
+  ## b64DecodeLen(n + 3).
+  b64_decode(addr st, dst, src, n.csize).int
+
+proc b64DecodeDone*(st: var B64State; dst: pointer): int {.inline.} =
+  ## Write the bytes of an unpadded quad kept in st (at most 2 bytes) and
+  ## reset st. Returns the number of bytes written.
+  b64_decode_done(addr st, dst).int
+
+proc b64Encode*(dst, src: pointer; n: int): int =
+  ## Encode n bytes at src as a complete text into dst, returns the number
+  ## of characters written, i.e. b64EncodeLen(n)
+  var st: B64State
+  result = st.b64Encode(dst, src, n)
+  result += st.b64EncodeDone(cast[pointer](cast[ByteAddress](dst) + result))
+
+proc b64Decode*(dst, src: pointer; n: int): int =
+  ## Decode n characters at src as a complete text into dst, returns the
+  ## number of bytes written, at most b64DecodeLen(n)
+  var st: B64State
+  result = st.b64Decode(dst, src, n)
+  result += st.b64DecodeDone(cast[pointer](cast[ByteAddress](dst) + result))
+
+proc b64Encode*(s: string): string =
+  ## base64 encode the argument string
+  result = newString(b64EncodeLen(s.len))
+  if 0 < s.len:
+    discard b64Encode(addr result[0], unsafeAddr s[0], s.len)
+
+proc b64Decode*(s: string): string =
+  ## base64 decode the argument string
+  result = newString(b64DecodeLen(s.len))
+  if 0 < s.len:
+    result.setLen(b64Decode(addr result[0], unsafeAddr s[0], s.len))
+
+proc b64Kernel*(): string {.inline.} =
+  ## Name of the kernels used, one of "scalar", "ssse3", or "avx2"
+  $b64_kernel_name()
+
+# ----------------------------------------------------------------------------
+# Initialisation
+# ----------------------------------------------------------------------------
+
+b64_dispatch_init() # bind kernels before any threads are started
+
+# ----------------------------------------------------------------------------
+# Tests
+# ----------------------------------------------------------------------------
+
+when isMainModule:
+
+  import
+    base64, strutils
+
+  if true: # same layout as in the C structure
+    var
+      st: B64State
+      a = cast[int](addr st)
+      varB64Carry {.
+        importc: "offsetof(b64_state_t, carry)", header: b64Header.}: int
+      varB64NCarry {.
+        importc: "offsetof(b64_state_t, ncarry)", header: b64Header.}: int
+      varB64Col {.
+        importc: "offsetof(b64_state_t, col)", header: b64Header.}: int
+      varB64StateSizeof {.
+        importc: "sizeof(b64_state_t)", header: b64Header.}: int
+    doAssert varB64Carry       == (cast[int](addr st.carry)  - a)
+    doAssert varB64NCarry      == (cast[int](addr st.nCarry) - a)
+    doAssert varB64Col         == (cast[int](addr st.col)    - a)
+    doAssert varB64StateSizeof == st.sizeof
+
+  if true: # all kernels agree with the stdlib module
+    var data = newString(3 * 1000 + 2)
+    for n in 0..<data.len:
+      data[n] = ((n * 7 + n div 5) and 255).chr
+
+    for level in ["scalar", "ssse3", "avx2"]:
+      cpuSelect(level)
+      when not defined(check_run):
+        echo ">>> kernel ", level, " -> ", b64Kernel()
+
+      for n in [0, 1, 2, 3, 56, 57, 58, 100, 456, 1000, data.len]:
+        let
+          s = data[0..<n]
+          e = s.b64Encode
+        doAssert e.len == b64EncodeLen(n)
+        doAssert e == s.encode.strip
+        doAssert e.b64Decode == s
+        doAssert e.replace("\r\l", "\l \t").b64Decode == s
+
+      # streaming in odd sized parts
+      var
+        st: B64State
+        e = newString(b64EncodeLen(data.len))
+        d = newString(data.len + 3)
+        r = 0
+        pos = 0
+      for n in [1, 5, 0, 100, 2, 3, 4000]:
+        let k = max(0, min(n, data.len - pos))
+        r += st.b64Encode(addr e[r], addr data[pos], k)
+        pos += k
+      r += st.b64EncodeDone(addr e[r])
+      doAssert r == e.len
+      doAssert e == data.b64Encode
+
+      r = 0
+      pos = 0
+      for n in [7, 1, 77, 2, 2, 6000]:
+        let k = max(0, min(n, e.len - pos))
+        r += st.b64Decode(addr d[r], addr e[pos], k)
+        pos += k
+      r += st.b64DecodeDone(addr d[r])
+      doAssert d[0..<r] == data
+
+      # encoding on the fly XORed data
+      var
+        key = newString(data.len)
+        xed = newString(data.len)
+      for n in 0..<data.len:
+        key[n] = ((n * 13 + 5) and 255).chr
+        xed[n] = (data[n].ord xor key[n].ord).chr
+      r = st.b64EncodeXor(addr e[0], addr data[0], addr key[0], 1000)
+      r += st.b64EncodeXor(addr e[r], addr data[1000], addr key[1000],
+                           data.len - 1000)
+      r += st.b64EncodeDone(addr e[r])
+      doAssert e[0..<r] == xed.b64Encode
+
+      # padded chunks
+      doAssert ("YQ==" & "YWI=" & "\r\lYWJj").b64Decode == "aababc"
+
+    cpuSelect()
+
+# ----------------------------------------------------------------------------
+# End
+# ----------------------------------------------------------------------------
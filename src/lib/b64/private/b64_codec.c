@@ -0,0 +1,564 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Base64 codec with SSSE3 and AVX2 kernels. The encoder maps 12 input
+ * bytes to 16 characters per 128 bit lane: the bytes are shuffled into
+ * 32 bit words holding three bytes each, the four sextets are moved into
+ * separate bytes with two multiplications, and translated into characters
+ * with a byte shuffle table lookup by character range. The decoder runs
+ * the steps backwards after validating the characters with two nibble
+ * lookups.
+ *
+ * The kernels only process whole vectors within a line of characters
+ * (i.e. no line breaks, padding, or junk), everything else is left to the
+ * scalar code. The kernels are compiled with target attributes and bound
+ * at run time according to cpu_features(), see cpu/private/cpu_dispatch.h.
+ */
+
+#include <string.h>
+#include "b64_codec.h"
+#include "cpu_dispatch.h"
+
+#if CPU_HAVE_X86
+# include <immintrin.h>
+#endif
+
+#define B64_SKIP (-1)	/* white space or junk */
+#define B64_PAD  (-2)	/* padding character '=' */
+
+static const char enc_tab[64] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const int8_t dec_tab[256] = {
+#	define X B64_SKIP
+	 X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X,
+	 X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X,
+	 X, X, X, X, X, X, X, X,  X, X, X,62, X, X, X,63,
+	52,53,54,55,56,57,58,59, 60,61, X, X, X,B64_PAD, X, X,
+	 X, 0, 1, 2, 3, 4, 5, 6,  7, 8, 9,10,11,12,13,14,
+	15,16,17,18,19,20,21,22, 23,24,25, X, X, X, X, X,
+	 X,26,27,28,29,30,31,32, 33,34,35,36,37,38,39,40,
+	41,42,43,44,45,46,47,48, 49,50,51, X, X, X, X, X,
+	 X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X,
+	 X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X,
+	 X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X,
+	 X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X,
+	 X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X,
+	 X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X,
+	 X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X,
+	 X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X,
+#	undef X
+};
+
+/* Encode whole groups of 12 bytes within the first m bytes at in, XORed
+ * with the bytes at key unless NULL, where avail bytes are readable (also
+ * at key). Returns the number of bytes encoded. */
+typedef size_t (*enc_fn)(char *out, const uint8_t *in, const uint8_t *key,
+			 size_t m, size_t avail);
+
+/* Decode whole blocks of 16 characters of the alphabet at in where avail
+ * characters are readable. Returns the number of characters decoded. */
+typedef size_t (*dec_fn)(uint8_t *out, const char *in, size_t avail);
+
+static size_t enc_resolve (char *, const uint8_t *, const uint8_t *, size_t, size_t);
+static size_t dec_resolve (uint8_t *, const char *, size_t);
+static enc_fn enc_kernel = enc_resolve;
+static dec_fn dec_kernel = dec_resolve;
+
+#if CPU_HAVE_X86
+
+/* ------------------------------------------------------------------------ *
+ * SSSE3: 12 bytes <-> 16 characters
+ * ------------------------------------------------------------------------ */
+
+CPU_TARGET("ssse3")
+static inline __m128i enc_reshuffle(__m128i in)
+{
+	__m128i t0, t1, t2, t3;
+
+	/* bytes b2,b1,b0 of a triplet into a word as b1,b2,b0,b1 */
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(10,11, 9,10, 7, 8, 6, 7,
+					       4, 5, 3, 4, 1, 2, 0, 1));
+	t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));	/* sextets 0, 2 */
+	t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));	/* sextets 1, 3 */
+	return _mm_or_si128(t1, t3);
+}
+
+CPU_TARGET("ssse3")
+static inline __m128i enc_translate(__m128i in)
+{
+	/* offset by range: A-Z, a-z, 0-9 (10 slots), '+', '/' */
+	const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4,
+					  -4, -4, -4, -4, -19, -16, 0, 0);
+	__m128i inx = _mm_subs_epu8(in, _mm_set1_epi8(51));
+	inx = _mm_sub_epi8(inx, _mm_cmpgt_epi8(in, _mm_set1_epi8(25)));
+	return _mm_add_epi8(in, _mm_shuffle_epi8(lut, inx));
+}
+
+/* Translate characters to sextets, returns non-zero for characters not in
+ * the alphabet */
+CPU_TARGET("ssse3")
+static inline int dec_translate(__m128i *out, __m128i in)
+{
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+					     0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+					     0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+					       0,  0,  0, 0,   0,   0,   0,   0);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	__m128i hi = _mm_and_si128(_mm_srli_epi32(in, 4), mask);
+	__m128i lo = _mm_and_si128(in, mask);
+	__m128i eq_2f;
+
+	if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(_mm_shuffle_epi8(lut_lo, lo),
+							   _mm_shuffle_epi8(lut_hi, hi)),
+					     _mm_setzero_si128())))
+		return 1;
+
+	eq_2f = _mm_cmpeq_epi8(in, _mm_set1_epi8(0x2f));
+	*out = _mm_add_epi8(in, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi)));
+	return 0;
+}
+
+CPU_TARGET("ssse3")
+static inline __m128i dec_reshuffle(__m128i in)
+{
+	/* merge sextet pairs into 12 bit, then into 24 bit words */
+	in = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+	in = _mm_madd_epi16(in, _mm_set1_epi32(0x00011000));
+	return _mm_shuffle_epi8(in, _mm_setr_epi8( 2, 1, 0,  6, 5, 4, 10, 9,
+						   8,14,13, 12,-1,-1, -1,-1));
+}
+
+/* The 128 bit loops are inlined into the AVX2 kernels as well, so they
+ * are VEX encoded there (no SSE/AVX transition penalty) */
+#define INLINE_ALWAYS inline __attribute__((always_inline))
+
+CPU_TARGET("ssse3")
+static INLINE_ALWAYS size_t enc_loop(char *out, const uint8_t *in, const uint8_t *key,
+				      size_t m, size_t avail)
+{
+	size_t k = 0;
+
+	for (; k + 12 <= m && k + 16 <= avail; k += 12) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + k));
+		if (key != NULL)
+			v = _mm_xor_si128(v, _mm_loadu_si128((const __m128i *)(key + k)));
+		v = enc_translate(enc_reshuffle(v));
+		_mm_storeu_si128((__m128i *)out, v);
+		out += 16;
+	}
+	return k;
+}
+
+CPU_TARGET("ssse3")
+static INLINE_ALWAYS size_t dec_loop(uint8_t *out, const char *in, size_t avail)
+{
+	size_t k = 0;
+
+	for (; k + 16 <= avail; k += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + k));
+		uint32_t w;
+		if (dec_translate(&v, v))
+			break;
+		v = dec_reshuffle(v);			/* store 12 bytes */
+		_mm_storel_epi64((__m128i *)out, v);
+		w = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+		memcpy(out + 8, &w, 4);
+		out += 12;
+	}
+	return k;
+}
+
+CPU_TARGET("ssse3")
+static size_t enc_ssse3(char *out, const uint8_t *in, const uint8_t *key,
+			size_t m, size_t avail)
+{
+	return enc_loop(out, in, key, m, avail);
+}
+
+CPU_TARGET("ssse3")
+static size_t dec_ssse3(uint8_t *out, const char *in, size_t avail)
+{
+	return dec_loop(out, in, avail);
+}
+
+/* ------------------------------------------------------------------------ *
+ * AVX2: 24 bytes <-> 32 characters, one SSSE3 step per 128 bit lane
+ * ------------------------------------------------------------------------ */
+
+CPU_TARGET("avx2")
+static inline __m256i enc_reshuffle256(__m256i in)
+{
+	__m256i t0, t1, t2, t3;
+
+	in = _mm256_shuffle_epi8(in, _mm256_set_epi8(10,11, 9,10, 7, 8, 6, 7,
+						     4, 5, 3, 4, 1, 2, 0, 1,
+						     10,11, 9,10, 7, 8, 6, 7,
+						     4, 5, 3, 4, 1, 2, 0, 1));
+	t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+	t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+	t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+	t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+	return _mm256_or_si256(t1, t3);
+}
+
+CPU_TARGET("avx2")
+static inline __m256i enc_translate256(__m256i in)
+{
+	const __m256i lut = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4,
+					     -4, -4, -4, -4, -19, -16, 0, 0,
+					     65, 71, -4, -4, -4, -4, -4, -4,
+					     -4, -4, -4, -4, -19, -16, 0, 0);
+	__m256i inx = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+	inx = _mm256_sub_epi8(inx, _mm256_cmpgt_epi8(in, _mm256_set1_epi8(25)));
+	return _mm256_add_epi8(in, _mm256_shuffle_epi8(lut, inx));
+}
+
+CPU_TARGET("avx2")
+static inline int dec_translate256(__m256i *out, __m256i in)
+{
+	const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+						0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+						0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+						0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+						0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+						0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+						0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+						  0,  0,  0, 0,   0,   0,   0,   0,
+						  0, 16, 19, 4, -65, -65, -71, -71,
+						  0,  0,  0, 0,   0,   0,   0,   0);
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	__m256i hi = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask);
+	__m256i lo = _mm256_and_si256(in, mask);
+	__m256i eq_2f;
+
+	if (_mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_and_si256(_mm256_shuffle_epi8(lut_lo, lo),
+								    _mm256_shuffle_epi8(lut_hi, hi)),
+						   _mm256_setzero_si256())))
+		return 1;
+
+	eq_2f = _mm256_cmpeq_epi8(in, _mm256_set1_epi8(0x2f));
+	*out = _mm256_add_epi8(in, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi)));
+	return 0;
+}
+
+CPU_TARGET("avx2")
+static inline __m256i dec_reshuffle256(__m256i in)
+{
+	in = _mm256_maddubs_epi16(in, _mm256_set1_epi32(0x01400140));
+	in = _mm256_madd_epi16(in, _mm256_set1_epi32(0x00011000));
+	in = _mm256_shuffle_epi8(in, _mm256_setr_epi8( 2, 1, 0,  6, 5, 4, 10, 9,
+						       8,14,13, 12,-1,-1, -1,-1,
+						       2, 1, 0,  6, 5, 4, 10, 9,
+						       8,14,13, 12,-1,-1, -1,-1));
+	/* close the gap between the lanes */
+	return _mm256_permutevar8x32_epi32(in, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+}
+
+CPU_TARGET("avx2")
+static size_t enc_avx2(char *out, const uint8_t *in, const uint8_t *key,
+		       size_t m, size_t avail)
+{
+	size_t k = 0;
+
+	/* the lanes are loaded separately, so no read beyond 28 bytes */
+#	define LOAD24(p) _mm256_inserti128_si256(				\
+		_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(p))),	\
+		_mm_loadu_si128((const __m128i *)((p) + 12)), 1)
+	for (; k + 24 <= m && k + 28 <= avail; k += 24) {
+		__m256i v = LOAD24(in + k);
+		if (key != NULL)
+			v = _mm256_xor_si256(v, LOAD24(key + k));
+		v = enc_translate256(enc_reshuffle256(v));
+		_mm256_storeu_si256((__m256i *)out, v);
+		out += 32;
+	}
+#	undef LOAD24
+	return k + enc_loop(out, in + k, key == NULL ? NULL : key + k, m - k, avail - k);
+}
+
+CPU_TARGET("avx2")
+static size_t dec_avx2(uint8_t *out, const char *in, size_t avail)
+{
+	size_t k = 0;
+
+	for (; k + 32 <= avail; k += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(in + k));
+		if (dec_translate256(&v, v))
+			break;
+		v = dec_reshuffle256(v);		/* store 24 bytes */
+		_mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(v));
+		_mm_storel_epi64((__m128i *)(out + 16), _mm256_extracti128_si256(v, 1));
+		out += 24;
+	}
+	return k + dec_loop(out, in + k, avail - k);
+}
+
+#endif /* CPU_HAVE_X86 */
+
+/* ------------------------------------------------------------------------ *
+ * Dispatch
+ * ------------------------------------------------------------------------ */
+
+static size_t enc_scalar(char *out, const uint8_t *in, const uint8_t *key,
+			 size_t m, size_t avail)
+{
+	(void)out; (void)in; (void)key; (void)m; (void)avail;
+	return 0;
+}
+
+static size_t dec_scalar(uint8_t *out, const char *in, size_t avail)
+{
+	(void)out; (void)in; (void)avail;
+	return 0;
+}
+
+static void bind(void)
+{
+	unsigned f = cpu_features();
+
+	enc_kernel = enc_scalar;
+	dec_kernel = dec_scalar;
+#	if CPU_HAVE_X86
+	if (f & CPU_AVX2) {
+		enc_kernel = enc_avx2;
+		dec_kernel = dec_avx2;
+	}
+	else if (f & CPU_SSSE3) {
+		enc_kernel = enc_ssse3;
+		dec_kernel = dec_ssse3;
+	}
+#	endif
+	(void)f;
+}
+
+static size_t enc_resolve(char *out, const uint8_t *in, const uint8_t *key,
+			  size_t m, size_t avail)
+{
+	b64_dispatch_init();
+	return enc_kernel(out, in, key, m, avail);
+}
+
+static size_t dec_resolve(uint8_t *out, const char *in, size_t avail)
+{
+	b64_dispatch_init();
+	return dec_kernel(out, in, avail);
+}
+
+/* ------------------------------------------------------------------------ *
+ * Scalar code
+ * ------------------------------------------------------------------------ */
+
+static inline void put_quad(char *out, uint32_t w)
+{
+	out[0] = enc_tab[(w >> 18) & 63];
+	out[1] = enc_tab[(w >> 12) & 63];
+	out[2] = enc_tab[(w >>  6) & 63];
+	out[3] = enc_tab[ w        & 63];
+}
+
+static inline uint32_t get_triplet(const uint8_t *in, const uint8_t *key)
+{
+	uint32_t w = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+
+	if (key != NULL)
+		w ^= ((uint32_t)key[0] << 16) | ((uint32_t)key[1] << 8) | key[2];
+	return w;
+}
+
+static inline char *line_break(b64_state_t *st, char *out)
+{
+	if (st->col == B64_LINE_LEN) {
+		*out++ = '\r';
+		*out++ = '\n';
+		st->col = 0;
+	}
+	return out;
+}
+
+/* write the bytes of a complete or padded quad */
+static inline uint8_t *flush_quad(b64_state_t *st, uint8_t *out)
+{
+	const uint8_t *q = st->carry;
+	uint32_t m = st->ncarry;
+
+	if (1 < m)
+		*out++ = (q[0] << 2) | (q[1] >> 4);
+	if (2 < m)
+		*out++ = (q[1] << 4) | (q[2] >> 2);
+	if (3 < m)
+		*out++ = (q[2] << 6) | q[3];
+	st->ncarry = 0;
+	return out;
+}
+
+/* ------------------------------------------------------------------------ *
+ * Public
+ * ------------------------------------------------------------------------ */
+
+size_t b64_encode(b64_state_t *st, char *out, const uint8_t *in, size_t length)
+{
+	return b64_encode_xor(st, out, in, NULL, length);
+}
+
+size_t b64_encode_xor(b64_state_t *st, char *out, const uint8_t *in,
+		      const uint8_t *key, size_t length)
+{
+	char *o = out;
+
+#	define NEXT_BYTE() (key == NULL ? *in++ : *in++ ^ *key++)
+
+	/* complete a carried triplet */
+	while (0 < st->ncarry && 0 < length) {
+		st->carry[st->ncarry++] = NEXT_BYTE();
+		length--;
+		if (st->ncarry == 3) {
+			o = line_break(st, o);
+			put_quad(o, get_triplet(st->carry, NULL));
+			o += 4;
+			st->col += 4;
+			st->ncarry = 0;
+		}
+	}
+
+	/* whole triplets, up to the end of the current line at a time */
+	while (3 <= length) {
+		size_t m, k;
+
+		o = line_break(st, o);
+		m = (B64_LINE_LEN - st->col) / 4 * 3;
+		if (length < m)
+			m = length - length % 3;
+
+		k = enc_kernel(o, in, key, m, length);
+		for (; k < m; k += 3)
+			put_quad(o + k / 3 * 4,
+				 get_triplet(in + k, key == NULL ? NULL : key + k));
+
+		o += m / 3 * 4;
+		st->col += m / 3 * 4;
+		in += m;
+		if (key != NULL)
+			key += m;
+		length -= m;
+	}
+
+	/* keep the rest */
+	while (0 < length) {
+		st->carry[st->ncarry++] = NEXT_BYTE();
+		length--;
+	}
+
+#	undef NEXT_BYTE
+
+	return o - out;
+}
+
+size_t b64_encode_done(b64_state_t *st, char *out)
+{
+	char *o = out;
+
+	if (0 < st->ncarry) {
+		uint32_t w = (uint32_t)st->carry[0] << 16;
+		if (1 < st->ncarry)
+			w |= (uint32_t)st->carry[1] << 8;
+		o = line_break(st, o);
+		put_quad(o, w);
+		if (st->ncarry < 2)
+			o[2] = '=';
+		o[3] = '=';
+		o += 4;
+	}
+	memset(st, 0, sizeof(*st));
+	return o - out;
+}
+
+size_t b64_decode(b64_state_t *st, uint8_t *out, const char *in, size_t length)
+{
+	uint8_t *o = out;
+	size_t i = 0;
+	int vec = 1;
+
+	while (i < length) {
+		int8_t v;
+
+		/* try the vector kernel at a quad boundary, once per run of
+		 * alphabet characters (e.g. a line) */
+		if (vec && st->ncarry == 0 && 16 <= length - i &&
+		    0 <= dec_tab[(uint8_t)in[i]]) {
+			size_t k = dec_kernel(o, in + i, length - i);
+			o += k / 4 * 3;
+			i += k;
+			vec = 0;
+			continue;
+		}
+
+		v = dec_tab[(uint8_t)in[i++]];
+		if (0 <= v) {
+			st->carry[st->ncarry++] = v;
+			if (st->ncarry == 4)
+				o = flush_quad(st, o);
+		}
+		else {
+			if (v == B64_PAD)	/* end of a padded chunk */
+				o = flush_quad(st, o);
+			vec = 1;
+		}
+	}
+
+	return o - out;
+}
+
+size_t b64_decode_done(b64_state_t *st, uint8_t *out)
+{
+	uint8_t *o = flush_quad(st, out);	/* unpadded tail */
+
+	memset(st, 0, sizeof(*st));
+	return o - out;
+}
+
+void b64_dispatch_init(void)
+{
+	cpu_dispatch_register(bind);
+}
+
+const char *b64_kernel_name(void)
+{
+	if (enc_kernel == enc_resolve)
+		b64_dispatch_init();
+#	if CPU_HAVE_X86
+	if (enc_kernel == enc_avx2)
+		return "avx2";
+	if (enc_kernel == enc_ssse3)
+		return "ssse3";
+#	endif
+	return "scalar";
+}
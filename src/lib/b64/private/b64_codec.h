@@ -0,0 +1,87 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Base64 codec with 76 column lines separated by CRLF
+ */
+
+#ifndef B64_CODEC_H
+#define B64_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//Characters per encoded line, the line break is CRLF
+#define B64_LINE_LEN 76
+
+//State carried between calls of the streaming functions, all zero to start
+typedef struct
+{
+  uint8_t  carry[4];  /* bytes (encoder) or sextets (decoder) not processed, yet */
+  uint32_t ncarry;
+  uint32_t col;       /* characters on the current line (encoder) */
+} b64_state_t;
+
+//Encode length bytes, up to two bytes are kept in the state for the next
+//call. A line break is inserted before a quad that would exceed the
+//B64_LINE_LEN columns. Returns the number of characters written, at most
+//4*((ncarry+length)/3) plus 2 for every B64_LINE_LEN characters.
+size_t b64_encode(b64_state_t *st, char *out, const uint8_t *in, size_t length);
+
+//Same as b64_encode() for the input bytes XORed with the same number of bytes
+//at key, e.g. a cipher key stream. So the cipher text is encoded on the fly
+//rather than stored and read back.
+size_t b64_encode_xor(b64_state_t *st, char *out, const uint8_t *in,
+		      const uint8_t *key, size_t length);
+
+//Write the padded quad for the bytes kept in the state (at most 6 characters)
+//and reset the state. Returns the number of characters written.
+size_t b64_encode_done(b64_state_t *st, char *out);
+
+//Decode length characters, everything but the base64 alphabet is skipped
+//and padding ends a quad. An incomplete quad is kept in the state for the
+//next call. Returns the number of bytes written, at most 3*((ncarry+length)/4).
+size_t b64_decode(b64_state_t *st, uint8_t *out, const char *in, size_t length);
+
+//Write the bytes of an unpadded last quad kept in the state (at most 2 bytes)
+//and reset the state. Returns the number of bytes written.
+size_t b64_decode_done(b64_state_t *st, uint8_t *out);
+
+//Bind the vector kernels to the best ones supported by the CPU, done
+//implicitly on first use
+void b64_dispatch_init(void);
+
+//Name of the kernel bound, one of "scalar", "ssse3", or "avx2"
+const char *b64_kernel_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* B64_CODEC_H */
@@ -40,6 +40,7 @@
 import
   endians,
   chacha / [chachadesc],
+  cpu    / [cpu],
   misc   / [prjcfg]
 
 export
@@ -51,10 +52,17 @@ export
 
 const
   chaHeader = "private/chacha20_simple.h".nimSrcDirname
-  chaCflags = "-I " & "private".nimSrcDirname
+  chaCflags = "-I " & "private".nimSrcDirname &
+              " -I " & "../cpu/private".nimSrcDirname
 
 {.passC: chaCflags.}
 {.compile: "private/chacha20_simple.c".nimSrcDirname.}
+{.compile: "private/chacha20_simd.c".nimSrcDirname.}
+{.compile: "private/chacha20_pool.c".nimSrcDirname.}
+{.passL: "-lpthread".}
+
+const
+  chachaParallelMin* = 256 * 1024 ## default threshold for parallel crypt
 
 type
   CCKeyBuf[K: ChaChaHKey|ChaChaKey] = tuple
@@ -110,6 +118,17 @@ when isMainModule:
 proc chacha20Setup(x: ptr ChaChaCtx; k: pointer; n: csize; u: ptr ChaChaIV)
   {.cdecl, header: chaHeader, importc: "chacha20_setup".}
 
+# Initialize a ChaCha20Ctx as in RFC 8439 (32 bit counter, 96 bit nonce)
+#
+#   x -- context
+#   k -- input key
+#   u -- nonce
+#   n -- initial block counter
+#
+proc chacha20SetupIetf(x: ptr ChaChaCtx;
+                       k: ptr ChaChaIetfKey; u: ptr ChaChaIetfNonce; n: uint32)
+  {.cdecl, header: chaHeader, importc: "chacha20_setup_ietf".}
+
 # Set internal counter to process a particular block number.
 #
 #   x -- context
@@ -136,6 +155,33 @@ proc chacha20Block(x: ptr ChaChaCtx; w: ptr ChaChaXBlk)
 proc chacha20AnyCrypt(x: ptr ChaChaCtx; u, w: pointer; n: csize)
  {.cdecl, header: chaHeader, importc: "chacha20_encrypt".}
 
+# Same as chacha20AnyCrypt() using a pool of worker threads for the whole
+# blocks (output is the same.)
+#
+#   x -- context
+#   i -- input data
+#   o -- output data
+#   n -- length of data
+#
+proc chacha20AnyCryptParallel(x: ptr ChaChaCtx; i, o: pointer; n: csize)
+ {.cdecl, header: chaHeader, importc: "chacha20_encrypt_parallel".}
+
+# Set up the worker thread pool.
+#
+#   t -- number of threads including the caller, 0: number of CPUs
+#   n -- minimum data length for using the pool
+#
+proc chacha20ParallelSetup(t: cuint; n: csize)
+ {.cdecl, header: chaHeader, importc: "chacha20_parallel_setup".}
+
+# Bind the multi-block kernel to the best one supported by the CPU
+proc chacha20DispatchInit()
+ {.cdecl, header: chaHeader, importc: "chacha20_dispatch_init".}
+
+# Name of the multi-block kernel bound
+proc chacha20KernelName(): cstring
+ {.cdecl, header: chaHeader, importc: "chacha20_kernel_name".}
+
 # ----------------------------------------------------------------------------
 # Private helper
 # ----------------------------------------------------------------------------
@@ -164,10 +210,28 @@ proc getChaCha*[K: ChaChaKey|ChaChaHKey](x: var ChaChaCtx;
   chacha20Setup(addr x, addr b.buf, key[].sizeof.csize, addr b.nnn)
   (addr b).zeroMem(b.sizeof)
 
+proc getChaChaIetf*(x: var ChaChaCtx;
+                    key: ptr ChaChaIetfKey; nonce: ptr ChaChaIetfNonce;
+                    counter = 0u32) {.inline.} =
+  ## Initialize chacha20 with a 96 bit nonce and a 32 bit block counter as
+  ## specified in RFC 8439, the key and nonce are taken as byte strings.
+  ## The counter occupies the lower half of the 64 bit counter used by
+  ## chachaBlockSeek() which must not be used with this context.
+  chacha20SetupIetf(addr x, key, nonce, counter)
+
 proc chachaBlockSeek*(x: var ChaChaCtx; n: int|uint|uint64) {.inline.} =
   ## Set internal counter to process a particular ChaChaBlk block number.
   chacha20CounterSet(addr x, n.clonglong)
 
+proc chachaSeek*(x: var ChaChaCtx; pos: uint64) =
+  ## Set the key stream position to byte 'pos' so the next
+  ## chachaAnyCrypt()/chachaKeyStream() starts there. At most one block of
+  ## key stream is generated, the rest of it is kept for the next call.
+  x.chachaBlockSeek(pos shr 6)
+  let r = (pos and 63).int
+  if 0 < r:
+    chacha20Block(addr x, cast[ptr ChaChaXBlk](addr x.keystream))
+    x.available = (x.keystream.sizeof - r).csize
 
 proc chachaBlock*(x: var ChaChaCtx; pOut: ptr ChaChaBlk) {.inline.} =
   ## Raw keystream for the current block.
@@ -198,6 +262,33 @@ proc chachaKeyStream*(x: var ChaChaCtx; p: pointer; size: int) {.inline.} =
   p.zeroMem(size)
   chacha20AnyCrypt(addr x, p, p, size.csize)
 
+proc chachaParallelCrypt*(x: var ChaChaCtx;
+                          pOut, pIn: pointer; size: int) {.inline.} =
+  ## Same as chachaAnyCrypt(), the whole blocks are split into slices
+  ## processed by a pool of worker threads. Each worker uses a copy of the
+  ## context seeked to its slice, so the output is the same as with
+  ## chachaAnyCrypt(). The data are processed serially below the threshold
+  ## size set with chachaParallelSetup().
+  chacha20AnyCryptParallel(addr x, pIn, pOut, size.csize) # in/out reversed (!)
+
+proc chachaParallelSetup*(threads = 0; threshold = chachaParallelMin) =
+  ## Set the number of threads used by chachaParallelCrypt() including the
+  ## caller (0 for the number of CPUs, 1 for serial processing only) and
+  ## the minimum data size for using more than one thread. The worker
+  ## threads are started on first use and kept.
+  chacha20ParallelSetup(max(threads, 0).cuint, max(threshold, 0).csize)
+
+proc chachaKernel*(): string {.inline.} =
+  ## Name of the multi-block kernel used by chachaAnyCrypt(), one of
+  ## "scalar", "sse2", "ssse3", "avx2", or "avx512" (see cpu module.)
+  $chacha20KernelName()
+
+# ----------------------------------------------------------------------------
+# Initialisation
+# ----------------------------------------------------------------------------
+
+chacha20DispatchInit() # bind kernels before any threads are started
+
 # ----------------------------------------------------------------------------
 # Tests
 # ----------------------------------------------------------------------------
@@ -337,6 +428,103 @@ when isMainModule:
             ctx.chachaAnyCrypt(addr outBuf[j], addr  inBuf[j], size)
           doAssert outBuf.fromHexSeq("") == tCipher
 
+  if true: # seeking gives the same key stream as running through
+    var
+      key: ChaChaKey = (data: [1u64, 2u64, 3u64, 4u64])
+      iv: ChaChaIV   = (data: [5u64])
+      ctx: ChaChaCtx
+      size = 11 * 64 + 3
+      full = newSeq[uint8](size)
+      part = newSeq[uint8](size)
+    ctx.getChaCha(addr key, addr iv)
+    ctx.chachaKeyStream(addr full[0], size)
+
+    for pos in [0, 1, 63, 64, 65, 300, 511, 512, size - 1]:
+      let n = size - pos
+      ctx.getChaCha(addr key, addr iv)
+      ctx.chachaKeyStream(addr part[0], 100)        # somewhere else
+      ctx.chachaSeek(pos.uint64)
+      ctx.chachaKeyStream(addr part[0], 1)           # odd sized parts
+      if 1 < n:
+        ctx.chachaKeyStream(addr part[1], n - 1)
+      doAssert part[0..<n] == full[pos..<size]
+
+  if true: # parallel crypt gives the same as serial
+    var
+      key: ChaChaKey = (data: [7u64, 6u64, 5u64, 4u64])
+      iv: ChaChaIV   = (data: [3u64])
+      ctx, pCtx: ChaChaCtx
+      size = 333 * 1024 + 17
+      inBuf  = newSeq[uint8](size)
+      outBuf = newSeq[uint8](size)
+      parBuf = newSeq[uint8](size)
+    for n in 0..<size:
+      inBuf[n] = (n * 3).uint8
+    chachaParallelSetup(4, 1000)
+
+    ctx.getChaCha(addr key, addr iv)
+    pCtx.getChaCha(addr key, addr iv)
+    ctx.chachaAnyCrypt(addr outBuf[0], addr inBuf[0], 5)
+    pCtx.chachaAnyCrypt(addr parBuf[0], addr inBuf[0], 5)
+    ctx.chachaAnyCrypt(addr outBuf[5], addr inBuf[5], size - 10)
+    pCtx.chachaParallelCrypt(addr parBuf[5], addr inBuf[5], size - 10)
+    ctx.chachaAnyCrypt(addr outBuf[size - 5], addr inBuf[size - 5], 5)
+    pCtx.chachaAnyCrypt(addr parBuf[size - 5], addr inBuf[size - 5], 5)
+    doAssert outBuf == parBuf
+
+    pCtx.getChaCha(addr key, addr iv)                 # in place
+    pCtx.chachaParallelCrypt(addr parBuf[0], addr parBuf[0], size)
+    doAssert parBuf == inBuf
+    chachaParallelSetup()
+
+  if true: # multi-block kernel must agree with the raw block keystream
+    var
+      key: ChaChaKey = (data: [0x0123456789abcdefu64, 0xfedcba9876543210u64,
+                               0x0f1e2d3c4b5a6978u64, 0x8796a5b4c3d2e1f0u64])
+      iv: ChaChaIV   = (data: [0x0102030405060708u64])
+      ctx: ChaChaCtx
+      bCtx: ChaChaCtx
+      blk: ChaChaBlk
+      size = 17 * 64 + 21
+      inBuf  = newSeq[int8](size)
+      outBuf = newSeq[int8](size)
+    for n in 0..<size:
+      inBuf[n] = (n and 127).toU8
+
+    for level in ["scalar", "sse2", "ssse3", "avx2", "avx512"]:
+      cpuSelect(level)
+      when not defined(check_run):
+        echo ">>> kernel ", level, " -> ", chachaKernel()
+
+      for counter in [0u64, 42u64, 0xfffffffdu64]:
+        ctx.getChaCha(addr key, addr iv)
+        ctx.chachaBlockSeek(counter)
+        ctx.chachaAnyCrypt(addr outBuf[0], addr inBuf[0], size)
+
+        bCtx.getChaCha(addr key, addr iv)
+        bCtx.chachaBlockSeek(counter)
+        for n in 0..<size:
+          if (n and 63) == 0:
+            bCtx.chachaBlock(addr blk)
+          doAssert outBuf[n] == cast[int8](inBuf[n].uint8 xor
+                                           blk.data[n and 63])
+    cpuSelect()
+
+  if true: # RFC 8439, 2.3.2 block function test vector
+    var
+      key: ChaChaIetfKey
+      nonce: ChaChaIetfNonce = [0u8, 0, 0, 9, 0, 0, 0, 0x4a, 0, 0, 0, 0]
+      ctx: ChaChaCtx
+      blk: ChaChaBlk
+    for n in 0..<key.len:
+      key[n] = n.uint8
+    ctx.getChaChaIetf(addr key, addr nonce, 1)
+    ctx.chachaBlock(addr blk)
+    doAssert blk.pp("") == "10f1e7e4d13b5915500fdd1fa32071c4" &
+                           "c7d1f4c733c068030422aa9ac3d46c4e" &
+                           "d2826446079faa0914c2d705d98b02a2" &
+                           "b5129cd1de164eb9cbd083e8a2503c4e"
+
 #  when not defined(check_run):
 #    echo "*** not yet"
 
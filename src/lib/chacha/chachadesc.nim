@@ -35,6 +35,8 @@ type
   ChaChaBlk*  = tuple[data: array[64, uint8]] ## 64 byte data block
   ChaChaXBlk* = tuple[data: array[16,uint32]] ## data block (other format)
   ChaChaData* = ChaChaIV|ChaChaHKey|ChaChaKey|ChaChaBlk|ChaChaXBlk
+  ChaChaIetfKey*   = array[32, uint8]        ## key bytes as in RFC 8439
+  ChaChaIetfNonce* = array[12, uint8]        ## nonce bytes as in RFC 8439
   ChaChaCtx* = tuple                          ## descriptor, holds context
     schedule:  ChaChaBlk
     keystream: ChaChaBlk
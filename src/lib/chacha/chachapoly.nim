@@ -0,0 +1,286 @@
+# -*- nim -*-
+#
+# $Id$
+#
+# Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+# All rights reserved.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# The author or authors of this code dedicate any and all copyright interest
+# in this code to the public domain. We make this dedication for the benefit
+# of the public at large and to the detriment of our heirs and successors.
+# We intend this dedication to be an overt act of relinquishment in
+# perpetuity of all present and future rights to this code under copyright
+# law.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+#
+
+## This module implements the ChaCha20-Poly1305 AEAD construction of
+## RFC 8439, section 2.8, on top of the 'chacha' and 'poly1305' modules.
+## The Poly1305 key is taken from ChaCha20 block 0 and the data are
+## encrypted starting with block 1. Cipher data are authenticated in L1
+## sized chunks right after en/decrypting (or before decrypting), so the
+## data are read from memory once.
+##
+## Example:
+##
+## .. code-block::
+##
+##    import
+##      chacha / [chachapoly]
+##
+##    var
+##      key:   ChaChaIetfKey   # 32 random bytes
+##      nonce: ChaChaIetfNonce # never used twice with the same key
+##      plain: string
+##
+##    let sealed = chachaPolySeal(addr key, addr nonce, "header", "message")
+##    doAssert chachaPolyOpen(addr key, addr nonce, "header", sealed, plain)
+##    doAssert plain == "message"
+##
+
+import
+  endians,
+  chacha / [chacha, poly1305]
+
+export
+  chacha, poly1305
+
+const
+  chachaPolyTagLen* = poly1305TagLen
+  chachaPolyChunk   = 4096          # en/decrypt and authenticate at a time
+
+type
+  ChaChaPolyCtx* = tuple            ## incremental AEAD context
+    ccc:     ChaChaCtx
+    mac:     Poly1305Ctx
+    aadLen:  uint64
+    dataLen: uint64
+    data:    bool                   # additional data complete
+
+# ----------------------------------------------------------------------------
+# Private helpers
+# ----------------------------------------------------------------------------
+
+proc `+!`(p: pointer; n: int): pointer {.inline.} =
+  cast[pointer](cast[ByteAddress](p) + n)
+
+proc startData(x: var ChaChaPolyCtx) {.inline.} =
+  if not x.data:
+    x.mac.poly1305Pad16
+    x.data = true
+
+# ----------------------------------------------------------------------------
+# Public functions
+# ----------------------------------------------------------------------------
+
+proc getChaChaPoly*(x: var ChaChaPolyCtx;
+                    key: ptr ChaChaIetfKey; nonce: ptr ChaChaIetfNonce) =
+  ## Start en/decrypting a message. A nonce must never be used twice with
+  ## the same key.
+  var
+    blk: ChaChaBlk
+    pk: Poly1305Key
+  x.ccc.getChaChaIetf(key, nonce, 0)
+  x.ccc.chachaBlock(addr blk)                        # continue with block 1
+  (addr pk[0]).copyMem(addr blk.data[0], pk.sizeof)
+  x.mac.getPoly1305(addr pk)
+  x.aadLen = 0
+  x.dataLen = 0
+  x.data = false
+  (addr blk).zeroMem(blk.sizeof)
+  (addr pk).zeroMem(pk.sizeof)
+
+proc chachaPolyAad*(x: var ChaChaPolyCtx; p: pointer; n: int) =
+  ## Add additional (not encrypted) data, repeat as needed. All additional
+  ## data must be added before the message data.
+  doAssert not x.data
+  x.mac.poly1305Update(p, n)
+  x.aadLen += n.uint64
+
+proc chachaPolyAad*(x: var ChaChaPolyCtx; s: string) {.inline.} =
+  ## same as chachaPolyAad() above for a string argument
+  if 0 < s.len:
+    x.chachaPolyAad(unsafeAddr s[0], s.len)
+
+proc chachaPolyEncrypt*(x: var ChaChaPolyCtx; dst, src: pointer; n: int) =
+  ## Encrypt n bytes from src to dst (which may be the same), repeat as
+  ## needed.
+  x.startData
+  var pos = 0
+  while pos < n:
+    let k = min(n - pos, chachaPolyChunk)
+    x.ccc.chachaAnyCrypt(dst +! pos, src +! pos, k)
+    x.mac.poly1305Update(dst +! pos, k)
+    pos.inc(k)
+  x.dataLen += n.uint64
+
+proc chachaPolyDecrypt*(x: var ChaChaPolyCtx; dst, src: pointer; n: int) =
+  ## Decrypt n bytes from src to dst (which may be the same), repeat as
+  ## needed. The data must not be used before chachaPolyVerify() succeeds.
+  x.startData
+  var pos = 0
+  while pos < n:
+    let k = min(n - pos, chachaPolyChunk)
+    x.mac.poly1305Update(src +! pos, k)
+    x.ccc.chachaAnyCrypt(dst +! pos, src +! pos, k)
+    pos.inc(k)
+  x.dataLen += n.uint64
+
+proc chachaPolyTag*(x: var ChaChaPolyCtx; tag: var Poly1305Tag) =
+  ## Finish the message and return its tag, the context is cleared.
+  var lens: array[2, uint64]
+  x.startData
+  x.mac.poly1305Pad16
+  littleEndian64(addr lens[0], addr x.aadLen)
+  littleEndian64(addr lens[1], addr x.dataLen)
+  x.mac.poly1305Update(addr lens[0], lens.sizeof)
+  x.mac.poly1305Finish(tag)
+  (addr x).zeroMem(x.sizeof)
+
+proc chachaPolyVerify*(x: var ChaChaPolyCtx; tag: Poly1305Tag): bool =
+  ## Finish the message and compare its tag with the argument in constant
+  ## time, the context is cleared.
+  var mine: Poly1305Tag
+  x.chachaPolyTag(mine)
+  mine.poly1305Verify(tag)
+
+
+proc chachaPolySeal*(key: ptr ChaChaIetfKey; nonce: ptr ChaChaIetfNonce;
+                     aad, plain: string): string =
+  ## One-shot encryption, returns the cipher text followed by the tag.
+  var
+    x: ChaChaPolyCtx
+    tag: Poly1305Tag
+  result = newString(plain.len + chachaPolyTagLen)
+  x.getChaChaPoly(key, nonce)
+  x.chachaPolyAad(aad)
+  if 0 < plain.len:
+    x.chachaPolyEncrypt(addr result[0], unsafeAddr plain[0], plain.len)
+  x.chachaPolyTag(tag)
+  (addr result[plain.len]).copyMem(addr tag[0], tag.len)
+
+proc chachaPolyOpen*(key: ptr ChaChaIetfKey; nonce: ptr ChaChaIetfNonce;
+                     aad, sealed: string; plain: var string): bool =
+  ## One-shot decryption of the cipher text and tag from chachaPolySeal().
+  ## It returns false (and an empty plain text) if the tag does not match.
+  var
+    x: ChaChaPolyCtx
+    tag: Poly1305Tag
+    n = sealed.len - chachaPolyTagLen
+  plain = ""
+  if n < 0:
+    return false
+  plain.setLen(n)
+  (addr tag[0]).copyMem(unsafeAddr sealed[n], tag.len)
+  x.getChaChaPoly(key, nonce)
+  x.chachaPolyAad(aad)
+  if 0 < n:
+    x.chachaPolyDecrypt(addr plain[0], unsafeAddr sealed[0], n)
+  result = x.chachaPolyVerify(tag)
+  if not result:
+    if 0 < n:
+      (addr plain[0]).zeroMem(n)                     # do not leak anything
+    plain = ""
+
+# ----------------------------------------------------------------------------
+# Tests
+# ----------------------------------------------------------------------------
+
+when isMainModule:
+
+  import
+    sequtils, strutils
+
+  proc toHex(s: string): string =
+    s.mapIt(it.ord.toHex(2).toLowerAscii).join
+
+  proc toStr(t: Poly1305Tag): string =
+    result = newString(t.len)
+    for n in 0..<t.len:
+      result[n] = t[n].chr
+
+  # RFC 8439, 2.8.2
+  var
+    key: ChaChaIetfKey
+    nonce: ChaChaIetfNonce = [7u8, 0, 0, 0,
+                              0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47]
+    plain: string
+  const
+    aad = "\x50\x51\x52\x53\xc0\xc1\xc2\xc3\xc4\xc5\xc6\xc7"
+    text = "Ladies and Gentlemen of the class of '99: If I could offer " &
+           "you only one tip for the future, sunscreen would be it."
+    cipher = "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736" &
+             "ee62d63dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6" &
+             "a5b67ecd3b3692ddbd7f2d778b8c9803aee328091b58fab324e4fad675" &
+             "945585808b4831d7bc3ff4def08e4b7a9de576d26586cec64b6116"
+    tag = "1ae10b594f09e26a7e902ecbd0600691"
+  for n in 0..<key.len:
+    key[n] = (0x80 + n).uint8
+
+  let sealed = chachaPolySeal(addr key, addr nonce, aad, text)
+  doAssert sealed.toHex == cipher & tag
+  doAssert chachaPolyOpen(addr key, addr nonce, aad, sealed, plain)
+  doAssert plain == text
+
+  # incremental, in place and odd splits
+  for step in [1, 13, 64, 100]:
+    var
+      x: ChaChaPolyCtx
+      buf = text
+      t: Poly1305Tag
+      pos = 0
+    x.getChaChaPoly(addr key, addr nonce)
+    x.chachaPolyAad(aad[0..4])
+    x.chachaPolyAad(aad[5..^1])
+    while pos < buf.len:
+      let k = min(step, buf.len - pos)
+      x.chachaPolyEncrypt(addr buf[pos], addr buf[pos], k)
+      pos.inc(k)
+    x.chachaPolyTag(t)
+    doAssert buf & t.toStr == sealed
+
+    pos = 0
+    x.getChaChaPoly(addr key, addr nonce)
+    x.chachaPolyAad(aad)
+    while pos < buf.len:
+      let k = min(step, buf.len - pos)
+      x.chachaPolyDecrypt(addr buf[pos], addr buf[pos], k)
+      pos.inc(k)
+    doAssert x.chachaPolyVerify(t)
+    doAssert buf == text
+
+  # tampering
+  for n in [0, text.len - 1, text.len, sealed.len - 1]:
+    var bad = sealed
+    bad[n] = (bad[n].ord xor 0x80).chr
+    doAssert not chachaPolyOpen(addr key, addr nonce, aad, bad, plain)
+    doAssert plain == ""
+  doAssert not chachaPolyOpen(addr key, addr nonce, "x" & aad, sealed, plain)
+  doAssert not chachaPolyOpen(addr key, addr nonce, aad, sealed[0..14], plain)
+
+  # empty message and long message (crosses chunk boundaries)
+  doAssert chachaPolySeal(addr key, addr nonce, "", "").len == chachaPolyTagLen
+  doAssert chachaPolyOpen(addr key, addr nonce, "",
+                          chachaPolySeal(addr key, addr nonce, "", ""), plain)
+  doAssert plain == ""
+  let long = text.repeat(200)
+  doAssert chachaPolyOpen(addr key, addr nonce, aad,
+                          chachaPolySeal(addr key, addr nonce, aad, long), plain)
+  doAssert plain == long
+
+  when not defined(check_run):
+    echo "*** chachapoly OK"
+
+# ----------------------------------------------------------------------------
+# End
+# ----------------------------------------------------------------------------
@@ -0,0 +1,262 @@
+# -*- nim -*-
+#
+# $Id$
+#
+# Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+# All rights reserved.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# The author or authors of this code dedicate any and all copyright interest
+# in this code to the public domain. We make this dedication for the benefit
+# of the public at large and to the detriment of our heirs and successors.
+# We intend this dedication to be an overt act of relinquishment in
+# perpetuity of all present and future rights to this code under copyright
+# law.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+#
+
+## This module implements the Poly1305 one-time authenticator by Daniel
+## Bernstein as specified in RFC 8439, section 2.5. A key must only be used
+## for a single message, e.g. it is taken from a ChaCha20 key stream block
+## that is not used for anything else.
+##
+## Whole message blocks are processed by a kernel bound at run time: an
+## AVX2 kernel handling four blocks in parallel, or a portable kernel with
+## 44 bit limbs (26 bit limbs if the C compiler lacks 128 bit integers.)
+
+import
+  cpu  / [cpu],
+  misc / [prjcfg]
+
+# ----------------------------------------------------------------------------
+# Poly1305 compiler
+# ----------------------------------------------------------------------------
+
+const
+  polyHeader = "private/poly1305.h".nimSrcDirname
+
+{.passC: "-I " & "private".nimSrcDirname &
+        " -I " & "../cpu/private".nimSrcDirname.}
+{.compile: "private/poly1305.c".nimSrcDirname.}
+
+const
+  poly1305KeyLen* = 32
+  poly1305TagLen* = 16
+
+type
+  Poly1305Key* = array[poly1305KeyLen, uint8] ## one-time key
+  Poly1305Tag* = array[poly1305TagLen, uint8] ## authenticator
+  Poly1305Ctx* = tuple                          ## incremental context
+    opaque: array[24, uint64]
+
+# ----------------------------------------------------------------------------
+# Interface poly1305
+# ----------------------------------------------------------------------------
+
+# Start a message
+#
+#   x -- context
+#   k -- one-time key
+#
+proc poly1305_init(x: ptr Poly1305Ctx; k: ptr Poly1305Key)
+  {.cdecl, header: polyHeader, importc.}
+
+# Add message data, call continuously as needed
+#
+#   x -- context
+#   p -- data
+#   n -- data length
+#
+proc poly1305_update(x: ptr Poly1305Ctx; p: pointer; n: csize)
+  {.cdecl, header: polyHeader, importc.}
+
+# Pad the message with zeros up to the next multiple of 16 bytes
+#
+#   x -- context
+#
+proc poly1305_pad16(x: ptr Poly1305Ctx)
+  {.cdecl, header: polyHeader, importc.}
+
+# Write the tag and clear the context
+#
+#   x -- context
+#   t -- tag
+#
+proc poly1305_finish(x: ptr Poly1305Ctx; t: ptr Poly1305Tag)
+  {.cdecl, header: polyHeader, importc.}
+
+# Compare tags in constant time, returns 1 if equal
+#
+#   a, b -- tags
+#
+proc poly1305_verify(a, b: ptr Poly1305Tag): cint
+  {.cdecl, header: polyHeader, importc.}
+
+# Bind the block kernel to the best one supported by the CPU
+proc poly1305_dispatch_init()
+  {.cdecl, header: polyHeader, importc.}
+
+# Name of the block kernel bound
+proc poly1305_kernel_name(): cstring
+  {.cdecl, header: polyHeader, importc.}
+
+# ----------------------------------------------------------------------------
+# Public functions
+# ----------------------------------------------------------------------------
+
+proc getPoly1305*(x: var Poly1305Ctx; key: ptr Poly1305Key) {.inline.} =
+  ## Start authenticating a message with the one-time key.
+  poly1305_init(addr x, key)
+
+proc poly1305Update*(x: var Poly1305Ctx; p: pointer; n: int) {.inline.} =
+  ## Add n bytes of message data, repeat as needed.
+  if 0 < n:
+    poly1305_update(addr x, p, n.csize)
+
+proc poly1305Update*(x: var Poly1305Ctx; s: string) {.inline.} =
+  ## Add a string to the message.
+  if 0 < s.len:
+    poly1305_update(addr x, unsafeAddr s[0], s.len.csize)
+
+proc poly1305Pad16*(x: var Poly1305Ctx) {.inline.} =
+  ## Add zero bytes up to the next multiple of 16 message bytes, i.e. the
+  ## padding used for RFC 8439 AEAD constructions.
+  poly1305_pad16(addr x)
+
+proc poly1305Finish*(x: var Poly1305Ctx; tag: var Poly1305Tag) {.inline.} =
+  ## Calculate the tag, the context is cleared.
+  poly1305_finish(addr x, addr tag)
+
+proc poly1305Auth*(tag: var Poly1305Tag;
+                   p: pointer; n: int; key: ptr Poly1305Key) =
+  ## One-shot tag of n bytes of message data.
+  var x: Poly1305Ctx
+  x.getPoly1305(key)
+  x.poly1305Update(p, n)
+  x.poly1305Finish(tag)
+
+proc poly1305Auth*(tag: var Poly1305Tag;
+                   s: string; key: ptr Poly1305Key) {.inline.} =
+  ## One-shot tag of a string.
+  var x: Poly1305Ctx
+  x.getPoly1305(key)
+  x.poly1305Update(s)
+  x.poly1305Finish(tag)
+
+proc poly1305Verify*(a, b: Poly1305Tag): bool {.inline.} =
+  ## Compare tags in constant time.
+  var u = a
+  var v = b
+  0 < poly1305_verify(addr u, addr v)
+
+proc poly1305Kernel*(): string {.inline.} =
+  ## Name of the block kernel, one of "radix26", "radix44", or "avx2"
+  $poly1305_kernel_name()
+
+# ----------------------------------------------------------------------------
+# Initialisation
+# ----------------------------------------------------------------------------
+
+poly1305_dispatch_init() # bind kernels before any threads are started
+
+# ----------------------------------------------------------------------------
+# Tests
+# ----------------------------------------------------------------------------
+
+when isMainModule:
+
+  import
+    sequtils, strutils
+
+  proc fromHex[N](a: var array[N,uint8]; s: string) =
+    for n in 0..<a.len:
+      a[n] = s[2*n..2*n+1].parseHexInt.uint8
+
+  var
+    varPoly1305CtxSizeof {.
+      importc: "sizeof(poly1305_ctx)", header: polyHeader.}: int
+  doAssert varPoly1305CtxSizeof == Poly1305Ctx.sizeof
+
+  # RFC 8439, 2.5.2 and appendix A.3
+  for w in [("85d6be7857556d337f4452fe42d506a8" &
+             "0103808afb0db2fd4abff6af4149f51b",
+             "Cryptographic Forum Research Group",
+             "a8061dc1305136c6c22b8baf0c0127a9"),
+            ("00000000000000000000000000000000" &
+             "36e5f6b5c5e06070f0efca96227a863e",
+             "Any submission to the IETF intended by the Contributor for " &
+             "publication as all or part of an IETF Internet-Draft or RFC " &
+             "and any statement made within the context of an IETF " &
+             "activity is considered an \"IETF Contribution\". Such " &
+             "statements include oral statements in IETF sessions, as well " &
+             "as written and electronic communications made at any time or " &
+             "place, which are addressed to",
+             "36e5f6b5c5e06070f0efca96227a863e")]:
+    var
+      key: Poly1305Key
+      tag, exp: Poly1305Tag
+      x: Poly1305Ctx
+    key.fromHex(w[0])
+    exp.fromHex(w[2])
+
+    tag.poly1305Auth(w[1], addr key)
+    doAssert tag.poly1305Verify(exp)
+
+    for n in 0..w[1].len:                            # incremental
+      x.getPoly1305(addr key)
+      x.poly1305Update(w[1][0..<n])
+      x.poly1305Update(w[1][n..^1])
+      x.poly1305Finish(tag)
+      doAssert tag == exp
+
+    tag[15] = tag[15] xor 1
+    doAssert not tag.poly1305Verify(exp)
+
+  # all kernels agree, long messages and odd splits
+  var
+    key: Poly1305Key
+    text = newString(3000)
+    tags: seq[Poly1305Tag] = @[]
+  for n in 0..<key.len:
+    key[n] = (n * 37 + 11).uint8
+  for n in 0..<text.len:
+    text[n] = ((n * 7 + n div 253) and 255).chr
+
+  for level in ["scalar", "avx2"]:
+    cpuSelect(level)
+    when not defined(check_run):
+      echo ">>> kernel ", level, " -> ", poly1305Kernel()
+    var n = 0
+    for size in [0, 15, 16, 64, 255, 256, 257, 1000, 2999, 3000]:
+      for step in [7, 64, 300, size + 1]:
+        var
+          tag: Poly1305Tag
+          x: Poly1305Ctx
+          pos = 0
+        x.getPoly1305(addr key)
+        while pos < size:
+          x.poly1305Update(addr text[pos], min(step, size - pos))
+          pos.inc(step)
+        x.poly1305Finish(tag)
+        if level == "scalar":
+          tags.add tag
+        doAssert tags[n] == tag
+        doAssert tags[n - n mod 4] == tag            # same for all steps
+        n.inc
+  cpuSelect()
+
+  when not defined(check_run):
+    echo "*** poly1305 OK"
+
+# ----------------------------------------------------------------------------
+# End
+# ----------------------------------------------------------------------------
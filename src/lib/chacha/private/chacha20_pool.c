@@ -0,0 +1,208 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Worker thread pool for encrypting large buffers. ChaCha20 blocks only
+ * depend on the key, nonce and block counter, so the whole blocks of a
+ * buffer are split into contiguous slices. Each slice is processed on a
+ * copy of the context with the counter set to the first block of the
+ * slice. The caller processes the first slice and waits for the others.
+ *
+ * The workers are started on first use and kept waiting for the next job.
+ * Parallel jobs are run one at a time, concurrent callers of large jobs
+ * are serialised. Buffers below the threshold never touch the pool.
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "chacha20_simple.h"
+
+#define POOL_MAX        16		/* threads, including the caller */
+#define POOL_SLICE_MIN  1024		/* blocks per slice, at least */
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER; /* one job at a time */
+static pthread_mutex_t job_lock  = PTHREAD_MUTEX_INITIALIZER; /* job descriptor */
+static pthread_cond_t  job_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  job_done  = PTHREAD_COND_INITIALIZER;
+
+static unsigned pool_threads   = 0;	/* configured, 0: number of CPUs */
+static size_t   pool_threshold = CHACHA20_PARALLEL_MIN;
+static unsigned pool_started   = 0;	/* workers running, ids 1.. */
+static unsigned long pool_seen[POOL_MAX]; /* last job before worker start */
+
+static struct {
+	unsigned long   generation;	/* incremented for every job */
+	unsigned        pending;	/* workers still busy */
+	unsigned        slices;
+	const chacha20_ctx *ctx;	/* counter at first block */
+	const uint8_t  *in;
+	uint8_t        *out;
+	size_t          blocks;
+} job;
+
+static inline uint64_t counter_get(const chacha20_ctx *ctx)
+{
+	return ((uint64_t)ctx->schedule[13] << 32) | ctx->schedule[12];
+}
+
+static unsigned cpu_count(void)
+{
+#	ifdef _SC_NPROCESSORS_ONLN
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (0 < n)
+		return n < POOL_MAX ? (unsigned)n : POOL_MAX;
+#	endif
+	return 1;
+}
+
+static void run_slice(unsigned i)
+{
+	size_t per   = job.blocks / job.slices;
+	size_t rest  = job.blocks % job.slices;
+	size_t first = i * per + (i < rest ? i : rest);
+	size_t count = per + (i < rest ? 1 : 0);
+	chacha20_ctx c = *job.ctx;
+
+	chacha20_counter_set(&c, counter_get(&c) + first);
+	chacha20_encrypt(&c, job.in + first * 64, job.out + first * 64, count * 64);
+	memset(&c, 0, sizeof(c));
+}
+
+static void *worker(void *arg)
+{
+	unsigned id = (unsigned)(uintptr_t)arg;
+	unsigned long seen;
+
+	pthread_mutex_lock(&job_lock);
+	seen = pool_seen[id];	/* the job may be posted before we get here */
+	for (;;) {
+		while (job.generation == seen)
+			pthread_cond_wait(&job_start, &job_lock);
+		seen = job.generation;
+		if (id < job.slices) {
+			pthread_mutex_unlock(&job_lock);
+			run_slice(id);
+			pthread_mutex_lock(&job_lock);
+			if (--job.pending == 0)
+				pthread_cond_signal(&job_done);
+		}
+	}
+	return NULL;
+}
+
+/* start workers up to n threads in total, returns the number of threads
+ * to use, fewer than n if a worker could not be started */
+static unsigned start_workers(unsigned n)
+{
+	while (pool_started + 1 < n) {
+		pthread_t t;
+		pthread_attr_t a;
+		int err;
+
+		pool_seen[pool_started + 1] = job.generation;
+		pthread_attr_init(&a);
+		pthread_attr_setdetachstate(&a, PTHREAD_CREATE_DETACHED);
+		err = pthread_create(&t, &a, worker, (void *)(uintptr_t)(pool_started + 1));
+		pthread_attr_destroy(&a);
+		if (err != 0)
+			break;
+		pool_started++;
+	}
+	return pool_started + 1 < n ? pool_started + 1 : n;
+}
+
+void chacha20_parallel_setup(unsigned threads, size_t threshold)
+{
+	__atomic_store_n(&pool_threads,
+			 threads < POOL_MAX ? threads : POOL_MAX, __ATOMIC_RELAXED);
+	__atomic_store_n(&pool_threshold, threshold, __ATOMIC_RELAXED);
+}
+
+void chacha20_encrypt_parallel(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out, size_t length)
+{
+	size_t blocks;
+	unsigned slices;
+
+	/* small buffers are done right here without waiting for the pool */
+	slices = __atomic_load_n(&pool_threads, __ATOMIC_RELAXED);
+	if (slices == 0)
+		slices = cpu_count();
+	if (length < __atomic_load_n(&pool_threshold, __ATOMIC_RELAXED) ||
+	    slices < 2)
+		goto serial;
+
+	/* use up buffered key stream */
+	if (ctx->available) {
+		size_t amount = MIN(length, ctx->available);
+		chacha20_encrypt(ctx, in, out, amount);
+		in += amount;
+		out += amount;
+		length -= amount;
+	}
+
+	blocks = length / 64;
+	if (blocks / POOL_SLICE_MIN < slices)
+		slices = blocks / POOL_SLICE_MIN;
+	if (slices < 2)
+		goto serial;
+
+	pthread_mutex_lock(&pool_lock);
+
+	slices = start_workers(slices);
+	if (slices < 2) {
+		pthread_mutex_unlock(&pool_lock);
+		goto serial;
+	}
+
+	pthread_mutex_lock(&job_lock);
+	job.ctx     = ctx;
+	job.in      = in;
+	job.out     = out;
+	job.blocks  = blocks;
+	job.slices  = slices;
+	job.pending = slices - 1;
+	job.generation++;
+	pthread_cond_broadcast(&job_start);
+	pthread_mutex_unlock(&job_lock);
+
+	run_slice(0);
+
+	pthread_mutex_lock(&job_lock);
+	while (job.pending)
+		pthread_cond_wait(&job_done, &job_lock);
+	job.ctx = NULL;
+	pthread_mutex_unlock(&job_lock);
+
+	pthread_mutex_unlock(&pool_lock);
+
+	/* continue after the whole blocks */
+	chacha20_counter_set(ctx, counter_get(ctx) + blocks);
+	in += blocks * 64;
+	out += blocks * 64;
+	length -= blocks * 64;
+
+serial:
+	chacha20_encrypt(ctx, in, out, length);
+}
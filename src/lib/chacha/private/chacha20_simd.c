@@ -0,0 +1,278 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Multi-block ChaCha20 kernels, 4 blocks in parallel (SSE2, SSSE3) or 8
+ * blocks in parallel (AVX2, AVX-512). The state words are held vertically,
+ * i.e. the n-th vector register holds state word n of all parallel blocks.
+ * The key stream is transposed back into block order and XORed against
+ * the input a vector at a time.
+ *
+ * The kernels are compiled with target attributes and bound at run time
+ * according to cpu_features(), see cpu/private/cpu_dispatch.h.
+ *
+ * The kernels only process whole 64 byte blocks and leave the rest to
+ * the scalar code in chacha20_simple.c.
+ */
+
+#include <string.h>
+#include "chacha20_simple.h"
+#include "cpu_dispatch.h"
+
+#if CPU_HAVE_X86
+# include <immintrin.h>
+#endif
+
+typedef void (*kernel_fn)(chacha20_ctx *, const uint8_t *, uint8_t *);
+
+static size_t    resolve (chacha20_ctx *, const uint8_t *, uint8_t *, size_t);
+static size_t  (*multi_xor)(chacha20_ctx *, const uint8_t *, uint8_t *, size_t) = resolve;
+static kernel_fn kernel4 = NULL;
+static kernel_fn kernel8 = NULL;
+
+/* The counter is kept in state words 12 and 13 (and continues into the
+ * nonce words 14 and 15 on overflow). The vector kernels only support
+ * the 64 bit counter, so bail out if it would wrap within a batch. */
+static inline int counter_wraps(const chacha20_ctx *ctx, size_t blocks)
+{
+	uint64_t ctr = ((uint64_t)ctx->schedule[13] << 32) | ctx->schedule[12];
+	return ctr + blocks < ctr;
+}
+
+static inline void counter_add(chacha20_ctx *ctx, size_t blocks)
+{
+	uint64_t ctr = ((uint64_t)ctx->schedule[13] << 32) | ctx->schedule[12];
+	ctr += blocks;
+	ctx->schedule[12] = ctr & UINT32_C(0xFFFFFFFF);
+	ctx->schedule[13] = ctr >> 32;
+}
+
+#if CPU_HAVE_X86
+
+/* ------------------------------------------------------------------------ *
+ * 4 blocks: SSE2, SSSE3
+ * ------------------------------------------------------------------------ */
+
+/* transpose a 4x4 matrix of 32 bit words */
+#define TRANSPOSE128(a, b, c, d) {				\
+	__m128i t0 = _mm_unpacklo_epi32(a, b);			\
+	__m128i t1 = _mm_unpacklo_epi32(c, d);			\
+	__m128i t2 = _mm_unpackhi_epi32(a, b);			\
+	__m128i t3 = _mm_unpackhi_epi32(c, d);			\
+	a = _mm_unpacklo_epi64(t0, t1);				\
+	b = _mm_unpackhi_epi64(t0, t1);				\
+	c = _mm_unpacklo_epi64(t2, t3);				\
+	d = _mm_unpackhi_epi64(t2, t3);				\
+}
+
+#define XOR128(out, in, v) \
+	_mm_storeu_si128((__m128i *)(out), \
+			 _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in)), v))
+
+#define ROTL128(v, n) \
+	_mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+
+/* SSE2: shift and or */
+#define KERNEL   chacha20_blocks4_sse2
+#define TARGET   "sse2"
+#define ROT16(v) ROTL128(v, 16)
+#define ROT12(v) ROTL128(v, 12)
+#define ROT8(v)  ROTL128(v,  8)
+#define ROT7(v)  ROTL128(v,  7)
+#include "chacha20_simd_x4.h"
+#undef KERNEL
+#undef TARGET
+#undef ROT16
+#undef ROT8
+
+/* SSSE3: byte shuffle for the 16 and 8 bit rotations */
+#define KERNEL   chacha20_blocks4_ssse3
+#define TARGET   "ssse3"
+#define ROT16(v) _mm_shuffle_epi8(v, _mm_set_epi8(13,12,15,14, 9,8,11,10, \
+						  5,4,7,6, 1,0,3,2))
+#define ROT8(v)  _mm_shuffle_epi8(v, _mm_set_epi8(14,13,12,15, 10,9,8,11, \
+						  6,5,4,7, 2,1,0,3))
+#include "chacha20_simd_x4.h"
+#undef KERNEL
+#undef TARGET
+#undef ROT16
+#undef ROT12
+#undef ROT8
+#undef ROT7
+
+/* ------------------------------------------------------------------------ *
+ * 8 blocks: AVX2, AVX-512
+ * ------------------------------------------------------------------------ */
+
+/* transpose two 4x4 matrices of 32 bit words (one per 128 bit lane) */
+#define TRANSPOSE256(a, b, c, d) {				\
+	__m256i t0 = _mm256_unpacklo_epi32(a, b);		\
+	__m256i t1 = _mm256_unpacklo_epi32(c, d);		\
+	__m256i t2 = _mm256_unpackhi_epi32(a, b);		\
+	__m256i t3 = _mm256_unpackhi_epi32(c, d);		\
+	a = _mm256_unpacklo_epi64(t0, t1);			\
+	b = _mm256_unpackhi_epi64(t0, t1);			\
+	c = _mm256_unpacklo_epi64(t2, t3);			\
+	d = _mm256_unpackhi_epi64(t2, t3);			\
+}
+
+#define XOR256(out, in, v) \
+	_mm256_storeu_si256((__m256i *)(out), \
+			    _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(in)), v))
+
+#define ROTL256(v, n) \
+	_mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+
+#define SHUF16 _mm256_set_epi8(13,12,15,14, 9,8,11,10, 5,4,7,6, 1,0,3,2, \
+			       13,12,15,14, 9,8,11,10, 5,4,7,6, 1,0,3,2)
+#define SHUF8  _mm256_set_epi8(14,13,12,15, 10,9,8,11, 6,5,4,7, 2,1,0,3, \
+			       14,13,12,15, 10,9,8,11, 6,5,4,7, 2,1,0,3)
+
+/* AVX2: byte shuffle for the 16 and 8 bit rotations */
+#define KERNEL   chacha20_blocks8_avx2
+#define TARGET   "avx2"
+#define ROT16(v) _mm256_shuffle_epi8(v, SHUF16)
+#define ROT12(v) ROTL256(v, 12)
+#define ROT8(v)  _mm256_shuffle_epi8(v, SHUF8)
+#define ROT7(v)  ROTL256(v,  7)
+#include "chacha20_simd_x8.h"
+#undef KERNEL
+#undef TARGET
+#undef ROT16
+#undef ROT12
+#undef ROT8
+#undef ROT7
+
+/* AVX-512: native rotations on 256 bit registers (AVX512VL) */
+#define KERNEL   chacha20_blocks8_avx512
+#define TARGET   "avx2,avx512f,avx512vl"
+#define ROT16(v) _mm256_rol_epi32(v, 16)
+#define ROT12(v) _mm256_rol_epi32(v, 12)
+#define ROT8(v)  _mm256_rol_epi32(v,  8)
+#define ROT7(v)  _mm256_rol_epi32(v,  7)
+#include "chacha20_simd_x8.h"
+#undef KERNEL
+#undef TARGET
+#undef ROT16
+#undef ROT12
+#undef ROT8
+#undef ROT7
+
+#endif /* CPU_HAVE_X86 */
+
+/* ------------------------------------------------------------------------ *
+ * Dispatch
+ * ------------------------------------------------------------------------ */
+
+static size_t scalar_xor(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+	(void)ctx; (void)in; (void)out; (void)blocks;
+	return 0;
+}
+
+static size_t vector_xor(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+	size_t done = 0;
+
+	if (counter_wraps(ctx, blocks))
+		return 0;
+
+	if (kernel8 != NULL)
+		while (8 <= blocks - done) {
+			kernel8(ctx, in, out);
+			counter_add(ctx, 8);
+			in += 8 * 64;
+			out += 8 * 64;
+			done += 8;
+		}
+
+	if (kernel4 != NULL)
+		while (4 <= blocks - done) {
+			kernel4(ctx, in, out);
+			counter_add(ctx, 4);
+			in += 4 * 64;
+			out += 4 * 64;
+			done += 4;
+		}
+
+	return done;
+}
+
+static void bind(void)
+{
+	unsigned f = cpu_features();
+
+	kernel4 = kernel8 = NULL;
+#	if CPU_HAVE_X86
+	if (f & CPU_AVX512)
+		kernel8 = chacha20_blocks8_avx512;
+	else if (f & CPU_AVX2)
+		kernel8 = chacha20_blocks8_avx2;
+	if (f & CPU_SSSE3)
+		kernel4 = chacha20_blocks4_ssse3;
+	else if (f & CPU_SSE2)
+		kernel4 = chacha20_blocks4_sse2;
+#	endif
+	multi_xor = (kernel4 == NULL && kernel8 == NULL) ? scalar_xor : vector_xor;
+	(void)f;
+}
+
+static size_t resolve(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+	chacha20_dispatch_init();
+	return multi_xor(ctx, in, out, blocks);
+}
+
+/* ------------------------------------------------------------------------ *
+ * Public
+ * ------------------------------------------------------------------------ */
+
+void chacha20_dispatch_init(void)
+{
+	cpu_dispatch_register(bind);
+}
+
+const char *chacha20_kernel_name(void)
+{
+	if (multi_xor == resolve)
+		chacha20_dispatch_init();
+#	if CPU_HAVE_X86
+	if (kernel8 == chacha20_blocks8_avx512)
+		return "avx512";
+	if (kernel8 == chacha20_blocks8_avx2)
+		return "avx2";
+	if (kernel4 == chacha20_blocks4_ssse3)
+		return "ssse3";
+	if (kernel4 == chacha20_blocks4_sse2)
+		return "sse2";
+#	endif
+	return "scalar";
+}
+
+size_t chacha20_multi_xor(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+	return multi_xor(ctx, in, out, blocks);
+}
+
+/* end */
@@ -0,0 +1,86 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Template for a 4 block ChaCha20 kernel, included by chacha20_simd.c
+ * with the macros KERNEL, TARGET and ROT16, ROT12, ROT8, ROT7 defined.
+ */
+
+#define QR4(a, b, c, d)						\
+	a = _mm_add_epi32(a, b); d = ROT16(_mm_xor_si128(d, a));	\
+	c = _mm_add_epi32(c, d); b = ROT12(_mm_xor_si128(b, c));	\
+	a = _mm_add_epi32(a, b); d = ROT8 (_mm_xor_si128(d, a));	\
+	c = _mm_add_epi32(c, d); b = ROT7 (_mm_xor_si128(b, c));
+
+static CPU_TARGET(TARGET)
+void KERNEL(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out)
+{
+	const uint32_t *s = ctx->schedule;
+	__m128i x[16], o[16];
+	uint32_t lo[4], hi[4];
+	uint64_t ctr = ((uint64_t)s[13] << 32) | s[12];
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		lo[i] = (ctr + i) & UINT32_C(0xFFFFFFFF);
+		hi[i] = (ctr + i) >> 32;
+	}
+	for (i = 0; i < 16; i++)
+		o[i] = _mm_set1_epi32(s[i]);
+	o[12] = _mm_loadu_si128((const __m128i *)lo);
+	o[13] = _mm_loadu_si128((const __m128i *)hi);
+
+	for (i = 0; i < 16; i++)
+		x[i] = o[i];
+
+	for (i = 0; i < 10; i++) {
+		QR4(x[0], x[4], x[ 8], x[12])
+		QR4(x[1], x[5], x[ 9], x[13])
+		QR4(x[2], x[6], x[10], x[14])
+		QR4(x[3], x[7], x[11], x[15])
+		QR4(x[0], x[5], x[10], x[15])
+		QR4(x[1], x[6], x[11], x[12])
+		QR4(x[2], x[7], x[ 8], x[13])
+		QR4(x[3], x[4], x[ 9], x[14])
+	}
+	for (i = 0; i < 16; i++)
+		x[i] = _mm_add_epi32(x[i], o[i]);
+
+	TRANSPOSE128(x[ 0], x[ 1], x[ 2], x[ 3])
+	TRANSPOSE128(x[ 4], x[ 5], x[ 6], x[ 7])
+	TRANSPOSE128(x[ 8], x[ 9], x[10], x[11])
+	TRANSPOSE128(x[12], x[13], x[14], x[15])
+
+	/* now x[4*g+b] holds words 4g..4g+3 of block b */
+	for (i = 0; i < 4; i++) {
+		XOR128(out + 64*i +  0, in + 64*i +  0, x[i +  0]);
+		XOR128(out + 64*i + 16, in + 64*i + 16, x[i +  4]);
+		XOR128(out + 64*i + 32, in + 64*i + 32, x[i +  8]);
+		XOR128(out + 64*i + 48, in + 64*i + 48, x[i + 12]);
+	}
+}
+
+#undef QR4
+
+/* end */
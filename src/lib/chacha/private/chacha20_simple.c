@@ -51,6 +51,13 @@ void chacha20_counter_set(chacha20_ctx *ctx, uint64_t counter)
   ctx->available = 0;
 }
 
+void chacha20_setup_ietf(chacha20_ctx *ctx, const uint8_t key[32], const uint8_t nonce[12], uint32_t counter)
+{
+  chacha20_setup(ctx, key, 32, (uint8_t *)nonce + 4);
+  ctx->schedule[12] = counter;
+  ctx->schedule[13] = LE(nonce+0);
+}
+
 #define QUARTERROUND(x, a, b, c, d) \
     x[a] += x[b]; x[d] = ROTL32(x[d] ^ x[a], 16); \
     x[c] += x[d]; x[b] = ROTL32(x[b] ^ x[c], 12); \
@@ -93,7 +100,17 @@ void chacha20_block(chacha20_ctx *ctx, uint32_t output[16])
 static inline void chacha20_xor(uint8_t *keystream, const uint8_t **in, uint8_t **out, size_t length)
 {
   uint8_t *end_keystream = keystream + length;
-  do { *(*out)++ = *(*in)++ ^ *keystream++; } while (keystream < end_keystream);
+  //Word at a time as long as possible, memcpy() takes care of alignment
+  while (keystream + sizeof(uint64_t) <= end_keystream)
+  {
+    uint64_t k, w;
+    memcpy(&k, keystream, sizeof(k));
+    memcpy(&w, *in, sizeof(w));
+    w ^= k;
+    memcpy(*out, &w, sizeof(w));
+    keystream += sizeof(w); *in += sizeof(w); *out += sizeof(w);
+  }
+  while (keystream < end_keystream) { *(*out)++ = *(*in)++ ^ *keystream++; }
 }
 
 void chacha20_encrypt(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out, size_t length)
@@ -111,6 +128,15 @@ void chacha20_encrypt(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out, size_t
       length -= amount;
     }
 
+    //Then, handle whole blocks in parallel if supported
+    if (length >= CHACHA20_MULTI_MIN)
+    {
+      size_t amount = chacha20_multi_xor(ctx, in, out, length / sizeof(ctx->keystream)) * sizeof(ctx->keystream);
+      in += amount;
+      out += amount;
+      length -= amount;
+    }
+
     //Then, handle new blocks
     while (length)
     {
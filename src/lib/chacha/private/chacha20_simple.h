@@ -45,12 +45,40 @@ void chacha20_setup(chacha20_ctx *ctx, const uint8_t *key, size_t length, uint8_
 //Call this if you need to process a particular block number
 void chacha20_counter_set(chacha20_ctx *ctx, uint64_t counter);
 
+//Initialize a chacha20_ctx with a 32 bit block counter and a 96 bit nonce as in RFC 8439. The counter
+//must not wrap around (i.e. at most 256GiB of key stream) and chacha20_counter_set() must not be used
+void chacha20_setup_ietf(chacha20_ctx *ctx, const uint8_t key[32], const uint8_t nonce[12], uint32_t counter);
+
 //Raw keystream for the current block, convert output to uint8_t[] for individual bytes. Counter is incremented upon use
 void chacha20_block(chacha20_ctx *ctx, uint32_t output[16]);
 
 //Encrypt an arbitrary amount of plaintext, call continuously as needed
 void chacha20_encrypt(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out, size_t length);
 
+//Minimum length for chacha20_encrypt() to try chacha20_multi_xor() on whole blocks
+#define CHACHA20_MULTI_MIN (4 * 64)
+
+//Encrypt whole blocks in parallel (if supported), returns number of blocks processed. Counter is incremented upon use
+size_t chacha20_multi_xor(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out, size_t blocks);
+
+//Bind the chacha20_multi_xor() kernel to the best one supported by the CPU, done implicitly on first use
+void chacha20_dispatch_init(void);
+
+//Name of the kernel bound to chacha20_multi_xor()
+const char *chacha20_kernel_name(void);
+
+//Default minimum length for chacha20_encrypt_parallel() to use more than one thread
+#define CHACHA20_PARALLEL_MIN (256 * 1024)
+
+//Encrypt as chacha20_encrypt() with the whole blocks split into slices processed by a
+//pool of worker threads (started on first use and kept), output is the same. Counter
+//is incremented upon use. Falls back to chacha20_encrypt() below the threshold length
+void chacha20_encrypt_parallel(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out, size_t length);
+
+//Set the number of threads (including the caller, 0 for the number of CPUs, 1 for no
+//parallel processing) and the threshold length for chacha20_encrypt_parallel()
+void chacha20_parallel_setup(unsigned threads, size_t threshold);
+
 #if 0
 //Decrypt an arbitrary amount of ciphertext. Actually, for chacha20, decryption is the same function as encryption
 void chacha20_decrypt(chacha20_ctx *ctx, const uint8_t *in, uint8_t *out, size_t length);
@@ -0,0 +1,536 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Poly1305 following the public domain poly1305-donna code by Andrew Moon.
+ *
+ * The accumulator h and the key r are kept as five 26 bit limbs. Whole
+ * message blocks are processed by a kernel bound at run time according to
+ * cpu_features(), see cpu/private/cpu_dispatch.h:
+ *
+ *   radix26 -- portable, all products fit into 64 bit words
+ *   radix44 -- three 44 bit limbs and 128 bit products, used instead of
+ *              radix26 where the compiler supports 128 bit integers
+ *              (unless compiled with -DPOLY1305_RADIX26)
+ *   avx2    -- four blocks in parallel, lane j of the accumulator holds
+ *              the blocks 4k+j multiplied by r^4 in every round and by
+ *              r^(4-j) in the last one, so summing up the lanes gives the
+ *              same result as the serial code
+ *
+ * The powers r^2 .. r^4 used by the avx2 kernel are set up on first use.
+ */
+
+#include <string.h>
+#include "poly1305.h"
+#include "cpu_dispatch.h"
+
+#if CPU_HAVE_X86
+# include <immintrin.h>
+#endif
+
+#if defined(__SIZEOF_INT128__) && !defined(POLY1305_RADIX26)
+# define POLY1305_RADIX 44
+#else
+# define POLY1305_RADIX 26
+#endif
+
+/* minimum length for the avx2 kernel */
+#define POLY1305_AVX2_MIN (4 * 4 * POLY1305_BLOCK_LEN)
+
+#define U8TO32(p) \
+	(((uint32_t)((p)[0])      ) | ((uint32_t)((p)[1]) <<  8) | \
+	 ((uint32_t)((p)[2]) << 16) | ((uint32_t)((p)[3]) << 24))
+
+#define U32TO8(p, v) \
+	do { (p)[0] = (uint8_t)((v)      ); (p)[1] = (uint8_t)((v) >>  8); \
+	     (p)[2] = (uint8_t)((v) >> 16); (p)[3] = (uint8_t)((v) >> 24); } while (0)
+
+#define U8TO64(p) ((uint64_t)U8TO32(p) | ((uint64_t)U8TO32((p) + 4) << 32))
+
+#define M26 0x3ffffffu
+
+typedef struct
+{
+	uint32_t r[4][5];	/* r^1 .. r^4 */
+	uint32_t h[5];
+	uint32_t pad[4];
+	uint32_t npowers;	/* powers of r set up */
+	size_t   leftover;
+	uint8_t  buffer[POLY1305_BLOCK_LEN];
+} poly1305_state;
+
+typedef char poly1305_state_fits[sizeof(poly1305_state) <= sizeof(poly1305_ctx) ? 1 : -1];
+
+typedef void (*blocks_fn)(poly1305_state *, const uint8_t *, size_t, uint32_t);
+
+static void resolve(poly1305_state *, const uint8_t *, size_t, uint32_t);
+static blocks_fn blocks = resolve;
+
+/* ------------------------------------------------------------------------ *
+ * Radix 2^26
+ * ------------------------------------------------------------------------ */
+
+/* partial reduction of the product limbs d[] into h[] */
+static inline void carry26(uint32_t h[5], uint64_t d0, uint64_t d1, uint64_t d2,
+			   uint64_t d3, uint64_t d4)
+{
+	uint32_t c;
+
+	c = (uint32_t)(d0 >> 26); h[0] = (uint32_t)d0 & M26;
+	d1 += c; c = (uint32_t)(d1 >> 26); h[1] = (uint32_t)d1 & M26;
+	d2 += c; c = (uint32_t)(d2 >> 26); h[2] = (uint32_t)d2 & M26;
+	d3 += c; c = (uint32_t)(d3 >> 26); h[3] = (uint32_t)d3 & M26;
+	d4 += c; c = (uint32_t)(d4 >> 26); h[4] = (uint32_t)d4 & M26;
+	h[0] += c * 5; c = h[0] >> 26; h[0] &= M26;
+	h[1] += c;
+}
+
+/* h = a * b (mod 2^130 - 5), partially reduced */
+static inline void mul26(uint32_t h[5], const uint32_t a[5], const uint32_t b[5])
+{
+	const uint32_t s1 = b[1] * 5, s2 = b[2] * 5, s3 = b[3] * 5, s4 = b[4] * 5;
+
+	carry26(h,
+		(uint64_t)a[0] * b[0] + (uint64_t)a[1] * s4 + (uint64_t)a[2] * s3 +
+		(uint64_t)a[3] * s2 + (uint64_t)a[4] * s1,
+		(uint64_t)a[0] * b[1] + (uint64_t)a[1] * b[0] + (uint64_t)a[2] * s4 +
+		(uint64_t)a[3] * s3 + (uint64_t)a[4] * s2,
+		(uint64_t)a[0] * b[2] + (uint64_t)a[1] * b[1] + (uint64_t)a[2] * b[0] +
+		(uint64_t)a[3] * s4 + (uint64_t)a[4] * s3,
+		(uint64_t)a[0] * b[3] + (uint64_t)a[1] * b[2] + (uint64_t)a[2] * b[1] +
+		(uint64_t)a[3] * b[0] + (uint64_t)a[4] * s4,
+		(uint64_t)a[0] * b[4] + (uint64_t)a[1] * b[3] + (uint64_t)a[2] * b[2] +
+		(uint64_t)a[3] * b[1] + (uint64_t)a[4] * b[0]);
+}
+
+#if POLY1305_RADIX == 26
+
+/* add blocks of 16 bytes, hibit is 1 << 24 for message blocks and 0 for
+ * the padded final block */
+static void blocks26(poly1305_state *st, const uint8_t *m, size_t bytes, uint32_t hibit)
+{
+	uint32_t h[5];
+
+	memcpy(h, st->h, sizeof(h));
+
+	while (bytes >= POLY1305_BLOCK_LEN) {
+		h[0] += (U8TO32(m +  0)     ) & M26;
+		h[1] += (U8TO32(m +  3) >> 2) & M26;
+		h[2] += (U8TO32(m +  6) >> 4) & M26;
+		h[3] += (U8TO32(m +  9) >> 6);
+		h[4] += (U8TO32(m + 12) >> 8) | hibit;
+
+		mul26(h, h, st->r[0]);
+
+		m += POLY1305_BLOCK_LEN;
+		bytes -= POLY1305_BLOCK_LEN;
+	}
+
+	memcpy(st->h, h, sizeof(h));
+}
+
+#endif /* POLY1305_RADIX == 26 */
+
+/* ------------------------------------------------------------------------ *
+ * Radix 2^44
+ * ------------------------------------------------------------------------ */
+
+#if POLY1305_RADIX == 44
+
+typedef unsigned __int128 uint128_t;
+
+#define M44 0xfffffffffffull
+#define M42 0x3ffffffffffull
+
+static void blocks44(poly1305_state *st, const uint8_t *m, size_t bytes, uint32_t hibit)
+{
+	const uint32_t *u = st->r[0];
+	const uint64_t hib = hibit ? (uint64_t)1 << 40 : 0;
+	uint64_t r0, r1, r2, s1, s2, h0, h1, h2, c, t0, t1;
+	uint128_t d0, d1, d2;
+
+	/* see blocks26() for the arguments, r and h are converted to 44 bit
+	 * limbs and back */
+	r0 = ((uint64_t)u[0]       | ((uint64_t)u[1] << 26)) & M44;
+	r1 = ((uint64_t)u[1] >> 18 | ((uint64_t)u[2] <<  8) | ((uint64_t)u[3] << 34)) & M44;
+	r2 = ((uint64_t)u[3] >> 10 | ((uint64_t)u[4] << 16));
+	s1 = r1 * (5 << 2);
+	s2 = r2 * (5 << 2);
+
+	t0 = st->h[0] + ((uint64_t)st->h[1] << 26);
+	h0 = t0 & M44;
+	t1 = (t0 >> 44) + ((uint64_t)st->h[2] << 8) + ((uint64_t)st->h[3] << 34);
+	h1 = t1 & M44;
+	h2 = (t1 >> 44) + ((uint64_t)st->h[4] << 16);
+
+	while (bytes >= POLY1305_BLOCK_LEN) {
+		t0 = U8TO64(m + 0);
+		t1 = U8TO64(m + 8);
+
+		h0 += t0 & M44;
+		h1 += ((t0 >> 44) | (t1 << 20)) & M44;
+		h2 += ((t1 >> 24) & M42) | hib;
+
+		d0 = (uint128_t)h0 * r0 + (uint128_t)h1 * s2 + (uint128_t)h2 * s1;
+		d1 = (uint128_t)h0 * r1 + (uint128_t)h1 * r0 + (uint128_t)h2 * s2;
+		d2 = (uint128_t)h0 * r2 + (uint128_t)h1 * r1 + (uint128_t)h2 * r0;
+
+		c = (uint64_t)(d0 >> 44); h0 = (uint64_t)d0 & M44;
+		d1 += c; c = (uint64_t)(d1 >> 44); h1 = (uint64_t)d1 & M44;
+		d2 += c; c = (uint64_t)(d2 >> 42); h2 = (uint64_t)d2 & M42;
+		h0 += c * 5; c = h0 >> 44; h0 &= M44;
+		h1 += c;
+
+		m += POLY1305_BLOCK_LEN;
+		bytes -= POLY1305_BLOCK_LEN;
+	}
+
+	/* back to 26 bit limbs */
+	c = h1 >> 44; h1 &= M44; h2 += c;
+	st->h[0] = (uint32_t)h0 & M26;
+	st->h[1] = (uint32_t)((h0 >> 26) | (h1 << 18)) & M26;
+	st->h[2] = (uint32_t)(h1 >>  8) & M26;
+	st->h[3] = (uint32_t)((h1 >> 34) | (h2 << 10)) & M26;
+	st->h[4] = (uint32_t)(h2 >> 16);
+}
+
+# define blocks_scalar blocks44
+#else
+# define blocks_scalar blocks26
+#endif /* POLY1305_RADIX == 44 */
+
+/* ------------------------------------------------------------------------ *
+ * AVX2
+ * ------------------------------------------------------------------------ */
+
+#if CPU_HAVE_X86
+
+/* set up r^2 .. r^4 */
+static void powers(poly1305_state *st)
+{
+	mul26(st->r[1], st->r[0], st->r[0]);
+	mul26(st->r[2], st->r[1], st->r[0]);
+	mul26(st->r[3], st->r[2], st->r[0]);
+	st->npowers = 4;
+}
+
+#define MUL(a, b) _mm256_mul_epu32(a, b)
+#define ADD(a, b) _mm256_add_epi64(a, b)
+
+/* a = a * r (mod 2^130 - 5) in all lanes, s = 5 * r */
+CPU_TARGET("avx2")
+static inline __attribute__((always_inline))
+void mul_avx2(__m256i a[5], const __m256i r[5], const __m256i s[5])
+{
+	const __m256i mask = _mm256_set1_epi64x(M26);
+	__m256i d0, d1, d2, d3, d4, c;
+
+	d0 = ADD(ADD(ADD(ADD(MUL(a[0], r[0]), MUL(a[1], s[4])), MUL(a[2], s[3])),
+		     MUL(a[3], s[2])), MUL(a[4], s[1]));
+	d1 = ADD(ADD(ADD(ADD(MUL(a[0], r[1]), MUL(a[1], r[0])), MUL(a[2], s[4])),
+		     MUL(a[3], s[3])), MUL(a[4], s[2]));
+	d2 = ADD(ADD(ADD(ADD(MUL(a[0], r[2]), MUL(a[1], r[1])), MUL(a[2], r[0])),
+		     MUL(a[3], s[4])), MUL(a[4], s[3]));
+	d3 = ADD(ADD(ADD(ADD(MUL(a[0], r[3]), MUL(a[1], r[2])), MUL(a[2], r[1])),
+		     MUL(a[3], r[0])), MUL(a[4], s[4]));
+	d4 = ADD(ADD(ADD(ADD(MUL(a[0], r[4]), MUL(a[1], r[3])), MUL(a[2], r[2])),
+		     MUL(a[3], r[1])), MUL(a[4], r[0]));
+
+	c = _mm256_srli_epi64(d0, 26); a[0] = _mm256_and_si256(d0, mask);
+	d1 = ADD(d1, c); c = _mm256_srli_epi64(d1, 26); a[1] = _mm256_and_si256(d1, mask);
+	d2 = ADD(d2, c); c = _mm256_srli_epi64(d2, 26); a[2] = _mm256_and_si256(d2, mask);
+	d3 = ADD(d3, c); c = _mm256_srli_epi64(d3, 26); a[3] = _mm256_and_si256(d3, mask);
+	d4 = ADD(d4, c); c = _mm256_srli_epi64(d4, 26); a[4] = _mm256_and_si256(d4, mask);
+	a[0] = ADD(a[0], ADD(c, _mm256_slli_epi64(c, 2)));
+	c = _mm256_srli_epi64(a[0], 26); a[0] = _mm256_and_si256(a[0], mask);
+	a[1] = ADD(a[1], c);
+}
+
+CPU_TARGET("avx2")
+static void blocks_avx2(poly1305_state *st, const uint8_t *m, size_t bytes, uint32_t hibit)
+{
+	const __m256i mask = _mm256_set1_epi64x(M26);
+	const __m256i hib  = _mm256_set1_epi64x(hibit);
+	__m256i r4[5], s4[5], rl[5], sl[5], a[5], lo, hi, t0, t1;
+	size_t n = bytes & ~(size_t)(4 * POLY1305_BLOCK_LEN - 1);
+	uint64_t v[4], d[5], c;
+	int i;
+
+	if (n < POLY1305_AVX2_MIN) {
+		blocks_scalar(st, m, bytes, hibit);
+		return;
+	}
+	if (st->npowers < 4)
+		powers(st);
+
+	/* the lanes hold the blocks 0, 2, 1, 3 of a group, see below */
+	for (i = 0; i < 5; i++) {
+		r4[i] = _mm256_set1_epi64x(st->r[3][i]);
+		s4[i] = _mm256_set1_epi64x(st->r[3][i] * 5);
+		rl[i] = _mm256_set_epi64x(st->r[0][i], st->r[2][i],
+					  st->r[1][i], st->r[3][i]);
+		sl[i] = _mm256_set_epi64x(st->r[0][i] * 5, st->r[2][i] * 5,
+					  st->r[1][i] * 5, st->r[3][i] * 5);
+		a[i]  = _mm256_set_epi64x(0, 0, 0, st->h[i]);
+	}
+	bytes -= n;
+
+	for (;;) {
+		/* 64 bit halves of the blocks in lanes 0, 2, 1, 3 */
+		t0 = _mm256_loadu_si256((const __m256i *)(m +  0));
+		t1 = _mm256_loadu_si256((const __m256i *)(m + 32));
+		lo = _mm256_unpacklo_epi64(t0, t1);
+		hi = _mm256_unpackhi_epi64(t0, t1);
+
+		a[0] = ADD(a[0], _mm256_and_si256(lo, mask));
+		a[1] = ADD(a[1], _mm256_and_si256(_mm256_srli_epi64(lo, 26), mask));
+		a[2] = ADD(a[2], _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi64(lo, 52),
+								  _mm256_slli_epi64(hi, 12)), mask));
+		a[3] = ADD(a[3], _mm256_and_si256(_mm256_srli_epi64(hi, 14), mask));
+		a[4] = ADD(a[4], _mm256_or_si256(_mm256_srli_epi64(hi, 40), hib));
+
+		m += 4 * POLY1305_BLOCK_LEN;
+		n -= 4 * POLY1305_BLOCK_LEN;
+		if (n == 0)
+			break;
+		mul_avx2(a, r4, s4);
+	}
+	mul_avx2(a, rl, sl); /* r^4, r^2, r^3, r^1 for the blocks 0, 2, 1, 3 */
+
+	/* sum up lanes */
+	for (i = 0; i < 5; i++) {
+		_mm256_storeu_si256((__m256i *)v, a[i]);
+		d[i] = v[0] + v[1] + v[2] + v[3];
+	}
+	c = d[0] >> 26; st->h[0] = (uint32_t)d[0] & M26;
+	d[1] += c; c = d[1] >> 26; st->h[1] = (uint32_t)d[1] & M26;
+	d[2] += c; c = d[2] >> 26; st->h[2] = (uint32_t)d[2] & M26;
+	d[3] += c; c = d[3] >> 26; st->h[3] = (uint32_t)d[3] & M26;
+	d[4] += c; c = d[4] >> 26; st->h[4] = (uint32_t)d[4] & M26;
+	st->h[0] += (uint32_t)c * 5; c = st->h[0] >> 26; st->h[0] &= M26;
+	st->h[1] += (uint32_t)c;
+
+	if (bytes)
+		blocks_scalar(st, m, bytes, hibit);
+}
+
+#undef MUL
+#undef ADD
+
+#endif /* CPU_HAVE_X86 */
+
+/* ------------------------------------------------------------------------ *
+ * Dispatch
+ * ------------------------------------------------------------------------ */
+
+static void bind(void)
+{
+	unsigned f = cpu_features();
+
+	blocks = blocks_scalar;
+#	if CPU_HAVE_X86
+	if (f & CPU_AVX2)
+		blocks = blocks_avx2;
+#	endif
+	(void)f;
+}
+
+static void resolve(poly1305_state *st, const uint8_t *m, size_t bytes, uint32_t hibit)
+{
+	poly1305_dispatch_init();
+	blocks(st, m, bytes, hibit);
+}
+
+/* ------------------------------------------------------------------------ *
+ * Public
+ * ------------------------------------------------------------------------ */
+
+void poly1305_dispatch_init(void)
+{
+	cpu_dispatch_register(bind);
+}
+
+const char *poly1305_kernel_name(void)
+{
+	if (blocks == resolve)
+		poly1305_dispatch_init();
+#	if CPU_HAVE_X86
+	if (blocks == blocks_avx2)
+		return "avx2";
+#	endif
+	return POLY1305_RADIX == 44 ? "radix44" : "radix26";
+}
+
+void poly1305_init(poly1305_ctx *ctx, const uint8_t key[POLY1305_KEY_LEN])
+{
+	poly1305_state *st = (poly1305_state *)ctx;
+
+	/* r &= 0xffffffc0ffffffc0ffffffc0fffffff */
+	st->r[0][0] = (U8TO32(key +  0)     ) & 0x3ffffff;
+	st->r[0][1] = (U8TO32(key +  3) >> 2) & 0x3ffff03;
+	st->r[0][2] = (U8TO32(key +  6) >> 4) & 0x3ffc0ff;
+	st->r[0][3] = (U8TO32(key +  9) >> 6) & 0x3f03fff;
+	st->r[0][4] = (U8TO32(key + 12) >> 8) & 0x00fffff;
+	st->npowers = 1;
+
+	memset(st->h, 0, sizeof(st->h));
+
+	st->pad[0] = U8TO32(key + 16);
+	st->pad[1] = U8TO32(key + 20);
+	st->pad[2] = U8TO32(key + 24);
+	st->pad[3] = U8TO32(key + 28);
+
+	st->leftover = 0;
+}
+
+void poly1305_update(poly1305_ctx *ctx, const uint8_t *in, size_t length)
+{
+	poly1305_state *st = (poly1305_state *)ctx;
+	size_t n;
+
+	/* complete a partial block */
+	if (st->leftover) {
+		n = POLY1305_BLOCK_LEN - st->leftover;
+		if (n > length)
+			n = length;
+		memcpy(st->buffer + st->leftover, in, n);
+		st->leftover += n;
+		in += n;
+		length -= n;
+		if (st->leftover < POLY1305_BLOCK_LEN)
+			return;
+		blocks_scalar(st, st->buffer, POLY1305_BLOCK_LEN, 1 << 24);
+		st->leftover = 0;
+	}
+
+	/* whole blocks */
+	n = length & ~(size_t)(POLY1305_BLOCK_LEN - 1);
+	if (n) {
+		blocks(st, in, n, 1 << 24);
+		in += n;
+		length -= n;
+	}
+
+	/* keep the rest */
+	if (length) {
+		memcpy(st->buffer, in, length);
+		st->leftover = length;
+	}
+}
+
+void poly1305_pad16(poly1305_ctx *ctx)
+{
+	poly1305_state *st = (poly1305_state *)ctx;
+
+	if (st->leftover) {
+		memset(st->buffer + st->leftover, 0, POLY1305_BLOCK_LEN - st->leftover);
+		blocks_scalar(st, st->buffer, POLY1305_BLOCK_LEN, 1 << 24);
+		st->leftover = 0;
+	}
+}
+
+void poly1305_finish(poly1305_ctx *ctx, uint8_t tag[POLY1305_TAG_LEN])
+{
+	poly1305_state *st = (poly1305_state *)ctx;
+	uint32_t h0, h1, h2, h3, h4, c;
+	uint32_t g0, g1, g2, g3, g4, mask;
+	uint64_t f;
+
+	/* final partial block, padded with 1 then zeros */
+	if (st->leftover) {
+		size_t i = st->leftover;
+		st->buffer[i++] = 1;
+		for (; i < POLY1305_BLOCK_LEN; i++)
+			st->buffer[i] = 0;
+		blocks_scalar(st, st->buffer, POLY1305_BLOCK_LEN, 0);
+	}
+
+	/* fully carry h */
+	h0 = st->h[0]; h1 = st->h[1]; h2 = st->h[2]; h3 = st->h[3]; h4 = st->h[4];
+
+		     c = h1 >> 26; h1 &= M26;
+	h2 +=     c; c = h2 >> 26; h2 &= M26;
+	h3 +=     c; c = h3 >> 26; h3 &= M26;
+	h4 +=     c; c = h4 >> 26; h4 &= M26;
+	h0 += c * 5; c = h0 >> 26; h0 &= M26;
+	h1 +=     c;
+
+	/* g = h + -p = h - (2^130 - 5) */
+	g0 = h0 + 5; c = g0 >> 26; g0 &= M26;
+	g1 = h1 + c; c = g1 >> 26; g1 &= M26;
+	g2 = h2 + c; c = g2 >> 26; g2 &= M26;
+	g3 = h3 + c; c = g3 >> 26; g3 &= M26;
+	g4 = h4 + c - (1UL << 26);
+
+	/* select h if h < p, or h - p if h >= p (constant time) */
+	mask = (g4 >> 31) - 1;
+	g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+	mask = ~mask;
+	h0 = (h0 & mask) | g0;
+	h1 = (h1 & mask) | g1;
+	h2 = (h2 & mask) | g2;
+	h3 = (h3 & mask) | g3;
+	h4 = (h4 & mask) | g4;
+
+	/* h = h % 2^128 */
+	h0 = ((h0      ) | (h1 << 26)) & 0xffffffff;
+	h1 = ((h1 >>  6) | (h2 << 20)) & 0xffffffff;
+	h2 = ((h2 >> 12) | (h3 << 14)) & 0xffffffff;
+	h3 = ((h3 >> 18) | (h4 <<  8)) & 0xffffffff;
+
+	/* tag = (h + pad) % 2^128 */
+	f = (uint64_t)h0 + st->pad[0]            ; h0 = (uint32_t)f;
+	f = (uint64_t)h1 + st->pad[1] + (f >> 32); h1 = (uint32_t)f;
+	f = (uint64_t)h2 + st->pad[2] + (f >> 32); h2 = (uint32_t)f;
+	f = (uint64_t)h3 + st->pad[3] + (f >> 32); h3 = (uint32_t)f;
+
+	U32TO8(tag +  0, h0);
+	U32TO8(tag +  4, h1);
+	U32TO8(tag +  8, h2);
+	U32TO8(tag + 12, h3);
+
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+void poly1305_auth(uint8_t tag[POLY1305_TAG_LEN], const uint8_t *in, size_t length,
+		   const uint8_t key[POLY1305_KEY_LEN])
+{
+	poly1305_ctx ctx;
+	poly1305_init(&ctx, key);
+	poly1305_update(&ctx, in, length);
+	poly1305_finish(&ctx, tag);
+}
+
+int poly1305_verify(const uint8_t a[POLY1305_TAG_LEN], const uint8_t b[POLY1305_TAG_LEN])
+{
+	unsigned d = 0;
+	int i;
+
+	for (i = 0; i < POLY1305_TAG_LEN; i++)
+		d |= a[i] ^ b[i];
+
+	return (1 & ((d - 1) >> 8));
+}
+
+/* end */
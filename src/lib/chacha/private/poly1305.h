@@ -0,0 +1,81 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Poly1305 one-time authenticator (D. J. Bernstein), see RFC 8439 section
+ * 2.5. The arithmetic follows the public domain poly1305-donna code by
+ * Andrew Moon.
+ */
+
+#ifndef POLY1305_H
+#define POLY1305_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define POLY1305_KEY_LEN   32
+#define POLY1305_TAG_LEN   16
+#define POLY1305_BLOCK_LEN 16
+
+//Context for the incremental functions, the layout is private
+typedef struct
+{
+  uint64_t opaque[24];
+} poly1305_ctx;
+
+//Start a message with the one-time key, the key must never be re-used
+void poly1305_init(poly1305_ctx *ctx, const uint8_t key[POLY1305_KEY_LEN]);
+
+//Add length bytes of message data, call continuously as needed
+void poly1305_update(poly1305_ctx *ctx, const uint8_t *in, size_t length);
+
+//Add zero bytes up to the next multiple of 16 message bytes
+void poly1305_pad16(poly1305_ctx *ctx);
+
+//Write the tag and wipe the context
+void poly1305_finish(poly1305_ctx *ctx, uint8_t tag[POLY1305_TAG_LEN]);
+
+//One-shot tag of a message
+void poly1305_auth(uint8_t tag[POLY1305_TAG_LEN], const uint8_t *in, size_t length,
+                   const uint8_t key[POLY1305_KEY_LEN]);
+
+//Bind the block kernel to the best one supported by the CPU, done implicitly on first use
+void poly1305_dispatch_init(void);
+
+//Name of the block kernel bound: "radix26", "radix44" or "avx2"
+const char *poly1305_kernel_name(void);
+
+//Compare two tags in constant time, returns 1 if equal and 0 otherwise
+int poly1305_verify(const uint8_t a[POLY1305_TAG_LEN], const uint8_t b[POLY1305_TAG_LEN]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POLY1305_H */
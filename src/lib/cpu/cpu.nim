@@ -0,0 +1,125 @@
+# -*- nim -*-
+#
+# $Id$
+#
+# Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+# All rights reserved.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# The author or authors of this code dedicate any and all copyright interest
+# in this code to the public domain. We make this dedication for the benefit
+# of the public at large and to the detriment of our heirs and successors.
+# We intend this dedication to be an overt act of relinquishment in
+# perpetuity of all present and future rights to this code under copyright
+# law.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+## Runtime CPU feature detection for the cipher and hash kernels.
+##
+## The C kernels (ChaCha20, Salsa20, AES, SHA256) are compiled with target
+## attributes for all supported instruction sets and bound at program start
+## to the best variant the CPU supports. The selection may be restricted
+## with the environment variable NIM_CRYPTO_CPU holding a comma separated
+## list of features, e.g.
+## ::
+##   NIM_CRYPTO_CPU=sse2          # at most SSE2 vector code, no AES-NI etc.
+##   NIM_CRYPTO_CPU=scalar        # portable code only
+##   NIM_CRYPTO_CPU=avx2,aesni    # no AVX-512, no SHA-NI
+##
+## where a vector level implies the lower ones.
+
+import
+  misc / [prjcfg]
+
+const
+  cpuHeader = "private/cpu_dispatch.h".nimSrcDirname
+  cpuCflags = "-I " & "private".nimSrcDirname
+
+{.passC: cpuCflags.}
+{.compile: "private/cpu_dispatch.c".nimSrcDirname.}
+
+type
+  CpuFeature* = enum                 ## bit order as used in cpu_dispatch.h
+    cpuSSE2, cpuSSSE3, cpuAVX2, cpuAVX512, cpuAESNI, cpuSHANI
+
+  CpuFeatures* = set[CpuFeature]
+
+# ----------------------------------------------------------------------------
+# Interface cpu_dispatch
+# ----------------------------------------------------------------------------
+
+proc cpu_features(): cuint
+  {.cdecl, header: cpuHeader, importc.}
+
+proc cpu_features_probed(): cuint
+  {.cdecl, header: cpuHeader, importc.}
+
+proc cpu_features_select(list: cstring): cuint
+  {.cdecl, header: cpuHeader, importc.}
+
+# ----------------------------------------------------------------------------
+# Private helper
+# ----------------------------------------------------------------------------
+
+proc toFeatures(mask: cuint): CpuFeatures =
+  for f in CpuFeature:
+    if (mask and (1u32 shl f.ord).cuint) != 0:
+      result.incl f
+
+# ----------------------------------------------------------------------------
+# Public functions
+# ----------------------------------------------------------------------------
+
+proc cpuFeatures*(): CpuFeatures {.inline.} =
+  ## Features used by the kernels, i.e. as probed and restricted by the
+  ## NIM_CRYPTO_CPU environment variable or by cpuSelect()
+  cpu_features().toFeatures
+
+proc cpuFeaturesProbed*(): CpuFeatures {.inline.} =
+  ## Features supported by the CPU
+  cpu_features_probed().toFeatures
+
+proc cpuSelect*(list: string): CpuFeatures {.discardable.} =
+  ## Restrict the features as with the NIM_CRYPTO_CPU environment variable
+  ## and re-bind all kernels. This function is not thread safe and should be
+  ## used for testing and benchmarking only.
+  cpu_features_select(list).toFeatures
+
+proc cpuSelect*(): CpuFeatures {.discardable.} =
+  ## Reset to the features supported by the CPU and re-bind all kernels.
+  cpu_features_select(nil).toFeatures
+
+# ----------------------------------------------------------------------------
+# Tests
+# ----------------------------------------------------------------------------
+
+when isMainModule:
+
+  when not defined(check_run):
+    echo "*** probed:   ", cpuFeaturesProbed()
+    echo "*** selected: ", cpuFeatures()
+
+  let probed = cpuFeaturesProbed()
+
+  doAssert cpuFeatures() <= probed
+  doAssert cpuSelect("scalar") == {}
+  doAssert cpuFeatures() == {}
+  doAssert cpuSelect("sse2") == probed * {cpuSSE2}
+  doAssert cpuSelect("avx2, aesni") == probed * {cpuSSE2, cpuSSSE3, cpuAVX2,
+                                                 cpuAESNI}
+  doAssert cpuSelect("avx512,shani") == probed - {cpuAESNI}
+  doAssert cpuSelect("no-such-feature") == {}
+  doAssert cpuSelect() == probed
+
+# ----------------------------------------------------------------------------
+# End
+# ----------------------------------------------------------------------------
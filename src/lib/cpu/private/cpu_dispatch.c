@@ -0,0 +1,181 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Runtime CPU feature detection and kernel dispatch
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "cpu_dispatch.h"
+
+#if CPU_HAVE_X86
+# include <cpuid.h>
+#endif
+
+#define MAX_BINDERS 16
+
+static unsigned probed   = 0;
+static unsigned selected = 0;
+static int      ready    = 0;
+
+static void   (*binders [MAX_BINDERS])(void);
+static unsigned num_binders = 0;
+
+/* ------------------------------------------------------------------------ *
+ * CPUID probe
+ * ------------------------------------------------------------------------ */
+
+#if CPU_HAVE_X86
+static unsigned long long xgetbv0(void)
+{
+	unsigned eax, edx;
+	__asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+}
+#endif
+
+static unsigned probe(void)
+{
+	unsigned f = 0;
+#	if CPU_HAVE_X86
+	unsigned eax, ebx, ecx, edx, max;
+	unsigned long long xcr0 = 0;
+
+	if (!__get_cpuid(0, &max, &ebx, &ecx, &edx))
+		return 0;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+
+	if (edx & (1u << 26))
+		f |= CPU_SSE2;
+	if (ecx & (1u << 9))
+		f |= CPU_SSSE3;
+	if ((ecx & (1u << 25)) && (f & CPU_SSSE3))
+		f |= CPU_AESNI;
+
+	/* AVX state must be enabled by the OS (OSXSAVE, XCR0) */
+	if ((ecx & (1u << 27)) && (ecx & (1u << 28)))
+		xcr0 = xgetbv0();
+
+	if (7 <= max) {
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		if ((ebx & (1u << 5)) && (xcr0 & 0x06) == 0x06)
+			f |= CPU_AVX2;
+		if ((ebx & (1u << 16)) && (ebx & (1u << 31)) &&
+		    (xcr0 & 0xe6) == 0xe6 && (f & CPU_AVX2))
+			f |= CPU_AVX512;
+		if ((ebx & (1u << 29)) && (f & CPU_SSSE3))
+			f |= CPU_SHANI;
+	}
+#	endif
+	return f;
+}
+
+/* ------------------------------------------------------------------------ *
+ * Feature selection
+ * ------------------------------------------------------------------------ */
+
+static unsigned parse(const char *list)
+{
+	static const struct {
+		const char *name;
+		unsigned    bits;
+	} tab [] = {
+		{"scalar", 0},
+		{"sse2",   CPU_SSE2},
+		{"ssse3",  CPU_SSE2|CPU_SSSE3},
+		{"avx2",   CPU_SSE2|CPU_SSSE3|CPU_AVX2},
+		{"avx512", CPU_SSE2|CPU_SSSE3|CPU_AVX2|CPU_AVX512},
+		{"aesni",  CPU_AESNI},
+		{"shani",  CPU_SHANI},
+	};
+	unsigned f = 0;
+
+	while (*list) {
+		size_t n = strcspn(list, ", ");
+		unsigned i;
+		for (i = 0; i < sizeof(tab)/sizeof(tab[0]); i++)
+			if (n == strlen(tab[i].name) &&
+			    strncmp(list, tab[i].name, n) == 0)
+				f |= tab[i].bits;
+		list += n;
+		list += strspn(list, ", ");
+	}
+	return f;
+}
+
+static void init(void)
+{
+	const char *env;
+
+	if (ready)
+		return;
+
+	probed = selected = probe();
+	if ((env = getenv(CPU_ENV_NAME)) != NULL && *env)
+		selected &= parse(env);
+	ready = 1;
+}
+
+/* ------------------------------------------------------------------------ *
+ * Public
+ * ------------------------------------------------------------------------ */
+
+unsigned cpu_features(void)
+{
+	init();
+	return selected;
+}
+
+unsigned cpu_features_probed(void)
+{
+	init();
+	return probed;
+}
+
+unsigned cpu_features_select(const char *list)
+{
+	unsigned i;
+
+	init();
+	selected = list == NULL ? probed : probed & parse(list);
+	for (i = 0; i < num_binders; i++)
+		binders [i] ();
+	return selected;
+}
+
+void cpu_dispatch_register(void (*bind)(void))
+{
+	unsigned i;
+
+	for (i = 0; i < num_binders; i++)
+		if (binders [i] == bind)
+			break;
+	if (i == num_binders && num_binders < MAX_BINDERS)
+		binders [num_binders ++] = bind;
+	bind();
+}
+
+/* end */
@@ -0,0 +1,79 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Runtime CPU feature detection and kernel dispatch
+ */
+
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* feature bits as returned by cpu_features() */
+#define CPU_SSE2    0x0001u
+#define CPU_SSSE3   0x0002u
+#define CPU_AVX2    0x0004u
+#define CPU_AVX512  0x0008u   /* AVX512F + AVX512VL */
+#define CPU_AESNI   0x0010u
+#define CPU_SHANI   0x0020u
+
+/* environment variable restricting the features to use, a comma separated
+ * list of: scalar, sse2, ssse3, avx2, avx512, aesni, shani (where a vector
+ * level implies the lower ones) */
+#define CPU_ENV_NAME "NIM_CRYPTO_CPU"
+
+/* target attributes for kernels compiled without -m<arch> flags */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define CPU_HAVE_X86 1
+# define CPU_TARGET(s) __attribute__((target(s)))
+#else
+# define CPU_HAVE_X86 0
+# define CPU_TARGET(s)
+#endif
+
+/* Features probed with CPUID and restricted by CPU_ENV_NAME. The probe
+ * runs once, subsequent calls return the cached value. */
+unsigned cpu_features(void);
+
+/* Features probed with CPUID, only */
+unsigned cpu_features_probed(void);
+
+/* Restrict features according to a list as used with CPU_ENV_NAME (NULL
+ * resets to probed features) and re-bind all registered kernels. */
+unsigned cpu_features_select(const char *list);
+
+/* Register a function binding kernel pointers according to
+ * cpu_features(). The function is run immediately and again after
+ * cpu_features_select(). */
+void cpu_dispatch_register(void (*bind)(void));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CPU_DISPATCH_H */
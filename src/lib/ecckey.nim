@@ -26,6 +26,7 @@
 
 import
   base64, rnd64, sequtils, strutils,
+  ltc  / [sha100],
   uecc / [uecc]
 
 type
@@ -41,13 +42,35 @@ type
   EccSessKey* = tuple
     sesKey: UEccScalar
 
+  EccFingerprint* = array[8,uint8] ## short public key digest, not secret
+
+  EccPrepPubKey* = tuple         ## public key decompressed for repeated use
+    prepKey: UEccWorker
+    fpr:     EccFingerprint      # computed once, see getEccFingerprint()
+
+  PreparedRecipient* = ref object ## public key with a window table for
+    pubKey: EccPubKey             ## repeated use, the table makes each
+    table:  UEccTable             ## session key several times faster
+    fpr:    EccFingerprint
+
+  EphemeralKeyPool* = ref object ## one-time key pairs generated ahead of
+    pool: pointer                ## time by a background thread
+
+  EccSessKeyJob* = tuple         ## argument record for getEccSessKeyBatch()
+    sesKey: EccSessKey           ## result, session key
+    ownPrv: ptr EccPrvKey        ## own private key (skipped if nil)
+    dstPub: ptr EccPubKey        ## destination public key (skipped if nil)
+    ok:     bool                 ## result, true if sesKey was set
+
+const
+  eccKeyPoolSize* = 64           ## default number of key pairs kept ready
+
 # ----------------------------------------------------------------------------
 # Private helpers
 # ----------------------------------------------------------------------------
 
 proc getRndData(key: var UEccScalar) {.inline.} =
-  for n, w in rnd8items(32):
-    key[n] = w.uint8
+  key.rnd64Fill
 
 proc pp(a: EccAnyKey; pfx, delim: string): string =
   ## pretty print key (for debugging)
@@ -61,12 +84,25 @@ proc pp(a: EccAnyKey; pfx, delim: string): string =
    st & a.key[24..31].mapIt(it.int.toHex(2)).join(dl) &
    "])")
 
+proc fingerprint(fpr: var EccFingerprint; key: ptr UEccScalar) =
+  var
+    md: Sha100State
+    dgst: Sha100Data
+  md.getSha100
+  md.sha100Data(key, key[].sizeof)
+  md.sha100Done(addr dgst)
+  (addr fpr[0]).copyMem(addr dgst, fpr.sizeof)
+
+proc freeKeyPool(p: EphemeralKeyPool) =
+  if not p.pool.isNil:
+    ecc_pool_free(p.pool)
+    p.pool = nil
+
 # debugging helpers
 when isMainModule:
 
   proc getRndData(): UEccScalar {.inline.} =
-    for n, w in rnd8items(32):
-      result[n] = w.uint8
+    result.rnd64Fill
 
   proc `$`(a: EccAnyKey): string =
     result = newString(a.key.len)
@@ -90,11 +126,158 @@ proc getEccPubKey*(pub: var EccPubKey; prv: ptr EccPrvKey) =
   ## derive public key from private key
   pub.pubKey.uEccPubKey(addr prv.prvKey)
 
+proc getEccRndPubKey*(pub: var EccPubKey) =
+  ## create a random public key without private key, e.g. as filler for an
+  ## empty slot; it cannot be told apart from a getEccPubKey() result but
+  ## is several times cheaper than a key pair
+  getRndData(pub.pubKey)
+  while not pub.pubKey.uEccRndPoint:
+    getRndData(pub.pubKey)
+
+proc getEccFingerprint*(fpr: var EccFingerprint; pub: ptr EccPubKey) =
+  ## short digest of the public key, the first 8 bytes of its SHA256 hash;
+  ## it identifies a key (e.g. as an index) but does not prove anything
+  fpr.fingerprint(addr pub.pubKey)
+
+proc getEccFingerprint*(fpr: var EccFingerprint; pub: ptr EccPrepPubKey) =
+  ## same as getEccFingerprint() above for a prepared public key, it was
+  ## computed by getEccPrepPubKey()
+  fpr = pub.fpr
+
+proc getEccFingerprint*(fpr: var EccFingerprint; pub: PreparedRecipient) =
+  ## same as getEccFingerprint() above for a prepared recipient, it was
+  ## computed by newPreparedRecipient()
+  fpr = pub.fpr
+
+proc getEccFingerprint*(fpr: var EccFingerprint; prv: ptr EccPrvKey) =
+  ## fingerprint of the public key belonging to 'prv', this derives the
+  ## public key first
+  var pub: EccPubKey
+  pub.getEccPubKey(prv)
+  fpr.fingerprint(addr pub.pubKey)
+
+proc newEphemeralKeyPool*(size = eccKeyPoolSize): EphemeralKeyPool =
+  ## Start a background thread keeping up to 'size' (rounded up to a power
+  ## of two) fresh key pairs ready for takeEccKeyPair(). The private keys
+  ## are read from the OS random device /dev/urandom, not from the rnd64
+  ## generator used by getEccPrvKey(). Returns nil if the random device
+  ## cannot be opened (e.g. on Windows) or the thread could not be started,
+  ## getEccKeyPair() then falls back to generating key pairs on the spot.
+  var pool = ecc_pool_new(max(size, 1).cuint)
+  if not pool.isNil:
+    result.new(freeKeyPool)
+    result.pool = pool
+
+proc takeEccKeyPair*(pool: EphemeralKeyPool;
+                     prv: var EccPrvKey; pub: var EccPubKey): bool =
+  ## Take the next key pair from the pool, its pool copy is wiped so each
+  ## pair is handed out once. This never blocks, it returns false if the
+  ## pool is empty (or nil.) The pool may be used by several threads.
+  if not pool.isNil:
+    result = ecc_pool_take(pool.pool, addr prv.prvKey, addr pub.pubKey) == 1
+
+proc getEccKeyPair*(prv: var EccPrvKey; pub: var EccPubKey;
+                    pool: EphemeralKeyPool = nil) =
+  ## create a new key pair, taken from the pool if there is one ready
+  if not pool.takeEccKeyPair(prv, pub):
+    prv.getEccPrvKey
+    pub.getEccPubKey(addr prv)
+
+proc level*(pool: EphemeralKeyPool): int =
+  ## number of key pairs ready
+  if not pool.isNil:
+    result = ecc_pool_level(pool.pool).int
+
+proc close*(pool: EphemeralKeyPool) =
+  ## stop the background thread and wipe the key pairs left, the pool is
+  ## empty afterwards (this also happens when the pool is garbage collected)
+  if not pool.isNil:
+    pool.freeKeyPool
+
 proc getEccSessKey*(resKey: var EccSessKey;
                     ownPrv: ptr EccPrvKey; dstPub: ptr EccPubKey) =
   ## derive session keq from own private key and destination public key
   resKey.sesKey.uEccSessionKey(addr ownPrv.prvKey, addr dstPub.pubKey)
 
+proc getEccPrepPubKey*(prep: var EccPrepPubKey;
+                       pub: ptr EccPubKey): bool {.discardable.} =
+  ## decompress public key for repeated use with getEccSessKey(); run this
+  ## once per recipient rather than once per message. Returns false if the
+  ## public key is not valid.
+  result = prep.prepKey.uEccPrepKey(addr pub.pubKey)
+  if result:
+    prep.fpr.fingerprint(addr pub.pubKey)        # as given by the caller
+
+proc getEccSessKey*(resKey: var EccSessKey;
+                    ownPrv: ptr EccPrvKey; dstPub: ptr EccPrepPubKey) =
+  ## same as getEccSessKey() above with a prepared destination public key
+  resKey.sesKey.uEccSessionKey(addr ownPrv.prvKey, addr dstPub.prepKey)
+
+proc newPreparedRecipient*(pub: ptr EccPubKey): PreparedRecipient =
+  ## build the window table of a public key for repeated use with
+  ## getEccSessKey(); this costs about as much as six session keys and pays
+  ## off for a recipient that gets many messages. Returns nil if the public
+  ## key is not valid.
+  result.new
+  result.pubKey = pub[]
+  if not result.table.uEccPrepTable(addr pub.pubKey):
+    return nil
+  result.fpr.fingerprint(addr pub.pubKey)
+
+proc getEccSessKey*(resKey: var EccSessKey;
+                    ownPrv: ptr EccPrvKey; dstPub: PreparedRecipient) =
+  ## same as getEccSessKey() above with a prepared recipient
+  resKey.sesKey.uEccSessionKey(addr ownPrv.prvKey, addr dstPub.table)
+
+proc getEccSessKeyX25519*(resKey: var EccSessKey;
+                          ownPrv: ptr EccPrvKey;
+                          dstPub: ptr EccPubKey): bool {.discardable.} =
+  ## derive the X25519 session key (Montgomery u coordinate rather than the
+  ## Edwards x coordinate of getEccSessKey()) from own private key and
+  ## destination public key. This runs a Montgomery ladder on the compressed
+  ## public key and is cheaper than getEccSessKey(). Returns false if the
+  ## public key is not usable.
+  resKey.sesKey.uEccSessionKeyX25519(addr ownPrv.prvKey, addr dstPub.pubKey)
+
+proc getEccSessKeyX25519*(resKey: var EccSessKey;
+                          ownPrv: ptr EccPrvKey;
+                          dstPub: ptr EccPrepPubKey): bool {.discardable.} =
+  ## same as getEccSessKeyX25519() above with a prepared public key
+  resKey.sesKey.uEccSessionKeyX25519(addr ownPrv.prvKey, addr dstPub.prepKey)
+
+proc getEccSessKeyX25519*(resKey: var EccSessKey;
+                          ownPrv: ptr EccPrvKey;
+                          dstPub: PreparedRecipient): bool {.discardable.} =
+  ## same as getEccSessKeyX25519() above with a prepared recipient
+  resKey.sesKey.uEccSessionKeyX25519(addr ownPrv.prvKey, addr dstPub.table)
+
+proc getEccSessKeyBatch*(jobs: var openArray[EccSessKeyJob]): int
+                        {.discardable.} =
+  ## same as getEccSessKey() for every job record but cheaper as the final
+  ## field inversion is shared across the batch; returns the number of
+  ## session keys derived
+  #
+  # The job records are copied field by field into uEccSessionKeyBatch()
+  # argument records rather than cast, so the two layouts need not agree.
+  var
+    items: array[32,UEccSessKeyItem]
+    base = 0
+  while base < jobs.len:
+    let m = min(jobs.len - base, items.len)
+    for i in 0..<m:
+      let
+        ownPrv = jobs[base + i].ownPrv
+        dstPub = jobs[base + i].dstPub
+      items[i].d = if ownPrv.isNil: nil else: addr ownPrv.prvKey
+      items[i].Q = if dstPub.isNil: nil else: addr dstPub.pubKey
+    result += uEccSessionKeyBatch(addr items[0], m)
+    for i in 0..<m:
+      jobs[base + i].ok = items[i].ok
+      if items[i].ok:
+        jobs[base + i].sesKey.sesKey = items[i].X
+    (addr items).zeroMem(items.sizeof)
+    base += m
+
 proc getEccPubKey*(preamble: string):
                    (EccPubKey, EccPubKey, EccPubKey) = # {.deprecated.}=
   ## extract public key from destination stream header, may return nil on
@@ -125,6 +308,9 @@ proc pp*(ses: EccSessKey; delim: string = ""): string {.inline.} =
 
 when isMainModule:
 
+  import
+    os
+
   rnd64init(123)
 
   const
@@ -144,8 +330,7 @@ when isMainModule:
       q[n + 32] = pub2.pubKey[n].uint8
       q[n + 64] = pub3.pubKey[n].uint8
     const offs = 96
-    for n, w in rnd8items(KeyHdrLen - offs):
-      q[n + offs] = w.uint8
+    rnd64Fill(addr q[offs], KeyHdrLen - offs)
     result = q.encode
 
   proc getEccPreamble(pub: EccPubKey): string =
@@ -154,12 +339,11 @@ when isMainModule:
     ## instead
     var q: array[KeyHdrLen,uint8]
     assert 3 * 32 <= KeyHdrLen
-    for n, w in rnd8items(32):
+    for n in 0..31:
       q[n     ] = pub.pubKey[n].uint8
-      q[n + 32] = w.uint8
+    rnd64Fill(addr q[32], 32)
     const offs = 64
-    for n, w in rnd8items(KeyHdrLen - offs):
-      q[n + offs] = w.uint8
+    rnd64Fill(addr q[offs], KeyHdrLen - offs)
     result = q.encode
 
   proc qq(s: string): string =
@@ -202,6 +386,49 @@ when isMainModule:
       echo "      ", ss2.pp.qq
     doAssert ss0.pp.qq == ss1.pp.qq
 
+    var
+      kq1: EccPrepPubKey
+      sq0: EccSessKey
+    doAssert kq1.getEccPrepPubKey(addr ku1)
+    getEccSessKey(sq0, addr kp0, addr kq1)
+    doAssert sq0.pp.qq == ss0.pp.qq
+
+    var kr1 = newPreparedRecipient(addr ku1)
+    doAssert not kr1.isNil
+    getEccSessKey(sq0, addr kp0, kr1)
+    doAssert sq0.pp.qq == ss0.pp.qq
+
+    var sx0, sx1, sx2: EccSessKey
+    doAssert getEccSessKeyX25519(sx0, addr kp0, addr ku1)
+    doAssert getEccSessKeyX25519(sx1, addr kp1, addr ku0)
+    doAssert getEccSessKeyX25519(sx2, addr kp0, kr1)
+    doAssert sx0.pp.qq == sx1.pp.qq
+    doAssert sx0.pp.qq == sx2.pp.qq
+    doAssert getEccSessKeyX25519(sx2, addr kp0, addr kq1)
+    doAssert sx0.pp.qq == sx2.pp.qq
+
+    var                                          # neutral element, zero
+      ki: EccPubKey                              # X25519 key for all
+      kqi: EccPrepPubKey
+    ki.pubKey[0] = 1
+    doAssert not getEccSessKeyX25519(sx2, addr kp0, addr ki)
+    if kqi.getEccPrepPubKey(addr ki):
+      doAssert not getEccSessKeyX25519(sx2, addr kp0, addr kqi)
+    var kri = newPreparedRecipient(addr ki)
+    if not kri.isNil:
+      doAssert not getEccSessKeyX25519(sx2, addr kp0, kri)
+
+    var jobs: array[4,EccSessKeyJob]
+    jobs[0].ownPrv = addr kp0; jobs[0].dstPub = addr ku1
+    jobs[1].ownPrv = addr kp1; jobs[1].dstPub = addr ku0
+    jobs[2].ownPrv = nil;      jobs[2].dstPub = addr ku0
+    jobs[3].ownPrv = addr kp2; jobs[3].dstPub = addr ku1
+    doAssert jobs.getEccSessKeyBatch == 3
+    doAssert jobs[0].sesKey.pp.qq == ss0.pp.qq
+    doAssert jobs[1].sesKey.pp.qq == ss1.pp.qq
+    doAssert not jobs[2].ok
+    doAssert jobs[3].sesKey.pp.qq == ss2.pp.qq
+
     when not defined(check_run) and false:
       echo ">>> 0 ", getEccPreamble(ku0          ).bb
       echo ">>> 1 ", getEccPreamble(     ku1     ).bb
@@ -232,6 +459,53 @@ when isMainModule:
     doAssert xxx[1].pp.qq == ku1.pp.qq
     doAssert xxx[2].pp.qq == ku2.pp.qq
 
+  block:                                         # fingerprints agree for
+    var                                          # all key representations
+      prv: EccPrvKey
+      pub: EccPubKey
+      prep: EccPrepPubKey
+      f0, f1, f2, f3: EccFingerprint
+    prv.getEccPrvKey
+    pub.getEccPubKey(addr prv)
+    doAssert prep.getEccPrepPubKey(addr pub)
+    f0.getEccFingerprint(addr pub)
+    f1.getEccFingerprint(addr prep)
+    f2.getEccFingerprint(newPreparedRecipient(addr pub))
+    f3.getEccFingerprint(addr prv)
+    doAssert f0 == f1 and f0 == f2 and f0 == f3
+    prv.getEccPrvKey
+    f3.getEccFingerprint(addr prv)
+    doAssert f0 != f3
+    pub.pubKey[31] = pub.pubKey[31] xor 0x80     # both prepared forms hash
+    doAssert prep.getEccPrepPubKey(addr pub)     # the bytes as given
+    f0.getEccFingerprint(addr pub)
+    f1.getEccFingerprint(addr prep)
+    f2.getEccFingerprint(newPreparedRecipient(addr pub))
+    doAssert f0 == f1 and f0 == f2 and f0 != f3
+
+  block:                                         # key pairs from the pool
+    var
+      pool = newEphemeralKeyPool(8)
+      prv, chk: EccPrvKey
+      pub, puc: EccPubKey
+      seen: seq[string] = @[]
+      n = 0
+    doAssert not pool.isNil
+    while pool.level < 8 and n < 1000:             # wait until filled up
+      sleep(2)
+      n.inc
+    for _ in 0..<20:                               # more than the pool size
+      prv.getEccKeyPair(pub, pool)
+      puc.getEccPubKey(addr prv)
+      doAssert pub.pp == puc.pp
+      doAssert prv.pp notin seen
+      seen.add prv.pp
+    pool.close
+    doAssert pool.level == 0
+    doAssert not pool.takeEccKeyPair(chk, puc)
+    chk.getEccKeyPair(puc, nil)                    # inline generation
+    doAssert chk.pp != prv.pp
+
 #  when not defined(check_run):
 #    echo "*** not yet"
 
@@ -0,0 +1,296 @@
+# -*- nim -*-
+#
+# $Id$
+#
+# Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+# All rights reserved.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# The author or authors of this code dedicate any and all copyright interest
+# in this code to the public domain. We make this dedication for the benefit
+# of the public at large and to the detriment of our heirs and successors.
+# We intend this dedication to be an overt act of relinquishment in
+# perpetuity of all present and future rights to this code under copyright
+# law.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+#
+#
+## This module keeps a ring of private keys indexed by the fingerprints of
+## their public keys, e.g. one key per tenant of a collector. A session is
+## started for the ring as a whole rather than for a single key.
+##
+## For a sessHdrHinted header (see the 'sesskey' module) the slot
+## fingerprints are looked up in the index, so the right key and slot are
+## found directly and a single session key is derived, regardless of the
+## number of keys in the ring. For the other header formats there is no
+## hint and every key is tried in turn.
+##
+## Example:
+##
+## .. code-block::
+##
+##    import
+##      keyring
+##
+##    var
+##      ring = newKeyRing()
+##      chl  = getXVerfier()
+##      ctx: XCryptCtx
+##
+##    for n in 0..<tenants.len:            # tenant private keys
+##      ring.add(addr tenants[n])
+##
+##    # start a session for a message 'data' to any tenant
+##    var pre = ctx.getXRawDecrypt(ring, data, addr chl)
+##    doAssert 0 < pre
+##    var msg = ctx.xRawDecrypt(addr data[pre], data.len - pre)
+##    ring.clearKeyRing                    # wipe the keys now
+##
+
+import
+  hashes, tables, xcrypt,
+  sesskey
+
+export
+  xcrypt
+
+type
+  KeyRingItem = tuple
+    prv: EccPrvKey
+    fpr: EccFingerprint
+
+  KeyRing* = ref object                  ## private keys with index, the
+    items: seq[ptr KeyRingItem]          ## keys are wiped when the ring is
+    index: Table[EccFingerprint,int]     ## cleared or garbage collected
+
+# ----------------------------------------------------------------------------
+# Private helpers
+# ----------------------------------------------------------------------------
+
+proc hash(fpr: EccFingerprint): Hash =
+  for n in 0..<fpr.len:
+    result = result !& fpr[n].int
+  result = !$result
+
+proc newItem(prv: ptr EccPrvKey; fpr: EccFingerprint): ptr KeyRingItem =
+  ## Each key lives in a block of its own so that growing the items[] list
+  ## only moves pointers, no key copy is left behind in freed memory.
+  result = cast[ptr KeyRingItem](alloc0(KeyRingItem.sizeof))
+  result.prv = prv[]
+  result.fpr = fpr
+
+proc freeItem(item: ptr KeyRingItem) {.inline.} =
+  item.zeroMem(KeyRingItem.sizeof)
+  item.dealloc
+
+proc freeKeyRing(ring: KeyRing) =
+  if not ring.items.isNil:
+    for n in 0..<ring.items.len:
+      ring.items[n].freeItem
+    ring.items.setLen(0)
+
+# ----------------------------------------------------------------------------
+# Public functions
+# ----------------------------------------------------------------------------
+
+proc newKeyRing*(): KeyRing =
+  ## create an empty key ring; a ring is shared by reference, its keys are
+  ## wiped by clearKeyRing() or at the latest when it is garbage collected
+  result.new(freeKeyRing)
+  result.items = @[]
+  result.index = initTable[EccFingerprint,int]()
+
+proc len*(ring: KeyRing): int {.inline.} =
+  ## number of private keys in the ring
+  ring.items.len
+
+proc contains*(ring: KeyRing; fpr: EccFingerprint): bool {.inline.} =
+  ## true if there is a private key for the public key fingerprint 'fpr'
+  ring.index.hasKey(fpr)
+
+proc add*(ring: KeyRing; prv: ptr EccPrvKey): EccFingerprint
+         {.discardable.} =
+  ## Add a copy of the private key 'prv' to the ring, it returns the
+  ## fingerprint of the public key. A key already in the ring is kept once.
+  result.getEccFingerprint(prv)
+  if not ring.index.hasKey(result):
+    ring.index[result] = ring.items.len
+    ring.items.add(newItem(prv, result))
+
+proc del*(ring: KeyRing; fpr: EccFingerprint) =
+  ## remove the private key for the public key fingerprint 'fpr' from the
+  ## ring, the key copy is wiped
+  if ring.index.hasKey(fpr):
+    let
+      inx  = ring.index[fpr]
+      last = ring.items.len - 1
+    ring.index.del(fpr)
+    ring.items[inx].freeItem
+    if inx < last:                                   # move last into gap
+      ring.items[inx] = ring.items[last]
+      ring.index[ring.items[inx].fpr] = inx
+    ring.items.setLen(last)
+
+proc clearKeyRing*(ring: KeyRing) =
+  ## wipe and remove all keys
+  ring.freeKeyRing
+  ring.index = initTable[EccFingerprint,int]()
+
+
+proc lookup*(ring: KeyRing; rawHdr: string; fpr: var EccFingerprint): int =
+  ## Find the first slot of the binary sessHdrHinted header 'rawHdr' that
+  ## is addressed to a key in the ring. It returns the slot index and sets
+  ## 'fpr' to the fingerprint of that key, or returns -1 if there is none
+  ## (also for the other header formats.)
+  result = -1
+  let hints = rawHdr.getSessHdrHints
+  for n in 0..<hints.len:
+    if ring.index.hasKey(hints[n]):
+      fpr = hints[n]
+      return n
+
+
+proc getXRawDecrypt*(ctx: var XCryptCtx;
+                     ring: KeyRing;
+                     bin: string; challenge: ptr XPattern): int =
+  ## Start a decryption session with the key of the ring the raw session
+  ## header 'bin' is addressed to. It returns the header length as
+  ## getXRawDecrypt() for a single key does, or zero if there is no
+  ## matching key. A sessHdrHinted header is resolved by the index, the
+  ## other formats are tried with every key.
+  let hints = bin.getSessHdrHints
+  if 0 < hints.len:
+    for n in 0..<hints.len:                          # addressed slots only
+      if ring.index.hasKey(hints[n]):
+        let inx = ring.index[hints[n]]
+        result = ctx.getXRawDecrypt(bin, unsafeAddr ring.items[inx].prv,
+                                    challenge, unsafeAddr ring.items[inx].fpr)
+        if 0 < result:
+          return
+  else:
+    for n in 0..<ring.items.len:                     # no hints, try all
+      result = ctx.getXRawDecrypt(bin, unsafeAddr ring.items[n].prv,
+                                  challenge, unsafeAddr ring.items[n].fpr)
+      if 0 < result:
+        return
+
+proc getXB64Decrypt*(ctx: var XCryptCtx;
+                     ring: KeyRing;
+                     b64: string; challenge: ptr XPattern): int =
+  ## same as getXRawDecrypt() above for a base64 encoded cipher data stream,
+  ## it returns the length consumed as getXB64Decrypt() for a single key
+  var bin: string
+  result = b64.xB64HeaderDecode(bin)
+  if 0 < result and ctx.getXRawDecrypt(ring, bin, challenge) <= 0:
+    result = 0
+
+# ----------------------------------------------------------------------------
+# Tests
+# ----------------------------------------------------------------------------
+
+when isMainModule:
+
+  const
+    nKeys = 50
+
+  var
+    prv: array[nKeys,EccPrvKey]
+    pub: array[nKeys,EccPubKey]
+    other: array[2,EccPrvKey]
+    otherPub: array[2,EccPubKey]
+    ring = newKeyRing()
+    chl  = "Hello Ring!".getXVerfier
+    text = "some secret text for one of the tenants"
+    fpr0: EccFingerprint
+
+  for n in 0..<nKeys:
+    prv[n].getEccPrvKey
+    pub[n].getEccPubKey(addr prv[n])
+    var fpr: EccFingerprint
+    fpr.getEccFingerprint(addr pub[n])
+    doAssert ring.add(addr prv[n]) == fpr
+  for n in 0..1:
+    other[n].getEccPrvKey
+    otherPub[n].getEccPubKey(addr other[n])
+  fpr0.getEccFingerprint(addr pub[0])
+  ring.add(addr prv[7])                              # added once only
+  doAssert ring.len == nKeys
+
+  proc roundTrip(data: string; ok = true) =
+    var
+      ctx: XCryptCtx
+      pre = ctx.getXRawDecrypt(ring, data, addr chl)
+    doAssert (0 < pre) == ok
+    if ok:
+      doAssert ctx.xRawDecrypt(unsafeAddr data[pre], text.len) == text
+    ctx.clearXCrypt
+
+  # hinted header, resolved by the index
+  block:
+    var
+      x: XCryptCtx
+      keys = [addr otherPub[0], addr pub[37], addr otherPub[1]]
+      data = x.getXRawEncrypt(keys, addr chl, sessHdrHinted)
+      fpr: EccFingerprint
+    data &= x.xRawEncrypt(text)
+    doAssert ring.lookup(data, fpr) == 1
+    fpr.getEccFingerprint(addr pub[37])
+    doAssert fpr in ring
+    data.roundTrip
+
+    var b64 = x.getXB64Encrypt(keys, addr chl, sessHdrHinted)
+    b64 &= x.xB64Encrypt(text)
+    var pre = x.getXB64Decrypt(ring, b64, addr chl)
+    doAssert 0 < pre
+    doAssert x.xB64Decrypt(b64, pre) == text
+
+    ring.del(fpr)                                    # key removed
+    doAssert fpr notin ring and ring.len == nKeys - 1
+    doAssert ring.lookup(data, fpr) == -1
+    data.roundTrip(false)
+    ring.add(addr prv[37])
+    x.clearXCrypt
+
+  # other header formats, every key is tried
+  block:
+    var
+      x: XCryptCtx
+      keys = [addr otherPub[0], addr pub[12]]
+      slots = [nil, addr otherPub[1], addr pub[45]]
+      data = x.getXRawEncrypt(keys, addr chl) & x.xRawEncrypt(text)
+      fpr: EccFingerprint
+    doAssert ring.lookup(data, fpr) == -1
+    data.roundTrip
+    data = x.getXRawEncrypt(addr slots, addr chl, sessHdrX25519) &
+           x.xRawEncrypt(text)
+    data.roundTrip
+    data = x.getXRawEncrypt([addr otherPub[0]], addr chl, sessHdrHinted) &
+           x.xRawEncrypt(text)
+    data.roundTrip(false)                            # not for the ring
+    x.clearXCrypt
+
+  block:                                           # shared, not copied
+    var alias = ring
+    alias.clearKeyRing
+    doAssert ring.len == 0 and fpr0 notin ring
+    ring.add(addr prv[0])
+    doAssert alias.len == 1
+
+  ring.clearKeyRing
+  doAssert ring.len == 0
+
+  when not defined(check_run):
+    echo "*** keyring OK"
+
+# ----------------------------------------------------------------------------
+# End
+# ----------------------------------------------------------------------------
@@ -25,6 +25,7 @@
 #
 
 import
+  cpu  / [cpu],
   ltc  / [aes80desc, ltc_const],
   misc / [prjcfg]
 
@@ -36,7 +37,8 @@ export
 # ----------------------------------------------------------------------------
 
 const
-  stdCcFlgs = " -I " & "headers".nimSrcDirname
+  stdCcFlgs = " -I " & "headers".nimSrcDirname &
+              " -I " & "../cpu/private".nimSrcDirname
 
 when isMainModule:
   const ccFlags = stdCcFlgs
@@ -46,6 +48,7 @@ else:
 {.passC: ccFlags.}
 
 {.compile: "aesd/ltc_aes.c"           .nimSrcDirname.}
+{.compile: "aesd/ltc_aesni.c"         .nimSrcDirname.}
 {.compile: "crypt/ltc_crypt-argchk.c" .nimSrcDirname.}
 {.compile: "crypt/ltc_zeromem.c"      .nimSrcDirname.}
 
@@ -82,6 +85,9 @@ proc rijndael_setup(key: pointer; kLen: cint;
 #  ## Returns:
 #  ##   isCryptOk if the input key size is acceptable.
 
+proc ltc_aesni_dispatch_init() {.cdecl, importc.}
+  ## Bind the AES-NI kernels if supported by the CPU (see cpu module.)
+
 proc rijndael_ecb_decrypt(ct, pt: pointer;
                           sKey: ptr Aes80Key): cint {.cdecl, importc.}
   ## Decrypts a block of text with AES
@@ -162,16 +168,25 @@ proc aes80Decrypt*(x: var Aes80Key;
   ## Decrypt a data block
   isCryptOk == rijndael_ecb_decrypt(pIn, pOut, addr x)
 
+# ----------------------------------------------------------------------------
+# Initialisation
+# ----------------------------------------------------------------------------
+
+ltc_aesni_dispatch_init() # bind kernels before any threads are started
+
 # ----------------------------------------------------------------------------
 # Tests
 # ----------------------------------------------------------------------------
 
 when isMainModule:
 
-  # invoke self test in C code
+  # invoke self test in C code, table code and AES-NI (if available)
   proc rijndael_test(): cint {.cdecl, importc.}
-  # echo ">>> ", rijndael_test()
-  doAssert isCryptOk == rijndael_test()
+  for level in ["scalar", "aesni"]:
+    cpuSelect(level)
+    # echo ">>> ", level, " ", rijndael_test()
+    doAssert isCryptOk == rijndael_test()
+  cpuSelect()
 
   if true: # run external test (checks interface)
     var
@@ -31,6 +31,7 @@
 */
 
 #include "tomcrypt.h"
+#include "ltc_aesni.h"                      /* patched */
 
 #ifdef LTC_RIJNDAEL
 
@@ -295,6 +296,11 @@ int ECB_ENC(const unsigned char *pt, unsigned char *ct, symmetric_key *skey)
     LTC_ARGCHK(ct != NULL);
     LTC_ARGCHK(skey != NULL);
 
+    if (ltc_aesni_ecb_encrypt(pt, ct,                 /* patched */
+          skey->rijndael.eK, skey->rijndael.Nr)) {    /* patched */
+       return CRYPT_OK;                               /* patched */
+    }                                                 /* patched */
+
     Nr = skey->rijndael.Nr;
     rk = skey->rijndael.eK;
 
@@ -474,6 +480,11 @@ int ECB_DEC(const unsigned char *ct, unsigned char *pt, symmetric_key *skey)
     LTC_ARGCHK(ct != NULL);
     LTC_ARGCHK(skey != NULL);
 
+    if (ltc_aesni_ecb_decrypt(ct, pt,                 /* patched */
+          skey->rijndael.dK, skey->rijndael.Nr)) {    /* patched */
+       return CRYPT_OK;                               /* patched */
+    }                                                 /* patched */
+
     Nr = skey->rijndael.Nr;
     rk = skey->rijndael.dK;
 
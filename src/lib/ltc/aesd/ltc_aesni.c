@@ -0,0 +1,136 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * AES-NI kernels for the libtomcrypt Rijndael code.
+ *
+ * The key schedules from rijndael_setup() are kept as 32 bit big endian
+ * words, so every round key is byte swapped when loaded into a vector
+ * register. The inverse schedule dK[] already has InvMixColumns applied
+ * to the inner round keys as needed by AESDEC (equivalent inverse cipher.)
+ */
+
+#include "cpu_dispatch.h"
+
+#if CPU_HAVE_X86
+# include <immintrin.h> /* must precede tomcrypt.h (no malloc there) */
+#endif
+
+#include "tomcrypt.h"
+#include "ltc_aesni.h"
+
+typedef int (*kernel_fn)(const unsigned char *, unsigned char *, const ulong32 *, int);
+
+static int resolve_enc (const unsigned char *, unsigned char *, const ulong32 *, int);
+static int resolve_dec (const unsigned char *, unsigned char *, const ulong32 *, int);
+static kernel_fn encrypt = resolve_enc;
+static kernel_fn decrypt = resolve_dec;
+
+#if CPU_HAVE_X86
+
+#define BSWAP32 _mm_set_epi8(12,13,14,15, 8,9,10,11, 4,5,6,7, 0,1,2,3)
+#define RKEY(rk, r) \
+	_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)((rk) + 4*(r))), BSWAP32)
+
+static CPU_TARGET("aes,ssse3")
+int aesni_encrypt(const unsigned char *pt, unsigned char *ct, const ulong32 *rk, int Nr)
+{
+	__m128i s = _mm_loadu_si128((const __m128i *)pt);
+	int r;
+
+	s = _mm_xor_si128(s, RKEY(rk, 0));
+	for (r = 1; r < Nr; r++)
+		s = _mm_aesenc_si128(s, RKEY(rk, r));
+	s = _mm_aesenclast_si128(s, RKEY(rk, Nr));
+
+	_mm_storeu_si128((__m128i *)ct, s);
+	return 1;
+}
+
+static CPU_TARGET("aes,ssse3")
+int aesni_decrypt(const unsigned char *ct, unsigned char *pt, const ulong32 *rk, int Nr)
+{
+	__m128i s = _mm_loadu_si128((const __m128i *)ct);
+	int r;
+
+	s = _mm_xor_si128(s, RKEY(rk, 0));
+	for (r = 1; r < Nr; r++)
+		s = _mm_aesdec_si128(s, RKEY(rk, r));
+	s = _mm_aesdeclast_si128(s, RKEY(rk, Nr));
+
+	_mm_storeu_si128((__m128i *)pt, s);
+	return 1;
+}
+
+#endif /* CPU_HAVE_X86 */
+
+static int unsupported(const unsigned char *in, unsigned char *out, const ulong32 *rk, int Nr)
+{
+	(void)in; (void)out; (void)rk; (void)Nr;
+	return 0;
+}
+
+static void bind(void)
+{
+	encrypt = decrypt = unsupported;
+#	if CPU_HAVE_X86
+	if ((cpu_features() & CPU_AESNI) && sizeof(ulong32) == 4) {
+		encrypt = aesni_encrypt;
+		decrypt = aesni_decrypt;
+	}
+#	endif
+}
+
+static int resolve_enc(const unsigned char *pt, unsigned char *ct, const ulong32 *rk, int Nr)
+{
+	ltc_aesni_dispatch_init();
+	return encrypt(pt, ct, rk, Nr);
+}
+
+static int resolve_dec(const unsigned char *ct, unsigned char *pt, const ulong32 *rk, int Nr)
+{
+	ltc_aesni_dispatch_init();
+	return decrypt(ct, pt, rk, Nr);
+}
+
+/* ------------------------------------------------------------------------ *
+ * Public
+ * ------------------------------------------------------------------------ */
+
+void ltc_aesni_dispatch_init(void)
+{
+	cpu_dispatch_register(bind);
+}
+
+int ltc_aesni_ecb_encrypt(const unsigned char *pt, unsigned char *ct, const ulong32 *eK, int Nr)
+{
+	return encrypt(pt, ct, eK, Nr);
+}
+
+int ltc_aesni_ecb_decrypt(const unsigned char *ct, unsigned char *pt, const ulong32 *dK, int Nr)
+{
+	return decrypt(ct, pt, dK, Nr);
+}
+
+/* end */
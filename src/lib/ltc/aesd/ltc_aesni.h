@@ -0,0 +1,46 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * AES-NI kernels for the libtomcrypt Rijndael code, bound at run time. The
+ * functions return non-zero if the block was processed, and zero if the
+ * CPU does not support AES-NI (the caller falls back to the table code.)
+ */
+
+#ifndef LTC_AESNI_H
+#define LTC_AESNI_H
+
+/* encrypt a block with the eK[] key schedule from rijndael_setup() */
+int ltc_aesni_ecb_encrypt(const unsigned char *pt, unsigned char *ct,
+			  const ulong32 *eK, int Nr);
+
+/* decrypt a block with the dK[] key schedule from rijndael_setup() */
+int ltc_aesni_ecb_decrypt(const unsigned char *ct, unsigned char *pt,
+			  const ulong32 *dK, int Nr);
+
+/* bind the kernels according to cpu_features(), done implicitly on
+ * first use */
+void ltc_aesni_dispatch_init(void);
+
+#endif /* LTC_AESNI_H */
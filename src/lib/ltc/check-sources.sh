@@ -30,6 +30,7 @@ do
     ./nimcache/*|\
     */tomcrypt_nim.h|\
     */ltc_*specs.c|\
+    */ltc_*ni.[ch]|\
     */ltc_crypt-const.c) continue
     esac
     
@@ -25,6 +25,7 @@
 #
 
 import
+  cpu  / [cpu],
   ltc  / [ltc_const, sha100desc],
   misc / [prjcfg]
 
@@ -36,7 +37,8 @@ export
 # ----------------------------------------------------------------------------
 
 const
-  stdCcFlgs = " -I " & "headers".nimSrcDirname
+  stdCcFlgs = " -I " & "headers".nimSrcDirname &
+              " -I " & "../cpu/private".nimSrcDirname
 
 when isMainModule:
   const ccFlags = stdCcFlgs
@@ -46,6 +48,7 @@ else:
 {.passC: ccFlags.}
 
 {.compile: "sha256d/ltc_sha256.c"     .nimSrcDirname.}
+{.compile: "sha256d/ltc_sha256ni.c"   .nimSrcDirname.}
 {.compile: "crypt/ltc_crypt-argchk.c" .nimSrcDirname.}
 
 # ----------------------------------------------------------------------------
@@ -76,6 +79,9 @@ proc ltc_sha256_done(md: ptr Sha100State; p: pointer): cint {.cdecl, importc.}
   ##  * isCryptHashOverflow -- very large n (counter size overflow)
   ## or isCryptOk, otherwise
 
+proc ltc_sha256ni_dispatch_init() {.cdecl, importc.}
+  ## Bind the SHA-NI kernel if supported by the CPU (see cpu module.)
+
 # ----------------------------------------------------------------------------
 # Debugging helper
 # ----------------------------------------------------------------------------
@@ -114,6 +120,12 @@ proc sha100Done*(md: var Sha100State): Sha100Data {.inline.} =
   ## finalise hash
   md.sha100Done(result)
 
+# ----------------------------------------------------------------------------
+# Initialisation
+# ----------------------------------------------------------------------------
+
+ltc_sha256ni_dispatch_init() # bind kernel before any threads are started
+
 # ----------------------------------------------------------------------------
 # Tests
 # ----------------------------------------------------------------------------
@@ -127,10 +139,13 @@ when isMainModule:
     for n in 0..<a.len:
       result[n] = a[n].int.toU8
 
-  if true: # external self test
-    var rc = sha100Test()
-    #echo ">> ", rc
-    doAssert isCryptOk == rc
+  if true: # external self test, portable code and SHA-NI (if available)
+    for level in ["scalar", "shani"]:
+      cpuSelect(level)
+      var rc = sha100Test()
+      #echo ">> ", level, " ", rc
+      doAssert isCryptOk == rc
+    cpuSelect()
 
   if true: # test vectors
     const
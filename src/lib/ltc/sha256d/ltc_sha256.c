@@ -9,6 +9,7 @@
  * Tom St Denis, tomstdenis@gmail.com, http://libtom.org
  */
 #include "tomcrypt.h"
+#include "ltc_sha256ni.h"                   /* patched */
 
 /**
   @file sha256.c
@@ -77,6 +78,10 @@ static int  sha256_compress(hash_state * md, unsigned char *buf)
 #endif
     int i;
 
+    if (ltc_sha256ni_compress(md->sha256.state, buf)) { /* patched */
+       return CRYPT_OK;                                 /* patched */
+    }                                                   /* patched */
+
     /* copy state into S */
     for (i = 0; i < 8; i++) {
         S[i] = md->sha256.state[i];
@@ -0,0 +1,159 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * SHA-NI kernel for the libtomcrypt SHA256 code.
+ *
+ * The SHA256RNDS2 instruction works on the state arranged as ABEF/CDGH
+ * register pair, so the state words are shuffled on entry and exit. Each
+ * loop cycle runs four rounds and extends the message schedule by four
+ * words.
+ */
+
+#include "cpu_dispatch.h"
+
+#if CPU_HAVE_X86
+# include <immintrin.h> /* must precede tomcrypt.h (no malloc there) */
+#endif
+
+#include "tomcrypt.h"
+#include "ltc_sha256ni.h"
+
+typedef int (*kernel_fn)(ulong32 *, const unsigned char *);
+
+static int resolve (ulong32 *, const unsigned char *);
+static kernel_fn compress = resolve;
+
+#if CPU_HAVE_X86
+
+static const ulong32 K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static CPU_TARGET("sha,sse4.1,ssse3")
+int shani_compress(ulong32 *state, const unsigned char *buf)
+{
+	const __m128i bswap = _mm_set_epi8(12,13,14,15, 8,9,10,11, 4,5,6,7, 0,1,2,3);
+	__m128i abef, cdgh, abef0, cdgh0, tmp, msg, w[4];
+	int i;
+
+	/* state words A..H -> ABEF, CDGH */
+	tmp  = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(state + 0)), 0xb1);
+	cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(state + 4)), 0x1b);
+	abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+	abef0 = abef;
+	cdgh0 = cdgh;
+
+	for (i = 0; i < 4; i++)
+		w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + 16*i)), bswap);
+
+	for (i = 0; i < 16; i++) {
+		__m128i *wi = &w[i & 3];
+
+		if (4 <= i) {
+			/* W[t..t+3] from W[t-16..t-1], t = 4i */
+			__m128i w16 = *wi;
+			__m128i w12 = w[(i - 3) & 3];
+			__m128i w8  = w[(i - 2) & 3];
+			__m128i w4  = w[(i - 1) & 3];
+			tmp = _mm_add_epi32(_mm_sha256msg1_epu32(w16, w12),
+					    _mm_alignr_epi8(w4, w8, 4));
+			*wi = _mm_sha256msg2_epu32(tmp, w4);
+		}
+
+		msg  = _mm_add_epi32(*wi, _mm_loadu_si128((const __m128i *)(K + 4*i)));
+		cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+		msg  = _mm_shuffle_epi32(msg, 0x0e);
+		abef = _mm_sha256rnds2_epu32(abef, cdgh, msg);
+	}
+
+	abef = _mm_add_epi32(abef, abef0);
+	cdgh = _mm_add_epi32(cdgh, cdgh0);
+
+	/* ABEF, CDGH -> state words A..H */
+	tmp  = _mm_shuffle_epi32(abef, 0x1b);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+	abef = _mm_blend_epi16(tmp, cdgh, 0xf0);
+	cdgh = _mm_alignr_epi8(cdgh, tmp, 8);
+
+	_mm_storeu_si128((__m128i *)(state + 0), abef);
+	_mm_storeu_si128((__m128i *)(state + 4), cdgh);
+	return 1;
+}
+
+#endif /* CPU_HAVE_X86 */
+
+static int unsupported(ulong32 *state, const unsigned char *buf)
+{
+	(void)state; (void)buf;
+	return 0;
+}
+
+static void bind(void)
+{
+	compress = unsupported;
+#	if CPU_HAVE_X86
+	if ((cpu_features() & CPU_SHANI) && sizeof(ulong32) == 4)
+		compress = shani_compress;
+#	endif
+}
+
+static int resolve(ulong32 *state, const unsigned char *buf)
+{
+	ltc_sha256ni_dispatch_init();
+	return compress(state, buf);
+}
+
+/* ------------------------------------------------------------------------ *
+ * Public
+ * ------------------------------------------------------------------------ */
+
+void ltc_sha256ni_dispatch_init(void)
+{
+	cpu_dispatch_register(bind);
+}
+
+int ltc_sha256ni_compress(ulong32 *state, const unsigned char *buf)
+{
+	return compress(state, buf);
+}
+
+/* end */
@@ -0,0 +1,42 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * SHA-NI kernel for the libtomcrypt SHA256 code, bound at run time. The
+ * function returns non-zero if the block was processed, and zero if the
+ * CPU does not support the SHA extensions (the caller falls back to the
+ * portable code.)
+ */
+
+#ifndef LTC_SHA256NI_H
+#define LTC_SHA256NI_H
+
+/* compress a 64 byte block into the state[8] words */
+int ltc_sha256ni_compress(ulong32 *state, const unsigned char *buf);
+
+/* bind the kernel according to cpu_features(), done implicitly on first
+ * use */
+void ltc_sha256ni_dispatch_init(void);
+
+#endif /* LTC_SHA256NI_H */
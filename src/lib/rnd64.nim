@@ -78,6 +78,8 @@ when rndGenType == ChaChaRandom:
     ctx.initRndCcCtx(seed.uint64, ccInit)
   proc nextRandom64(): int64 {.inline.} =
     ctx.rcdCcNext
+  proc fillRandom(p: pointer; n: int) {.inline.} =
+    ctx.rndCcFill(p, n)
 
 when rndGenType == XoroRandom:
   ##
@@ -88,6 +90,8 @@ when rndGenType == XoroRandom:
     initRndXo(seed, ccInit)
   proc nextRandom64(): int64 {.inline.} =
     rndXoNext()
+  proc fillRandom(p: pointer; n: int) {.inline.} =
+    rndXoFill(p, n)
 
 when rndGenType == FortunaRandom:
   ##
@@ -99,6 +103,8 @@ when rndGenType == FortunaRandom:
     ctx.initRndFrta(seed, ccInit)
   proc nextRandom64(): int64 {.inline.} =
     ctx.rndFrtaNext
+  proc fillRandom(p: pointer; n: int) {.inline.} =
+    ctx.rndFrtaFill(p, n)
 
 # initialise random generator
 0.seedRandom64
@@ -122,6 +128,19 @@ proc rnd64Next*(): int64 {.inline.} =
   nextRandom64()
 
 
+proc rnd64Fill*(p: pointer; n: int) {.inline.} =
+  ## fill n bytes at p with random data, this writes the bulk output of the
+  ## generator directly into the destination and is much cheaper than
+  ## walking over rnd8items()
+  if 0 < n:
+    fillRandom(p, n)
+
+proc rnd64Fill*(buf: var openArray[uint8]) {.inline.} =
+  ## fill buf with random data
+  if 0 < buf.len:
+    fillRandom(addr buf[0], buf.len)
+
+
 #proc rndIntNext*(): int {.inline.} =
 #  ## get next random integer
 #  when int.high < int64.high:
@@ -188,6 +207,13 @@ when isMainModule:
     when not defined(check_run):
       echo ">> (", n, ", ", w.toHex, ")"
 
+  block:
+    var buf: array[37,uint8]
+    buf.rnd64Fill
+    doAssert buf[0..15] != buf[16..31]
+    when not defined(check_run):
+      echo ">> ", buf[0..7].mapIt(it.int.toHex(2)).join(" ")
+
 #  when not defined(check_run):
 #    echo "*** not yet"
 
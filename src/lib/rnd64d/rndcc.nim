@@ -72,6 +72,10 @@ proc rcdCcNext*(ctx: var RndCcCtx): int64 {.inline.} =
   ## Get next 64bit random value
   ctx.chachaKeyStream(addr result, 8)
 
+proc rndCcFill*(ctx: var RndCcCtx; p: pointer; n: int) {.inline.} =
+  ## Fill n bytes at p with the key stream
+  ctx.chachaKeyStream(p, n)
+
 # ----------------------------------------------------------------------------
 # Tests
 # ----------------------------------------------------------------------------
@@ -102,6 +106,17 @@ when isMainModule:
     when not defined(check_run):
       echo ""
 
+  block:                                         # bulk fill continues
+    var                                          # the 64 bit stream
+      ctx, ctz: RndCcCtx
+      buf: array[5,int64]
+    ctx.initRndCcCtx(0u64,ccInit)
+    ctz.initRndCcCtx(0u64,ccInit)
+    ctx.rndCcFill(addr buf[0], 3 * 8)
+    ctx.rndCcFill(addr buf[3], 2 * 8)
+    for n in 0..<buf.len:
+      doAssert buf[n] == ctz.rcdCcNext
+
   block:
     var ctx: RndCcCtx
     ctx.initRndCcCtx(0u64, hash(CompileTime & CompileDate & hostOS & hostCPU))
@@ -25,13 +25,33 @@
 #
 
 ## Random generator based Fortuna
+##
+## The generator output is buffered: each call of the Fortuna read function
+## costs a lock, two extra AES blocks and an AES key schedule for the rekey
+## after the request, so the data are pulled in blocks of frtaBufLen bytes.
+## Fortuna still rekeys after every block, and bytes handed out are wiped
+## from the buffer so that they cannot be recovered from the context later.
 
 import
   hashes, times, strutils, sequtils,
   ltc / [frta]
 
+const
+  frtaBufLen = 4096                 # bytes pulled from Fortuna per read
+
 type
-  RndFrta* = Frta
+  RndFrta* = tuple
+    frta: Frta
+    buf:  array[frtaBufLen,uint8]   # output block
+    pos:  int                       # next unused byte in buf
+
+# ----------------------------------------------------------------------------
+# Private helpers
+# ----------------------------------------------------------------------------
+
+proc refill(ctx: var RndFrta) =
+  discard ctx.frta.readFrta(addr ctx.buf[0], frtaBufLen)
+  ctx.pos = 0
 
 # ----------------------------------------------------------------------------
 # Public functions
@@ -39,18 +59,47 @@ type
 
 proc initRndFrta*(ctx: var RndFrta; seed1, seed2: int64) =
   ## Globally initialise Fortuna based random generator
+  (addr ctx.buf).zeroMem(ctx.buf.sizeof)          # drop buffered output
+  ctx.pos = frtaBufLen
   block fail:
-    if not ctx.getFrta:
+    if not ctx.frta.getFrta:
       break fail
-    if not ctx.frtaAddEntropy(unsafeAddr seed1, seed1.sizeof):
+    if not ctx.frta.frtaAddEntropy(unsafeAddr seed1, seed1.sizeof):
       break fail
-    if not ctx.frtaAddEntropy(unsafeAddr seed2, seed2.sizeof):
+    if not ctx.frta.frtaAddEntropy(unsafeAddr seed2, seed2.sizeof):
       break fail
     return
   quit "Fortuna initialisation error"
 
 proc rndFrtaNext*(ctx: var RndFrta): int64 {.inline.} =
-  discard ctx.readFrta(addr result, result.sizeof)
+  ## Get next 64bit random value
+  if frtaBufLen < ctx.pos + result.sizeof:
+    ctx.refill
+  (addr result).copyMem(addr ctx.buf[ctx.pos], result.sizeof)
+  (addr ctx.buf[ctx.pos]).zeroMem(result.sizeof)  # forget it
+  ctx.pos.inc(result.sizeof)
+
+proc rndFrtaFill*(ctx: var RndFrta; p: pointer; n: int) =
+  ## Fill n bytes at p, large requests are read directly from Fortuna
+  ## without passing the buffer, one block per read so that Fortuna still
+  ## rekeys after every frtaBufLen bytes
+  var
+    q = cast[ByteAddress](p)
+    m = n
+  while 0 < m:
+    if ctx.pos == frtaBufLen:
+      if frtaBufLen <= m:                         # whole blocks
+        discard ctx.frta.readFrta(cast[pointer](q), frtaBufLen)
+        q.inc(frtaBufLen)
+        m.dec(frtaBufLen)
+        continue
+      ctx.refill
+    let k = min(m, frtaBufLen - ctx.pos)
+    cast[pointer](q).copyMem(addr ctx.buf[ctx.pos], k)
+    (addr ctx.buf[ctx.pos]).zeroMem(k)            # forget it
+    ctx.pos.inc(k)
+    q.inc(k)
+    m.dec(k)
 
 # ----------------------------------------------------------------------------
 # Tests
@@ -72,6 +121,22 @@ when isMainModule:
     when not defined(check_run):
       echo ""
 
+  block:                                         # across block boundaries
+    var
+      ctx: RndFrta
+      w = 0i64
+    ctx.initRndFrta(0,ccInit)
+    for n in 0..(3 * frtaBufLen div 8):
+      var v = ctx.rndFrtaNext
+      doAssert v != w
+      w = v
+    doAssert ctx.pos == 8
+
+    var buf = newSeq[uint8](2 * frtaBufLen + 13)  # partial, direct, partial
+    ctx.rndFrtaFill(addr buf[0], buf.len)
+    doAssert ctx.pos == 8 + 13
+    doAssert buf[0..<64] != buf[frtaBufLen..<frtaBufLen+64]
+
   block:
     var ctx: RndFrta
     ctx.initRndFrta(0,hash(CompileTime & CompileDate & hostOS & hostCPU))
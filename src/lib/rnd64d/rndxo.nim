@@ -44,6 +44,20 @@ proc initRndXo*(seed1, seed2: int64) =
 proc rndXoNext*(): int64 {.inline.} =
   x128Next()
 
+proc rndXoFill*(p: pointer; n: int) =
+  ## Fill n bytes at p with generator words, the last one truncated
+  var
+    q = cast[ByteAddress](p)
+    m = n
+  while 8 <= m:
+    var w = x128Next()
+    cast[pointer](q).copyMem(addr w, 8)
+    q.inc(8)
+    m.dec(8)
+  if 0 < m:
+    var w = x128Next()
+    cast[pointer](q).copyMem(addr w, m)
+
 # ----------------------------------------------------------------------------
 # Tests
 # ----------------------------------------------------------------------------
@@ -63,6 +77,18 @@ when isMainModule:
     when not defined(check_run):
       echo ""
 
+  block:                                         # bulk fill continues
+    var buf: array[4,int64]                      # the 64 bit stream
+    0.initRndXo(ccInit)
+    rndXoFill(addr buf[0], 8 + 3)                # truncated word dropped
+    rndXoFill(addr buf[2], 2 * 8)
+    0.initRndXo(ccInit)
+    var w = rndXoNext()
+    doAssert buf[0] == w
+    discard rndXoNext()
+    doAssert buf[2] == rndXoNext()
+    doAssert buf[3] == rndXoNext()
+
   block:
     0.initRndXo(hash(CompileTime & CompileDate & hostOS & hostCPU))
     for n in 0..3:
@@ -5,6 +5,7 @@ Public domain.
 */
 
 #include "ecrypt-sync.h"
+#include "salsa20_simd.h" /* patched */
 
 #define ROTATE(v,c) (ROTL32(v,c))
 #define XOR(v,w) ((v) ^ (w))
@@ -63,6 +64,16 @@ void ECRYPT_encrypt_bytes(ECRYPT_ctx *x,const u8 *m,u8 *c,u32 bytes)
 
   if (!bytes) return;
 
+#if 1 /* patched */
+  if (bytes >= SALSA20_MULTI_MIN) {
+    u32 done = 64 * salsa20_multi_xor(x->input, m, c, bytes / 64);
+    m += done;
+    c += done;
+    bytes -= done;
+    if (!bytes) return;
+  }
+#endif /* patched */
+
   j0 = x->input[0];
   j1 = x->input[1];
   j2 = x->input[2];
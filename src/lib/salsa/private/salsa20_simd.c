@@ -0,0 +1,278 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Multi-block Salsa20 kernels, 4 blocks in parallel (SSE2) or 8 blocks
+ * in parallel (AVX2, AVX-512). As with the ChaCha20 kernels the state words
+ * are held vertically and the key stream is transposed back into block
+ * order before it is XORed against the input.
+ *
+ * The kernels are compiled with target attributes and bound at run time
+ * according to cpu_features(), see cpu/private/cpu_dispatch.h.
+ */
+
+#include "salsa20_simd.h"
+#include "cpu_dispatch.h"
+
+#if CPU_HAVE_X86
+# include <immintrin.h>
+#endif
+
+typedef void (*kernel_fn)(const uint32_t *, const uint8_t *, uint8_t *);
+
+static size_t    resolve (uint32_t *, const uint8_t *, uint8_t *, size_t);
+static size_t  (*multi_xor)(uint32_t *, const uint8_t *, uint8_t *, size_t) = resolve;
+static kernel_fn kernel4 = NULL;
+static kernel_fn kernel8 = NULL;
+
+/* The 64 bit block counter is kept in state words 8 and 9 and wraps
+ * around silently (as with the reference code.) */
+static inline void counter_add(uint32_t *s, size_t blocks)
+{
+	uint64_t ctr = ((uint64_t)s[9] << 32) | s[8];
+	ctr += blocks;
+	s[8] = ctr & UINT32_C(0xFFFFFFFF);
+	s[9] = ctr >> 32;
+}
+
+#if CPU_HAVE_X86
+
+/* ------------------------------------------------------------------------ *
+ * 4 blocks: SSE2
+ * ------------------------------------------------------------------------ */
+
+#define TRANSPOSE128(a, b, c, d) {				\
+	__m128i t0 = _mm_unpacklo_epi32(a, b);			\
+	__m128i t1 = _mm_unpacklo_epi32(c, d);			\
+	__m128i t2 = _mm_unpackhi_epi32(a, b);			\
+	__m128i t3 = _mm_unpackhi_epi32(c, d);			\
+	a = _mm_unpacklo_epi64(t0, t1);				\
+	b = _mm_unpackhi_epi64(t0, t1);				\
+	c = _mm_unpacklo_epi64(t2, t3);				\
+	d = _mm_unpackhi_epi64(t2, t3);				\
+}
+
+#define XOR128(out, in, v) \
+	_mm_storeu_si128((__m128i *)(out), \
+			 _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in)), v))
+
+#define ROTL128(v, n) \
+	_mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+
+#define QR4(a, b, c, d)							\
+	b = _mm_xor_si128(b, ROTL128(_mm_add_epi32(a, d),  7));		\
+	c = _mm_xor_si128(c, ROTL128(_mm_add_epi32(b, a),  9));		\
+	d = _mm_xor_si128(d, ROTL128(_mm_add_epi32(c, b), 13));		\
+	a = _mm_xor_si128(a, ROTL128(_mm_add_epi32(d, c), 18));
+
+static CPU_TARGET("sse2")
+void salsa20_blocks4_sse2(const uint32_t *s, const uint8_t *in, uint8_t *out)
+{
+	__m128i x[16], o[16];
+	uint32_t lo[4], hi[4];
+	uint64_t ctr = ((uint64_t)s[9] << 32) | s[8];
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		lo[i] = (ctr + i) & UINT32_C(0xFFFFFFFF);
+		hi[i] = (ctr + i) >> 32;
+	}
+	for (i = 0; i < 16; i++)
+		o[i] = _mm_set1_epi32(s[i]);
+	o[8] = _mm_loadu_si128((const __m128i *)lo);
+	o[9] = _mm_loadu_si128((const __m128i *)hi);
+
+	for (i = 0; i < 16; i++)
+		x[i] = o[i];
+
+	for (i = 0; i < 10; i++) {
+		QR4(x[ 0], x[ 4], x[ 8], x[12])		/* columns */
+		QR4(x[ 5], x[ 9], x[13], x[ 1])
+		QR4(x[10], x[14], x[ 2], x[ 6])
+		QR4(x[15], x[ 3], x[ 7], x[11])
+		QR4(x[ 0], x[ 1], x[ 2], x[ 3])		/* rows */
+		QR4(x[ 5], x[ 6], x[ 7], x[ 4])
+		QR4(x[10], x[11], x[ 8], x[ 9])
+		QR4(x[15], x[12], x[13], x[14])
+	}
+	for (i = 0; i < 16; i++)
+		x[i] = _mm_add_epi32(x[i], o[i]);
+
+	TRANSPOSE128(x[ 0], x[ 1], x[ 2], x[ 3])
+	TRANSPOSE128(x[ 4], x[ 5], x[ 6], x[ 7])
+	TRANSPOSE128(x[ 8], x[ 9], x[10], x[11])
+	TRANSPOSE128(x[12], x[13], x[14], x[15])
+
+	for (i = 0; i < 4; i++) {
+		XOR128(out + 64*i +  0, in + 64*i +  0, x[i +  0]);
+		XOR128(out + 64*i + 16, in + 64*i + 16, x[i +  4]);
+		XOR128(out + 64*i + 32, in + 64*i + 32, x[i +  8]);
+		XOR128(out + 64*i + 48, in + 64*i + 48, x[i + 12]);
+	}
+}
+
+#undef QR4
+
+/* ------------------------------------------------------------------------ *
+ * 8 blocks: AVX2, AVX-512
+ * ------------------------------------------------------------------------ */
+
+#define TRANSPOSE256(a, b, c, d) {				\
+	__m256i t0 = _mm256_unpacklo_epi32(a, b);		\
+	__m256i t1 = _mm256_unpacklo_epi32(c, d);		\
+	__m256i t2 = _mm256_unpackhi_epi32(a, b);		\
+	__m256i t3 = _mm256_unpackhi_epi32(c, d);		\
+	a = _mm256_unpacklo_epi64(t0, t1);			\
+	b = _mm256_unpackhi_epi64(t0, t1);			\
+	c = _mm256_unpacklo_epi64(t2, t3);			\
+	d = _mm256_unpackhi_epi64(t2, t3);			\
+}
+
+#define XOR256(out, in, v) \
+	_mm256_storeu_si256((__m256i *)(out), \
+			    _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(in)), v))
+
+#define ROTL256(v, n) \
+	_mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+
+/* AVX2: shift and or */
+#define KERNEL   salsa20_blocks8_avx2
+#define TARGET   "avx2"
+#define ROT7(v)  ROTL256(v,  7)
+#define ROT9(v)  ROTL256(v,  9)
+#define ROT13(v) ROTL256(v, 13)
+#define ROT18(v) ROTL256(v, 18)
+#include "salsa20_simd_x8.h"
+#undef KERNEL
+#undef TARGET
+#undef ROT7
+#undef ROT9
+#undef ROT13
+#undef ROT18
+
+/* AVX-512: native rotations on 256 bit registers (AVX512VL) */
+#define KERNEL   salsa20_blocks8_avx512
+#define TARGET   "avx2,avx512f,avx512vl"
+#define ROT7(v)  _mm256_rol_epi32(v,  7)
+#define ROT9(v)  _mm256_rol_epi32(v,  9)
+#define ROT13(v) _mm256_rol_epi32(v, 13)
+#define ROT18(v) _mm256_rol_epi32(v, 18)
+#include "salsa20_simd_x8.h"
+#undef KERNEL
+#undef TARGET
+#undef ROT7
+#undef ROT9
+#undef ROT13
+#undef ROT18
+
+#endif /* CPU_HAVE_X86 */
+
+/* ------------------------------------------------------------------------ *
+ * Dispatch
+ * ------------------------------------------------------------------------ */
+
+static size_t scalar_xor(uint32_t *s, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+	(void)s; (void)in; (void)out; (void)blocks;
+	return 0;
+}
+
+static size_t vector_xor(uint32_t *s, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+	size_t done = 0;
+
+	if (kernel8 != NULL)
+		while (8 <= blocks - done) {
+			kernel8(s, in, out);
+			counter_add(s, 8);
+			in += 8 * 64;
+			out += 8 * 64;
+			done += 8;
+		}
+
+	if (kernel4 != NULL)
+		while (4 <= blocks - done) {
+			kernel4(s, in, out);
+			counter_add(s, 4);
+			in += 4 * 64;
+			out += 4 * 64;
+			done += 4;
+		}
+
+	return done;
+}
+
+static void bind(void)
+{
+	unsigned f = cpu_features();
+
+	kernel4 = kernel8 = NULL;
+#	if CPU_HAVE_X86
+	if (f & CPU_AVX512)
+		kernel8 = salsa20_blocks8_avx512;
+	else if (f & CPU_AVX2)
+		kernel8 = salsa20_blocks8_avx2;
+	if (f & CPU_SSE2)
+		kernel4 = salsa20_blocks4_sse2;
+#	endif
+	multi_xor = (kernel4 == NULL && kernel8 == NULL) ? scalar_xor : vector_xor;
+	(void)f;
+}
+
+static size_t resolve(uint32_t *s, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+	salsa20_dispatch_init();
+	return multi_xor(s, in, out, blocks);
+}
+
+/* ------------------------------------------------------------------------ *
+ * Public
+ * ------------------------------------------------------------------------ */
+
+void salsa20_dispatch_init(void)
+{
+	cpu_dispatch_register(bind);
+}
+
+const char *salsa20_kernel_name(void)
+{
+	if (multi_xor == resolve)
+		salsa20_dispatch_init();
+#	if CPU_HAVE_X86
+	if (kernel8 == salsa20_blocks8_avx512)
+		return "avx512";
+	if (kernel8 == salsa20_blocks8_avx2)
+		return "avx2";
+	if (kernel4 == salsa20_blocks4_sse2)
+		return "sse2";
+#	endif
+	return "scalar";
+}
+
+size_t salsa20_multi_xor(uint32_t *input, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+	return multi_xor(input, in, out, blocks);
+}
+
+/* end */
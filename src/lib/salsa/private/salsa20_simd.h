@@ -0,0 +1,60 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Multi-block Salsa20 kernels bound at run time, see salsa20_simd.c
+ */
+
+#ifndef SALSA20_SIMD_H
+#define SALSA20_SIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* minimum message size for salsa20_multi_xor() to be worth calling */
+#define SALSA20_MULTI_MIN (4 * 64)
+
+/* Encrypt whole 64 byte blocks with the ECRYPT state words input[16],
+ * returns the number of blocks processed (may be less than blocks, the
+ * rest is left to the caller). The counter words input[8], input[9] are
+ * advanced accordingly. */
+size_t salsa20_multi_xor(uint32_t *input, const uint8_t *in, uint8_t *out, size_t blocks);
+
+/* Bind salsa20_multi_xor() to the best kernel supported by the CPU, done
+ * implicitly on first use */
+void salsa20_dispatch_init(void);
+
+/* name of the kernel bound to salsa20_multi_xor() */
+const char *salsa20_kernel_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALSA20_SIMD_H */
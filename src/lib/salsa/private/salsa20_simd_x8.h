@@ -0,0 +1,90 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Template for an 8 block Salsa20 kernel, included by salsa20_simd.c
+ * with the macros KERNEL, TARGET and ROT7, ROT9, ROT13, ROT18 defined.
+ */
+
+#define QR8(a, b, c, d)							\
+	b = _mm256_xor_si256(b, ROT7 (_mm256_add_epi32(a, d)));	\
+	c = _mm256_xor_si256(c, ROT9 (_mm256_add_epi32(b, a)));	\
+	d = _mm256_xor_si256(d, ROT13(_mm256_add_epi32(c, b)));	\
+	a = _mm256_xor_si256(a, ROT18(_mm256_add_epi32(d, c)));
+
+static CPU_TARGET(TARGET)
+void KERNEL(const uint32_t *s, const uint8_t *in, uint8_t *out)
+{
+	__m256i x[16], o[16];
+	uint32_t lo[8], hi[8];
+	uint64_t ctr = ((uint64_t)s[9] << 32) | s[8];
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		lo[i] = (ctr + i) & UINT32_C(0xFFFFFFFF);
+		hi[i] = (ctr + i) >> 32;
+	}
+	for (i = 0; i < 16; i++)
+		o[i] = _mm256_set1_epi32(s[i]);
+	o[8] = _mm256_loadu_si256((const __m256i *)lo);
+	o[9] = _mm256_loadu_si256((const __m256i *)hi);
+
+	for (i = 0; i < 16; i++)
+		x[i] = o[i];
+
+	for (i = 0; i < 10; i++) {
+		QR8(x[ 0], x[ 4], x[ 8], x[12])
+		QR8(x[ 5], x[ 9], x[13], x[ 1])
+		QR8(x[10], x[14], x[ 2], x[ 6])
+		QR8(x[15], x[ 3], x[ 7], x[11])
+		QR8(x[ 0], x[ 1], x[ 2], x[ 3])
+		QR8(x[ 5], x[ 6], x[ 7], x[ 4])
+		QR8(x[10], x[11], x[ 8], x[ 9])
+		QR8(x[15], x[12], x[13], x[14])
+	}
+	for (i = 0; i < 16; i++)
+		x[i] = _mm256_add_epi32(x[i], o[i]);
+
+	TRANSPOSE256(x[ 0], x[ 1], x[ 2], x[ 3])
+	TRANSPOSE256(x[ 4], x[ 5], x[ 6], x[ 7])
+	TRANSPOSE256(x[ 8], x[ 9], x[10], x[11])
+	TRANSPOSE256(x[12], x[13], x[14], x[15])
+
+	/* now x[4*g+b] holds words 4g..4g+3 of block b (low lane) and of
+	 * block b+4 (high lane) */
+	for (i = 0; i < 4; i++) {
+		__m256i lo0 = _mm256_permute2x128_si256(x[i], x[i +  4], 0x20);
+		__m256i lo1 = _mm256_permute2x128_si256(x[i + 8], x[i + 12], 0x20);
+		__m256i hi0 = _mm256_permute2x128_si256(x[i], x[i +  4], 0x31);
+		__m256i hi1 = _mm256_permute2x128_si256(x[i + 8], x[i + 12], 0x31);
+		XOR256(out + 64*i +   0, in + 64*i +   0, lo0);
+		XOR256(out + 64*i +  32, in + 64*i +  32, lo1);
+		XOR256(out + 64*i + 256, in + 64*i + 256, hi0);
+		XOR256(out + 64*i + 288, in + 64*i + 288, hi1);
+	}
+}
+
+#undef QR8
+
+/* end */
@@ -26,6 +26,7 @@
 
 import
   endians,
+  cpu   / [cpu],
   misc  / [prjcfg],
   salsa / [salsadesc]
 
@@ -34,9 +35,12 @@ export
 
 const
   slsHeader = "private/ecrypt-sync.h".nimSrcDirname
+  simHeader = "private/salsa20_simd.h".nimSrcDirname
 
 {.passC: "-I " & "private".nimSrcDirname.}
+{.passC: "-I " & "../cpu/private".nimSrcDirname.}
 {.compile: "private/salsa20.c".nimSrcDirname.}
+{.compile: "private/salsa20_simd.c".nimSrcDirname.}
 
 # ----------------------------------------------------------------------------
 # Interface salsa20
@@ -71,6 +75,14 @@ proc salsa20_ivsetup(x: ptr SalsaCtx; iv: pointer)
 proc salsa20_anycrypt_bytes(x: ptr SalsaCtx; u, w: pointer; n: uint32)
   {.cdecl, header: slsHeader, importc.}
 
+# Bind the multi-block kernel to the best one supported by the CPU
+proc salsa20_dispatch_init()
+  {.cdecl, header: simHeader, importc.}
+
+# Name of the multi-block kernel bound
+proc salsa20_kernel_name(): cstring
+  {.cdecl, header: simHeader, importc.}
+
 # ----------------------------------------------------------------------------
 # Private helper
 # ----------------------------------------------------------------------------
@@ -104,6 +116,17 @@ proc salsaKeyStream*(x: var SalsaCtx; p: pointer; size: int) {.inline.} =
   p.zeroMem(size)
   salsa20_anycrypt_bytes(addr x, p, p, size.uint32)
 
+proc salsaKernel*(): string {.inline.} =
+  ## Name of the multi-block kernel used by salsaAnyCrypt(), one of
+  ## "scalar", "sse2", "avx2", or "avx512" (see cpu module.)
+  $salsa20_kernel_name()
+
+# ----------------------------------------------------------------------------
+# Initialisation
+# ----------------------------------------------------------------------------
+
+salsa20_dispatch_init() # bind kernels before any threads are started
+
 # ----------------------------------------------------------------------------
 # Tests
 # ----------------------------------------------------------------------------
@@ -208,6 +231,27 @@ when isMainModule:
           #echo ">>> tst=", test[1]
         doAssert kst == test[1]
 
+  block: # multi-block kernels must agree with the scalar code
+    var
+      size = 17 * 64 + 21
+      sBuf = newSeq[int8](size)
+      vBuf = newSeq[int8](size)
+    for key in [@[0x8000000000000000u64, 0u64],
+                @[0x8788898A8B8C8D8Eu64, 0x8F90919293949596u64,
+                  0x9798999A9B9C9D9Eu64, 0x9FA0A1A2A3A4A5A6u64]]:
+      cpuSelect("scalar")
+      var sCtx = key.newSalsa(0x0102030405060708u64)
+      sCtx.salsaKeyStream(addr sBuf[0], size)
+
+      for level in ["sse2", "avx2", "avx512"]:
+        cpuSelect(level)
+        when not defined(check_run):
+          echo "*** kernel ", level, " -> ", salsaKernel()
+        var vCtx = key.newSalsa(0x0102030405060708u64)
+        vCtx.salsaKeyStream(addr vBuf[0], size)
+        doAssert sBuf == vBuf
+    cpuSelect()
+
 #  when not defined(check_run):
 #    echo "*** not yet"
 
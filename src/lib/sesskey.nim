@@ -116,9 +116,57 @@
 ## the same messgae 'k'. In the worst case one decodes three different
 ## mesages and one has to guess which one is the right one.
 ##
+## An empty slot (nil public key) is filled with a random point W of the
+## prime order group and a random K. It looks like any other slot but
+## needs neither an ephemeral key pair nor a session key.
+##
+## Header versions:
+##
+## * sessHdrLegacy -- the shared key S is the x coordinate of the point
+##   S(w,P) on the Ed25519 curve
+##
+## * sessHdrX25519 -- the shared key S is the u coordinate of the same point
+##   on the Montgomery form of the curve as used by X25519. It is computed by
+##   a Montgomery ladder straight from the compressed keys, which is about
+##   twice as fast as the legacy version. The last two bytes of the nonce N2
+##   carry the version tag 0x25 0x19, legacy headers generated here never
+##   end with this tag (use getSessHdrVersion() for detecting the version.)
+##
+## * sessHdrMulti -- a header for any number n of recipients. All slots
+##   share the nonce N and a single ephemeral key pair (w,W), the shared
+##   keys S(w,Pi) are computed as with sessHdrX25519. So building a header
+##   costs one key pair and n session keys, and a receiver needs a single
+##   session key S(p,W) in order to decode all n slots. The layout is::
+##
+##     |     0   +------+
+##     |         | tag  |        "XSM" followed by format byte 1
+##     |     4   +------+
+##     |         | n    |        number of recipients (16 bit little endian)
+##     |     6   +------+
+##     |         | 0    |        reserved, zero
+##     |     8   +------+---+
+##     |         |  N       |    nonce, 36 bytes
+##     |    44   +----------+
+##     |         |  W       |    ephemeral public key
+##     |    76   +----------+
+##     |         |  K1      |    n encrypted messages all with the same
+##     |   108   +----------+    content 'k', Ki = k(+)H(S(w,Pi),N)
+##     |         |  ...     |
+##     |         +----------+
+##     |         |  Kn      |
+##     | 76+32n  +----------+
+##
+## * sessHdrHinted -- same as sessHdrMulti with format byte 2, each slot is
+##   preceded by the 8 byte fingerprint Fi of the public key Pi (see
+##   ecckey.getEccFingerprint()), so a slot takes 40 bytes and the header
+##   76+40n bytes. A receiver decodes only the slot with its own fingerprint
+##   and needs no session key at all if there is none. Note that anyone who
+##   knows the public key Pi can tell that the header is addressed to Pi.
+##
 #
 import
-  base64, ecckey, rnd64, strutils,
+  ecckey, rnd64, strutils,
+  b64  / [b64],
   ltc  / [sha100],
   uecc / [uecc]
 
@@ -134,12 +182,21 @@ const
   NonceLen*   = HdrTotalLen - 6 * SessKeyLen
   NonceLenH   = NonceLen div 2
 
+  MultiPreLen = 8 + NonceLen + SessKeyLen # tag, count, nonce, W
+  sessMultiMax* = 4096           ## maximal recipients of a sessHdrMulti header
+
 assert InLinelen * 4 == 76 * 3  # verify full base64 line width
 assert 20 < NonceLen
 assert 2 * NonceLenH == NonceLen
 assert SessKeyLen == EccSessKey.sizeof
 
 type
+  SessHdrVersion* = enum                 ## session header format
+    sessHdrLegacy = 0                    ## Ed25519 x coordinate
+    sessHdrX25519                        ## Montgomery u coordinate (X25519)
+    sessHdrMulti                         ## any number of recipients (X25519)
+    sessHdrHinted                        ## sessHdrMulti with key fingerprints
+
   SessKey*   = array[SessKeyLen, uint8]
   SessNonce* = array[NonceLen,   uint8]
   SessData = tuple
@@ -151,25 +208,36 @@ type
     eSessKey: EccSessKey                 # ephemeral session key, S
     eHash:    SessKey                    # ephemeral hash value,  H
 
-    nKey: EccPubKey                      # throw away key for empty slots
 
+const
+  sessTagX25519 = [0x25u8, 0x19u8]       # last nonce bytes of version X25519
+  sessTagMulti  = [0x58u8, 0x53u8, 0x4du8]  # "XSM", followed by format:
+  sessFmtMulti  = 1u8                       # .. sessHdrMulti
+  sessFmtHinted = 2u8                       # .. sessHdrHinted
 
 assert SessKey.sizeof == EccSessKey.sizeof
 assert SessKey.sizeof == EccPubKey.sizeof
 assert SessKey.sizeof == EccPrvKey.sizeof
 assert SessKey.sizeof == Sha100Data.sizeof
 
+var
+  keyPool: EphemeralKeyPool              # ephemeral key pairs, see below
+
 # ----------------------------------------------------------------------------
 # Private helpers
 # ----------------------------------------------------------------------------
 
-proc makeSessKey(p: var SessKey) =
-  for n, w in rnd8items(p.len):
-    p[n] = w.uint8
+proc makeSessKey(p: var SessKey) {.inline.} =
+  p.rnd64Fill
 
-proc makeNonce(p: var SessNonce) =
-  for n, w in rnd8items(p.len):
-    p[n] = w.uint8
+proc makeNonce(p: var SessNonce; version: SessHdrVersion) =
+  p.rnd64Fill
+  if version == sessHdrX25519:                     # set version tag
+    p[NonceLen - 2] = sessTagX25519[0]
+    p[NonceLen - 1] = sessTagX25519[1]
+  elif p[NonceLen - 2] == sessTagX25519[0] and     # legacy nonce must not
+       p[NonceLen - 1] == sessTagX25519[1]:        # look like tagged
+    p[NonceLen - 1] = p[NonceLen - 1] xor 0x80u8
 
 proc mangle(p: var SessKey; key: ptr EccSessKey; nonce: ptr SessNonce) =
   var md: Sha100State
@@ -183,32 +251,61 @@ proc xorKeys(p: var SessKey; a, b: ptr SessKey) =
   for n in 0..<a[].len:
     p[n] = a[n] xor b[n]
 
+proc slotLen(version: SessHdrVersion): int {.inline.} =
+  if version == sessHdrHinted: EccFingerprint.sizeof + SessKeyLen
+  else: SessKeyLen
+
+proc multiLen(n: int; version = sessHdrMulti): int {.inline.} =
+  MultiPreLen + n * version.slotLen
+
+proc multiCount(hdr: string; version: var SessHdrVersion): int =
+  ## number of recipients of a sessHdrMulti or sessHdrHinted header, or 0
+  if 8 <= hdr.len:
+    for n in 0..<sessTagMulti.len:
+      if hdr[n].ord.uint8 != sessTagMulti[n]:
+        return
+    case hdr[3].ord.uint8
+    of sessFmtMulti:  version = sessHdrMulti
+    of sessFmtHinted: version = sessHdrHinted
+    else: return
+    if hdr[6] == '\0' and hdr[7] == '\0':
+      result = hdr[4].ord or (hdr[5].ord shl 8)
+      if sessMultiMax < result:
+        result = 0
+
+proc multiCount(hdr: string): int {.inline.} =
+  var version: SessHdrVersion
+  hdr.multiCount(version)
+
 # ----------------------------------------------------------------------------
 # Private functions
 # ----------------------------------------------------------------------------
 
-proc doGetSessHeader(msg: var SessKey;
+proc doGetSessHeader[T: ptr EccPubKey|ptr EccPrepPubKey|PreparedRecipient](
+                     msg: var SessKey;
                      sdt: var SessData;
-                     pub: ptr array[3,ptr EccPubKey]): string =
+                     pub: ptr array[3,T];
+                     version: SessHdrVersion): string =
+  doAssert version in {sessHdrLegacy, sessHdrX25519} # see openArray version
   msg.makeSessKey()                                # create session key
-  sdt.sNonce.makeNonce()
+  sdt.sNonce.makeNonce(version)
 
   result = newString(HdrTotalLen)
 
   for n in 0..2:                                   # create header data
-    var pubPtr = pub[n]
-
     if pub[n].isNil:                               # missing pubkey?
-      sdt.ePrvKey.getEccPrvKey()                   # generate one and throw
-      sdt.nKey.getEccPubKey(addr sdt.ePrvKey)      # .. it away when done
-      pubPtr = addr sdt.nKey
-
-    sdt.ePrvKey.getEccPrvKey()                           # ephemeral key pair
-    sdt.sPubKey.getEccPubKey(addr sdt.ePrvKey)           # => (w,W)
-
-    sdt.eSessKey.getEccSessKey(addr sdt.ePrvKey, pubPtr) # => S(w,P)
-    sdt.eHash.mangle(addr sdt.eSessKey, addr sdt.sNonce) # => H(S,N)
-    sdt.sMsg.xorKeys(addr msg, addr sdt.eHash)           # => K(+)H
+      sdt.sPubKey.getEccRndPubKey()                # random point W and
+      sdt.sMsg.makeSessKey()                       # random K as filler
+    else:
+      sdt.ePrvKey.getEccKeyPair(sdt.sPubKey, keyPool)    # => (w,W)
+
+      if version == sessHdrX25519:                       # => S(w,P)
+        let ok = sdt.eSessKey.getEccSessKeyX25519(addr sdt.ePrvKey, pub[n])
+        doAssert ok                                      # not degenerate
+      else:
+        sdt.eSessKey.getEccSessKey(addr sdt.ePrvKey, pub[n])
+      sdt.eHash.mangle(addr sdt.eSessKey, addr sdt.sNonce) # => H(S,N)
+      sdt.sMsg.xorKeys(addr msg, addr sdt.eHash)           # => K(+)H
 
     (addr result[            n * 32]).copyMem(addr sdt.sPubKey[0], SessKeyLen)
     (addr result[HdrBlkLen + n * 32]).copyMem(addr sdt.sMsg[0],    SessKeyLen)
@@ -218,10 +315,53 @@ proc doGetSessHeader(msg: var SessKey;
   (addr result[96 + HdrBlkLen]).copyMem(addr sdt.sNonce[NonceLenH], NonceLenH)
 
 
+proc doGetSessHeader[T: ptr EccPubKey|ptr EccPrepPubKey|PreparedRecipient](
+                     msg: var SessKey;
+                     sdt: var SessData;
+                     pub: openArray[T];
+                     version: SessHdrVersion): string =
+  doAssert 0 < pub.len and pub.len <= sessMultiMax
+  doAssert version in {sessHdrMulti, sessHdrHinted}
+  let
+    hinted = version == sessHdrHinted
+    sLen   = version.slotLen
+  msg.makeSessKey()                                # create session key
+  sdt.sNonce.rnd64Fill
+
+  result = newString(multiLen(pub.len, version))
+  for n in 0..<sessTagMulti.len:
+    result[n] = sessTagMulti[n].chr
+  result[3] = (if hinted: sessFmtHinted else: sessFmtMulti).chr
+  result[4] = (pub.len and 255).chr
+  result[5] = (pub.len shr 8).chr
+  result[6] = '\0'
+  result[7] = '\0'
+
+  sdt.ePrvKey.getEccKeyPair(sdt.sPubKey, keyPool)  # one ephemeral => (w,W)
+
+  (addr result[8]).copyMem(addr sdt.sNonce[0], NonceLen)
+  (addr result[8 + NonceLen]).copyMem(addr sdt.sPubKey[0], SessKeyLen)
+
+  for n in 0..<pub.len:                            # create header data
+    doAssert not pub[n].isNil
+    let ok = sdt.eSessKey.getEccSessKeyX25519(addr sdt.ePrvKey, pub[n])
+    doAssert ok                                                # => S(w,Pi)
+    sdt.eHash.mangle(addr sdt.eSessKey, addr sdt.sNonce)       # => H(S,N)
+    sdt.sMsg.xorKeys(addr msg, addr sdt.eHash)                 # => K(+)H
+    var pos = MultiPreLen + n * sLen
+    if hinted:                                                 # => F(Pi)
+      var fpr: EccFingerprint
+      fpr.getEccFingerprint(pub[n])
+      (addr result[pos]).copyMem(addr fpr[0], fpr.sizeof)
+      pos.inc(fpr.sizeof)
+    (addr result[pos]).copyMem(addr sdt.sMsg[0], SessKeyLen)
+
+
 
 proc doExtrSessMsg(msg: var array[3,SessKey];
                    sdt: var SessData;
-                   hdr: string; prv: ptr array[3,ptr EccPrvKey]) =
+                   hdr: string; prv: ptr array[3,ptr EccPrvKey];
+                   version: SessHdrVersion) =
 
   if HdrTotalLen <= hdr.len:
     (addr sdt.sNonce[0        ])
@@ -229,88 +369,269 @@ proc doExtrSessMsg(msg: var array[3,SessKey];
     (addr sdt.sNonce[NonceLenH])
        .copyMem(unsafeAddr hdr[96 + HdrBlkLen], NonceLenH)
 
+    var
+      pub:  array[3,EccPubKey]
+      jobs: array[3,EccSessKeyJob]                # all S(p,W) with one
+    for n in 0..2:                                # shared field inversion
+      if not prv[n].isNil:
+        (addr pub[n].pubKey[0])
+           .copyMem(unsafeAddr hdr[n * 32], SessKeyLen)
+        jobs[n].ownPrv = prv[n]
+        jobs[n].dstPub = addr pub[n]
+    if version == sessHdrX25519:                            # => S(p,W)
+      for n in 0..2:
+        if not prv[n].isNil:
+          jobs[n].sesKey.getEccSessKeyX25519(prv[n], addr pub[n])
+    else:
+      jobs.getEccSessKeyBatch                               # => S(p,W)
+
     for n in 0..2:
       if prv[n].isNil:
         continue
 
-      (addr sdt.sPubKey[0])
-         .copyMem(unsafeAddr hdr[            n * 32], SessKeyLen)
       (addr sdt.sMsg[0])
          .copyMem(unsafeAddr hdr[HdrBlkLen + n * 32], SessKeyLen)
 
-      sdt.eSessKey.getEccSessKey(prv[n], addr sdt.sPubKey) # => S(p,W)
-      sdt.eHash.mangle(addr sdt.eSessKey, addr sdt.sNonce) # => H(S,N)
-      msg[n].xorKeys(addr sdt.sMsg, addr sdt.eHash)        # => K(+)H
+      sdt.eHash.mangle(addr jobs[n].sesKey, addr sdt.sNonce) # => H(S,N)
+      msg[n].xorKeys(addr sdt.sMsg, addr sdt.eHash)          # => K(+)H
       # end for
 
+    (addr jobs).zeroMem(jobs.sizeof)              # clear key data
+
+
+proc doExtrSessMsg(msg: var seq[SessKey];
+                   sdt: var SessData;
+                   hdr: string; prv: ptr EccPrvKey;
+                   fpr: ptr EccFingerprint) =
+  var
+    version: SessHdrVersion
+    slots: seq[int] = @[]                         # header offsets of K
+  let
+    n    = hdr.multiCount(version)
+    sLen = version.slotLen
+  msg.setLen(0)
+  if n == 0 or hdr.len < multiLen(n, version):
+    return
+
+  if version == sessHdrHinted:                    # slots with matching
+    var own: EccFingerprint                       # fingerprint only
+    if fpr.isNil:
+      own.getEccFingerprint(prv)
+    else:
+      own = fpr[]
+    for i in 0..<n:
+      let pos = MultiPreLen + i * sLen
+      if equalMem(unsafeAddr hdr[pos], addr own[0], own.sizeof):
+        slots.add(pos + own.sizeof)
+    if slots.len == 0:
+      return                                      # not a recipient
+  else:
+    for i in 0..<n:
+      slots.add(MultiPreLen + i * sLen)
+
+  (addr sdt.sNonce[0]).copyMem(unsafeAddr hdr[8], NonceLen)
+  (addr sdt.sPubKey[0]).copyMem(unsafeAddr hdr[8 + NonceLen], SessKeyLen)
+
+  sdt.eSessKey.getEccSessKeyX25519(prv, addr sdt.sPubKey)     # => S(p,W)
+  sdt.eHash.mangle(addr sdt.eSessKey, addr sdt.sNonce)        # => H(S,N)
+
+  msg.setLen(slots.len)
+  for i in 0..<slots.len:
+    (addr sdt.sMsg[0]).copyMem(unsafeAddr hdr[slots[i]], SessKeyLen)
+    msg[i].xorKeys(addr sdt.sMsg, addr sdt.eHash)             # => K(+)H
+
 # ----------------------------------------------------------------------------
 # Public functions
 # ----------------------------------------------------------------------------
 
+proc sessKeyPoolStart*(size = eccKeyPoolSize): bool {.discardable.} =
+  ## Take the ephemeral key pairs for new session headers from a pool
+  ## filled by a background thread (see ecckey.newEphemeralKeyPool().) The
+  ## pairs are generated inline when the pool runs empty. Returns false if
+  ## the OS random device cannot be opened or the thread could not be
+  ## started.
+  if keyPool.isNil:
+    keyPool = newEphemeralKeyPool(size)
+  result = not keyPool.isNil
+
+proc sessKeyPoolStop*() =
+  ## stop the background thread and generate key pairs inline again
+  keyPool.close
+  keyPool = nil
+
+proc sessMultiHdrLen*(n: int; version = sessHdrMulti): int {.inline.} =
+  ## length of a sessHdrMulti (or sessHdrHinted) header for n recipients
+  multiLen(n, version)
+
+
 proc getB64SessHeader*(msg:   var SessKey;
                        nonce: var SessNonce;
-                       pub:   ptr array[3,ptr EccPubKey]): string =
+                       pub:   ptr array[3,ptr EccPubKey];
+                       version = sessHdrLegacy): string =
   ## Creates a session header by encrypting a random meessage 'msg' with
   ## three ECC public keys given as argument (leave key slot nil). Returns
   ## the encrypted message as string and the generated message as SessKey
-  ## (first var parameter).
+  ## (first var parameter). The 'version' argument selects the header
+  ## format (see the module description.)
   var sdt: SessData
-  result = msg.doGetSessHeader(sdt, pub).encode.strip
+  result = msg.doGetSessHeader(sdt, pub, version).b64Encode
   nonce = sdt.sNonce
   (addr sdt).zeroMem(sdt.sizeof)                     # clear key data
 
 proc getB64SessHeader*(msg: var SessKey;
-                       pub: ptr array[3,ptr EccPubKey]): string =
+                       pub: ptr array[3,ptr EccPubKey];
+                       version = sessHdrLegacy): string =
   var sdt: SessData
-  result = msg.doGetSessHeader(sdt, pub).encode.strip
+  result = msg.doGetSessHeader(sdt, pub, version).b64Encode
   (addr sdt).zeroMem(sdt.sizeof)                     # clear key data
 
 
 proc getRawSessHeader*(msg:   var SessKey;
                        nonce: var SessNonce;
-                       pub:   ptr array[3,ptr EccPubKey]): string =
+                       pub:   ptr array[3,ptr EccPubKey];
+                       version = sessHdrLegacy): string =
   ## same as getB64SessHeader() but with binary 228 byte header returned
   ## rather than the base64 encoded version
   var sdt: SessData
-  result = msg.doGetSessHeader(sdt, pub)
+  result = msg.doGetSessHeader(sdt, pub, version)
+  nonce = sdt.sNonce
+  (addr sdt).zeroMem(sdt.sizeof)                     # clear key data
+
+proc getRawSessHeader*(msg:   var SessKey;
+                       nonce: var SessNonce;
+                       pub:   ptr array[3,ptr EccPrepPubKey];
+                       version = sessHdrLegacy): string =
+  ## same as getRawSessHeader() above for public keys prepared with
+  ## getEccPrepPubKey(), this saves decompressing the public keys
+  var sdt: SessData
+  result = msg.doGetSessHeader(sdt, pub, version)
   nonce = sdt.sNonce
   (addr sdt).zeroMem(sdt.sizeof)                     # clear key data
 
+proc getRawSessHeader*(msg:   var SessKey;
+                       nonce: var SessNonce;
+                       pub:   ptr array[3,PreparedRecipient];
+                       version = sessHdrLegacy): string =
+  ## same as getRawSessHeader() above for recipients prepared with
+  ## newPreparedRecipient(), the window tables speed up the session key
+  ## derivation for every header (leave unused slots nil)
+  var sdt: SessData
+  result = msg.doGetSessHeader(sdt, pub, version)
+  nonce = sdt.sNonce
+  (addr sdt).zeroMem(sdt.sizeof)                     # clear key data
 
 
+proc getRawSessHeader*[T: ptr EccPubKey|ptr EccPrepPubKey|PreparedRecipient](
+                       msg:   var SessKey;
+                       nonce: var SessNonce;
+                       pub:   openArray[T];
+                       version = sessHdrMulti): string =
+  ## Creates a sessHdrMulti header for all the public keys given as
+  ## argument (none of them nil, at most sessMultiMax), see the module
+  ## description. The 'version' sessHdrHinted adds the key fingerprints.
+  ## It returns the binary header of sessMultiHdrLen() bytes.
+  var sdt: SessData
+  result = msg.doGetSessHeader(sdt, pub, version)
+  nonce = sdt.sNonce
+  (addr sdt).zeroMem(sdt.sizeof)                     # clear key data
+
+
+
+proc getSessHdrVersion*(rawHdr: string): SessHdrVersion =
+  ## guess the format version of a binary session header from its version
+  ## tag; a legacy header generated by an older version of this module
+  ## carries the X25519 tag by chance with a probability of 1/65536, so
+  ## the caller should fall back to sessHdrLegacy if the decoded message
+  ## cannot be verified
+  if 0 < rawHdr.multiCount(result):
+    discard
+  elif HdrTotalLen <= rawHdr.len and
+     rawHdr[HdrTotalLen - 2].ord.uint8 == sessTagX25519[0] and
+     rawHdr[HdrTotalLen - 1].ord.uint8 == sessTagX25519[1]:
+    result = sessHdrX25519
+
+proc getSessHdrLen*(rawHdr: string): int =
+  ## length of the binary session header starting with rawHdr, i.e. the
+  ## fixed length for the three slot formats or the length of a
+  ## sessHdrMulti header; the first 8 bytes are needed, 0 is returned if
+  ## rawHdr is shorter
+  if 8 <= rawHdr.len:
+    var version: SessHdrVersion
+    let n = rawHdr.multiCount(version)
+    result = if 0 < n: multiLen(n, version) else: HdrTotalLen
+
+proc getSessHdrHints*(rawHdr: string): seq[EccFingerprint] =
+  ## the key fingerprints of the slots of a complete sessHdrHinted header
+  ## in slot order, empty for the other formats
+  var version: SessHdrVersion
+  let n = rawHdr.multiCount(version)
+  result = @[]
+  if version == sessHdrHinted and
+     0 < n and multiLen(n, version) <= rawHdr.len:
+    result.setLen(n)
+    for i in 0..<n:
+      (addr result[i][0]).copyMem(
+        unsafeAddr rawHdr[MultiPreLen + i * version.slotLen],
+        EccFingerprint.sizeof)
+
 proc extrB64SessMsg*(msg:    var array[3,SessKey];
                      nonce:  var SessNonce;
-                     b64Hdr: string; prv: ptr array[3,ptr EccPrvKey]) =
+                     b64Hdr: string; prv: ptr array[3,ptr EccPrvKey];
+                     version = sessHdrLegacy) =
   ## Decrypt session header and retrieve the message 'msg' in three
   ## variations. The position of the three message decodings correspond
   ## to the positions of the argument ECC private keys (ideally all three
   ## message variations are the same). Leave unused private key slots nil.
   ##
   ## Note: There is no means to check here whether the decoding of the
-  ## shared message was correct.
+  ## shared message was correct. The header format 'version' must match the
+  ## one used for creating the header, see getSessHdrVersion().
   var
     sdt: SessData
-    hdr = b64Hdr.decode
-  msg.doExtrSessMsg(sdt, hdr, prv)
+    hdr = b64Hdr.b64Decode
+  msg.doExtrSessMsg(sdt, hdr, prv, version)
   nonce = sdt.sNonce
   (addr sdt).zeroMem(sdt.sizeof)                   # clear key data
 
 proc extrB64SessMsg*(msg: var array[3,SessKey];
-                     b64Hdr: string; prv: ptr array[3,ptr EccPrvKey]) =
+                     b64Hdr: string; prv: ptr array[3,ptr EccPrvKey];
+                     version = sessHdrLegacy) =
   var
     sdt: SessData
-    hdr = b64Hdr.decode
-  msg.doExtrSessMsg(sdt, hdr, prv)
+    hdr = b64Hdr.b64Decode
+  msg.doExtrSessMsg(sdt, hdr, prv, version)
   (addr sdt).zeroMem(sdt.sizeof)                   # clear key data
 
 proc extrRawSessMsg*(msg:    var array[3,SessKey];
                      nonce:  var SessNonce;
                      rawHdr: string;
-                     prv: ptr array[3,ptr EccPrvKey]) =
+                     prv: ptr array[3,ptr EccPrvKey];
+                     version = sessHdrLegacy) =
   ## same as extrB64SessMsg() but with binary 228 byte header (or more) rather
   ## than the base64 encoded version
   var sdt: SessData
-  msg.doExtrSessMsg(sdt, rawHdr, prv)
+  msg.doExtrSessMsg(sdt, rawHdr, prv, version)
+  nonce = sdt.sNonce
+  (addr sdt).zeroMem(sdt.sizeof)                   # clear key data
+
+proc extrRawSessMsg*(msg:    var seq[SessKey];
+                     nonce:  var SessNonce;
+                     rawHdr: string;
+                     prv:    ptr EccPrvKey;
+                     fpr:    ptr EccFingerprint = nil) =
+  ## Decrypt a sessHdrMulti header and retrieve the message 'msg' for each
+  ## of its slots with a single session key derivation. The right slot is
+  ## not known, the slot matching the private key 'prv' holds the message.
+  ##
+  ## For a sessHdrHinted header, only the slots carrying the fingerprint of
+  ## the public key for 'prv' are decoded (typically one.) No session key
+  ## is derived if there is none. Pass the fingerprint 'fpr' if it is known,
+  ## otherwise it is derived from 'prv' which costs a public key derivation.
+  ##
+  ## 'msg' is left empty if rawHdr is not a complete header of these
+  ## formats, or if 'prv' does not match a hint.
+  var sdt: SessData
+  msg.doExtrSessMsg(sdt, rawHdr, prv, fpr)
   nonce = sdt.sNonce
   (addr sdt).zeroMem(sdt.sizeof)                   # clear key data
 
@@ -336,7 +657,7 @@ when isMainModule:
     var
       n = 0
       q = newSeq[string](0)
-      d = s.decode
+      d = s.b64Decode
     assert d.len == HdrTotalLen
     for _ in 0..1:
       for _ in 0..2:
@@ -386,6 +707,119 @@ when isMainModule:
     doAssert key == kq[1]
     doAssert key == kq[2]
 
+    var
+      pq: array[3, EccPrepPubKey]
+      kr: array[3,ptr EccPrepPubKey]
+      non: SessNonce
+    for n in 0..1:                                 # leave last slot empty
+      doAssert pq[n].getEccPrepPubKey(ku[n])
+      kr[n] = addr pq[n]
+    var raw = getRawSessHeader(msg, non, addr kr)
+    msa.extrRawSessMsg(non, raw, addr kp)
+    key = msg.mapIt(it.ord.toHex(2)).join(" ")
+    kq  = msa.ppSk
+    doAssert key == kq[0]
+    doAssert key == kq[1]
+    doAssert key != kq[2]
+    var filler: EccPubKey                          # valid looking W
+    (addr filler.pubKey[0]).copyMem(addr raw[64], SessKeyLen)
+    doAssert pq[2].getEccPrepPubKey(addr filler)
+
+    var pr: array[3,PreparedRecipient]
+    for n in 1..2:                                 # leave first slot empty
+      pr[n] = newPreparedRecipient(ku[n])
+    raw = getRawSessHeader(msg, non, addr pr)
+    msa.extrRawSessMsg(non, raw, addr kp)
+    key = msg.mapIt(it.ord.toHex(2)).join(" ")
+    kq  = msa.ppSk
+    doAssert key != kq[0]
+    doAssert key == kq[1]
+    doAssert key == kq[2]
+
+    for n in 0..2:                                 # X25519 header version
+      pr[n] = newPreparedRecipient(ku[n])
+    for pub in [addr ku, nil]:
+      if pub.isNil:
+        raw = getRawSessHeader(msg, non, addr pr, sessHdrX25519)
+      else:
+        raw = getRawSessHeader(msg, non, pub, sessHdrX25519)
+      doAssert raw.getSessHdrVersion == sessHdrX25519
+      msa.extrRawSessMsg(non, raw, addr kp, sessHdrX25519)
+      key = msg.mapIt(it.ord.toHex(2)).join(" ")
+      kq  = msa.ppSk
+      doAssert key == kq[0]
+      doAssert key == kq[1]
+      doAssert key == kq[2]
+      msa.extrRawSessMsg(non, raw, addr kp)        # wrong version
+      doAssert key != msa[0].ppSk
+    doAssert hdr.b64Decode.getSessHdrVersion == sessHdrLegacy
+    doAssert hdr.b64Decode.getSessHdrLen == HdrTotalLen
+
+  block: # multi recipient header
+    var
+      pk: array[5, EccPrvKey]
+      pu: array[5, EccPubKey]
+      ku: seq[ptr EccPubKey] = @[]
+      msg: SessKey
+      non, nox: SessNonce
+      msa: seq[SessKey]
+    for n in 0..4:
+      pk[n].getEccPrvKey()
+      pu[n].getEccPubKey(addr pk[n])
+      ku.add addr pu[n]
+    for count in [1, 2, 5]:
+      let raw = getRawSessHeader(msg, non, ku[0..<count])
+      doAssert raw.len == sessMultiHdrLen(count)
+      doAssert raw.getSessHdrVersion == sessHdrMulti
+      doAssert raw.getSessHdrLen == raw.len
+      for n in 0..4:                               # one S(p,W) for all slots
+        msa.extrRawSessMsg(nox, raw, addr pk[n])
+        doAssert msa.len == count and nox == non
+        if n < count:
+          doAssert msa[n] == msg
+        else:
+          doAssert msg notin msa
+      msa.extrRawSessMsg(nox, raw[0..<raw.len-1], addr pk[0]) # truncated
+      doAssert msa.len == 0
+
+    for count in [1, 3]:                           # with key fingerprints
+      let raw = getRawSessHeader(msg, non, ku[1..count], sessHdrHinted)
+      doAssert raw.len == sessMultiHdrLen(count, sessHdrHinted)
+      doAssert raw.getSessHdrVersion == sessHdrHinted
+      doAssert raw.getSessHdrLen == raw.len
+      for n in 0..4:                               # only the own slot
+        var fpr: EccFingerprint
+        fpr.getEccFingerprint(addr pu[n])
+        msa.extrRawSessMsg(nox, raw, addr pk[n], addr fpr)
+        if 0 < n and n <= count:
+          doAssert msa == @[msg] and nox == non
+        else:
+          doAssert msa.len == 0
+        msa.extrRawSessMsg(nox, raw, addr pk[n])  # derived fingerprint
+        doAssert msa.len == (if 0 < n and n <= count: 1 else: 0)
+        if 0 < n and n <= count:
+          doAssert raw.getSessHdrHints[n - 1] == fpr
+      doAssert raw.getSessHdrHints.len == count
+    doAssert getRawSessHeader(msg, non, ku).getSessHdrHints.len == 0
+
+  block: # ephemeral keys from the background pool
+    var
+      pk: EccPrvKey
+      pu: EccPubKey
+      ku = [addr pu, nil, nil]
+      kp = [addr pk, nil, nil]
+      msg: SessKey
+      non, nox: SessNonce
+      msa: array[3,SessKey]
+    pk.getEccPrvKey()
+    pu.getEccPubKey(addr pk)
+    doAssert sessKeyPoolStart(4)
+    for n in 0..9:                                 # more than the pool size
+      let raw = getRawSessHeader(msg, non, addr ku, sessHdrX25519)
+      msa.extrRawSessMsg(nox, raw, addr kp, sessHdrX25519)
+      doAssert msa[0] == msg
+    sessKeyPoolStop()
+
 #  when not defined(check_run):
 #    echo "*** not yet"
 
@@ -0,0 +1,228 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Pool of ephemeral key pairs generated by a background thread. Creating
+ * a key pair needs a fixed-base scalar multiplication, this is done ahead
+ * of time so a sender only copies a ready pair.
+ *
+ * The pool is a bounded ring of slots, each with a sequence number telling
+ * whether it is ready for the producer (the background thread) or for a
+ * consumer. A consumer claims a ready slot by advancing the head with a
+ * compare-and-swap, copies and wipes the key pair and hands the slot back
+ * to the producer. So taking a key pair never blocks. The producer sleeps
+ * while the ring is full and is woken up by the first key pair taken.
+ *
+ * The private keys are drawn from the system random device (not from the
+ * generator used elsewhere by the library.) The device is opened before
+ * the thread is started, so a pool is only created if it can be read. The
+ * thread stops generating when reading fails later on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "ecc_pool.h"
+
+#define RND_DEVICE  "/dev/urandom"
+#define RND_BATCH   16			/* private keys read at a time */
+
+typedef struct {
+	unsigned long seq;		/* pos: producer, pos + 1: consumer */
+	ecc_int256_t  prv;
+	ecc_int256_t  pub;
+} slot_t;
+
+struct ecc_pool {
+	unsigned long   head;		/* next slot to take */
+	unsigned long   tail;		/* next slot to fill (producer) */
+	unsigned long   mask;		/* ring size - 1 */
+	int             sleeping;	/* producer waits for a free slot */
+	int             stop;
+	pthread_mutex_t lock;		/* producer sleep/wake up */
+	pthread_cond_t  wake;
+	pthread_t       thread;
+	FILE           *rnd;		/* random device */
+	slot_t         *ring;
+};
+
+#define LOAD(p)      __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE(p, v)  __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+/* the producer going to sleep and a consumer freeing a slot must see each
+ * other's store, this needs a full barrier */
+#define LOAD_SC(p)     __atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define STORE_SC(p, v) __atomic_store_n(p, v, __ATOMIC_SEQ_CST)
+
+static void wipe(void *p, size_t n)
+{
+	volatile uint8_t *q = p;
+	while (n--)
+		*q++ = 0;
+}
+
+/* wait until the slot at tail is free, returns 0 if the pool is stopped */
+static int wait_free(ecc_pool_t *pool, slot_t *s)
+{
+	if (LOAD(&s->seq) == pool->tail)
+		return 1;
+	pthread_mutex_lock(&pool->lock);
+	STORE_SC(&pool->sleeping, 1);
+	while (LOAD_SC(&s->seq) != pool->tail && !pool->stop)
+		pthread_cond_wait(&pool->wake, &pool->lock);
+	STORE(&pool->sleeping, 0);
+	pthread_mutex_unlock(&pool->lock);
+	return !pool->stop;
+}
+
+static void *producer(void *arg)
+{
+	ecc_pool_t *pool = arg;
+	ecc_int256_t rnd[RND_BATCH];
+	ecc_25519_work_t w;
+	unsigned n = RND_BATCH;
+
+	while (!LOAD(&pool->stop)) {
+		slot_t *s = &pool->ring[pool->tail & pool->mask];
+
+		if (n == RND_BATCH) {
+			if (fread(rnd, sizeof(rnd), 1, pool->rnd) != 1)
+				break;
+			n = 0;
+		}
+		if (!wait_free(pool, s))
+			break;
+		ecc_25519_gf_sanitize_secret(&s->prv, &rnd[n]);
+		wipe(&rnd[n++], sizeof(rnd[0]));
+		ecc_25519_scalarmult_base(&w, &s->prv);
+		ecc_25519_store_packed_ed25519(&s->pub, &w);
+		STORE(&s->seq, pool->tail + 1);			/* ready */
+		pool->tail++;
+	}
+
+	wipe(rnd, sizeof(rnd));
+	wipe(&w, sizeof(w));
+	return NULL;
+}
+
+ecc_pool_t *ecc_pool_new(unsigned size)
+{
+	ecc_pool_t *pool;
+	unsigned long n = 1, i;
+
+	while (n < size && n < ECC_POOL_MAX)
+		n <<= 1;
+
+	if ((pool = calloc(1, sizeof(*pool))) == NULL)
+		return NULL;
+	if ((pool->ring = calloc(n, sizeof(slot_t))) == NULL) {
+		free(pool);
+		return NULL;
+	}
+	if ((pool->rnd = fopen(RND_DEVICE, "rb")) == NULL) {
+		free(pool->ring);
+		free(pool);
+		return NULL;
+	}
+	setvbuf(pool->rnd, NULL, _IONBF, 0);
+	pool->mask = n - 1;
+	for (i = 0; i < n; i++)
+		pool->ring[i].seq = i;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+
+	if (pthread_create(&pool->thread, NULL, producer, pool) != 0) {
+		pthread_cond_destroy(&pool->wake);
+		pthread_mutex_destroy(&pool->lock);
+		fclose(pool->rnd);
+		free(pool->ring);
+		free(pool);
+		return NULL;
+	}
+	return pool;
+}
+
+int ecc_pool_take(ecc_pool_t *pool, ecc_int256_t *prv, ecc_int256_t *pub)
+{
+	unsigned long pos;
+	slot_t *s;
+
+	if (pool == NULL)
+		return 0;
+
+	pos = LOAD(&pool->head);
+	for (;;) {
+		s = &pool->ring[pos & pool->mask];
+		if (LOAD(&s->seq) != pos + 1)
+			return 0;			/* empty */
+		if (__atomic_compare_exchange_n(&pool->head, &pos, pos + 1, 0,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			break;				/* pos is updated on failure */
+	}
+
+	memcpy(prv, &s->prv, sizeof(*prv));
+	memcpy(pub, &s->pub, sizeof(*pub));
+	wipe(&s->prv, sizeof(s->prv));
+	STORE_SC(&s->seq, pos + pool->mask + 1);	/* free for producer */
+
+	if (LOAD_SC(&pool->sleeping)) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_signal(&pool->wake);
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return 1;
+}
+
+unsigned ecc_pool_level(const ecc_pool_t *pool)
+{
+	unsigned long head, n = 0;
+
+	if (pool == NULL)
+		return 0;
+	head = LOAD(&pool->head);
+	while (n <= pool->mask && LOAD(&pool->ring[(head + n) & pool->mask].seq) == head + n + 1)
+		n++;
+	return n;
+}
+
+void ecc_pool_free(ecc_pool_t *pool)
+{
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	STORE(&pool->stop, 1);
+	pthread_cond_signal(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	pthread_join(pool->thread, NULL);
+
+	wipe(pool->ring, (pool->mask + 1) * sizeof(slot_t));
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+	fclose(pool->rnd);
+	free(pool->ring);
+	free(pool);
+}
@@ -0,0 +1,55 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Pool of ephemeral key pairs generated by a background thread.
+ */
+
+#ifndef _ECC_POOL_H
+#define _ECC_POOL_H
+
+#include <libuecc/ecc.h>
+
+#define ECC_POOL_MAX  4096		/* key pairs, at most */
+
+typedef struct ecc_pool ecc_pool_t;
+
+/* Start a background thread keeping up to size (rounded up to a power of
+ * two) fresh key pairs, the private keys are read from /dev/urandom.
+ * Returns NULL if the random device cannot be opened (e.g. on Windows) or
+ * the thread could not be started. */
+ecc_pool_t *ecc_pool_new(unsigned size);
+
+/* Take the next key pair, the pool copy is wiped. Returns 1 if a key pair
+ * was taken, 0 if the pool is empty (or NULL.) Any thread may call this. */
+int ecc_pool_take(ecc_pool_t *pool, ecc_int256_t *prv, ecc_int256_t *pub);
+
+/* Number of key pairs ready */
+unsigned ecc_pool_level(const ecc_pool_t *pool);
+
+/* Stop the thread, wipe the key pairs left and free the pool. No other
+ * thread may use the pool during or after this call. */
+void ecc_pool_free(ecc_pool_t *pool);
+
+#endif /* _ECC_POOL_H */
@@ -32,6 +32,7 @@
 #endif
 
 
+#include <stddef.h>
 #include <stdint.h>
 
 
@@ -58,6 +59,17 @@ typedef struct _ecc_25519_work {
 	uint32_t T[32];
 } ecc_25519_work_t;
 
+/**
+ * A window table of multiples of a point for fast scalar multiplication
+ *
+ * Entry p[w][i-1] holds \f$ i \cdot 16^w \cdot P \f$ as an affine point in a
+ * form suited for addition. The table is about 90 KB, it pays off when
+ * the same point is multiplied more than a few times.
+ */
+typedef struct _ecc_25519_table {
+	uint8_t p[64][15][96];
+} ecc_25519_table_t;
+
 /**
  * \defgroup curve_ops Operations on points of the Elliptic Curve
  * @{
@@ -118,6 +130,31 @@ DEPRECATED int ecc_25519_load_xy(ecc_25519_work_t *out, const ecc_int256_t *x, c
  */
 void ecc_25519_store_xy_ed25519(ecc_int256_t *x, ecc_int256_t *y, const ecc_25519_work_t *in);
 
+/**
+ * Stores the x and y coordinates of several points of the Ed25519 curve
+ *
+ * Same as calling \ref ecc_25519_store_xy_ed25519 for each point, but the
+ * field inversions of all points are combined into one (Montgomery's
+ * trick), which makes storing a batch of points much faster. All points
+ * must have been produced by the functions of this library.
+ *
+ * \param x Returns the x coordinates of the points. May be NULL.
+ * \param y Returns the y coordinates of the points. May be NULL.
+ * \param in The unpacked points to store.
+ * \param n The number of points.
+ */
+void ecc_25519_store_xy_ed25519_batch(ecc_int256_t *x, ecc_int256_t *y, const ecc_25519_work_t *in, size_t n);
+
+/**
+ * Stores the u coordinate of the Montgomery form (Curve25519) of a point of the Ed25519 curve
+ *
+ * This is the coordinate used by X25519, \f$ u = (1 + y)/(1 - y) \f$.
+ *
+ * \param out Returns the u coordinate of the point.
+ * \param in The unpacked point to store.
+ */
+void ecc_25519_store_x25519(ecc_int256_t *out, const ecc_25519_work_t *in);
+
 /**
  * Stores the x and y coordinates of a point of the legacy curve
  *
@@ -250,6 +287,8 @@ void ecc_25519_scalarmult(ecc_25519_work_t *out, const ecc_int256_t *n, const ec
  * The order of the base point is \f$ 2^{252} + 27742317777372353535851937790883648493 \f$.
  *
  * ecc_25519_scalarmult_base_bits(out, n, bits) is faster than ecc_25519_scalarmult_bits(out, n, &ecc_25519_work_default_base, bits).
+ * It uses a precomputed table of base point multiples (one addition per 4 bit window, no doubling)
+ * and runs in constant time regardless of the value of \em bits.
  *
  * See the notes about \ref ecc_25519_scalarmult_bits before using this function.
  */
@@ -264,6 +303,54 @@ void ecc_25519_scalarmult_base_bits(ecc_25519_work_t *out, const ecc_int256_t *n
  */
 void ecc_25519_scalarmult_base(ecc_25519_work_t *out, const ecc_int256_t *n);
 
+/**
+ * Computes the window table of a point of the Elliptic Curve
+ *
+ * This costs about as much as six calls of \ref ecc_25519_scalarmult.
+ */
+void ecc_25519_table_init(ecc_25519_table_t *out, const ecc_25519_work_t *base);
+
+/**
+ * Does a scalar multiplication of a point given by its window table with an integer of a given bit length
+ *
+ * ecc_25519_scalarmult_table_bits(out, n, table, bits) gives the same result as
+ * ecc_25519_scalarmult_bits(out, n, base, bits) for the point \em base the table was computed from,
+ * but is several times faster. Like \ref ecc_25519_scalarmult_base_bits it runs in constant time
+ * regardless of the value of \em bits.
+ */
+void ecc_25519_scalarmult_table_bits(ecc_25519_work_t *out, const ecc_int256_t *n, const ecc_25519_table_t *table, unsigned bits);
+
+/**
+ * Does a scalar multiplication of a point given by its window table with an integer
+ */
+void ecc_25519_scalarmult_table(ecc_25519_work_t *out, const ecc_int256_t *n, const ecc_25519_table_t *table);
+
+/**
+ * Does an X25519 scalar multiplication (Montgomery ladder) of a point given in packed Ed25519 format
+ *
+ * Only the y coordinate of the packed point is used, so the point is neither
+ * unpacked nor checked. The result is the u coordinate of the product as
+ * \ref ecc_25519_store_x25519 would store it for
+ * \ref ecc_25519_scalarmult(n, \em in), and about twice as fast as that
+ * together with \ref ecc_25519_load_packed_ed25519. The ladder uses all
+ * 256 bits of \em n and runs in constant time.
+ *
+ * \param out Returns the u coordinate of the product.
+ * \param n The scalar.
+ * \param in The packed point.
+ * \return 0 if the result is zero (\em in is of small order or not a valid point), 1 otherwise
+ */
+int ecc_25519_x25519_ed25519(ecc_int256_t *out, const ecc_int256_t *n, const ecc_int256_t *in);
+
+/**
+ * Binds the field arithmetic to the variant best suited for the CPU
+ *
+ * Only the 8 bit field backend (UECC_FIELD == 8) has such variants, for the
+ * other backends this function does nothing. This is done implicitly on first use, calling it early avoids races when
+ * the first use happens concurrently in several threads.
+ */
+void ecc_25519_dispatch_init(void);
+
 /**@}*/
 
 /**
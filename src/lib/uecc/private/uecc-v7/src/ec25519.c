@@ -58,6 +58,47 @@
 
 #include <libuecc/ecc.h>
 
+#if HAVE_CPU_DISPATCH
+#include "cpu_dispatch.h"
+#endif
+
+/*
+ * Field arithmetic backend, selected at build time by UECC_FIELD:
+ *
+ *   8   32 limbs of 8 bits, the original libuecc code
+ *   25  10 limbs of 26/25 bits (radix 2^25.5), 32x32->64 bit products
+ *   51  5 limbs of 51 bits, 64x64->128 bit products (unsigned __int128)
+ *
+ * The default is 51 if the compiler supports 128 bit integers, 25 otherwise.
+ * Each backend defines the unpacked integer type fe (an array of FE_LIMBS
+ * integers of type fe_limb) and the functions add, sub, squeeze, mult,
+ * square, mult_int, unpack, pack and freeze. The backends only differ in
+ * speed, all results of the public API are the same.
+ */
+#ifndef UECC_FIELD
+#ifdef __SIZEOF_INT128__
+#define UECC_FIELD 51
+#else
+#define UECC_FIELD 25
+#endif
+#endif
+
+#if UECC_FIELD == 8
+#include "ec25519_fe8.h"
+#elif UECC_FIELD == 25
+#include "ec25519_fe25.h"
+#elif UECC_FIELD == 51
+#include "ec25519_fe51.h"
+#else
+#error "UECC_FIELD must be 8, 25 or 51"
+#endif
+
+#if UECC_FIELD != 8
+void ecc_25519_dispatch_init(void) {
+	/* no run time variants of this backend */
+}
+#endif
+
 
 const ecc_25519_work_t ecc_25519_work_identity = {{0}, {1}, {1}, {0}};
 
@@ -111,8 +152,8 @@ const ecc_25519_work_t ecc_25519_work_base_ed25519 = {
 };
 
 
-static const uint32_t zero[32] = {0};
-static const uint32_t one[32] = {1};
+static const fe zero = {0};
+static const fe one = {1};
 
 static const uint32_t minus1[32] = {
 	0xec, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
@@ -147,261 +188,95 @@ static const uint32_t ed25519_to_legacy[32] = {
 };
 
 
-/** Adds two unpacked integers (modulo p) */
-static void add(uint32_t out[32], const uint32_t a[32], const uint32_t b[32]) {
-	unsigned int j;
-	uint32_t u;
-
-	u = 0;
-
-	for (j = 0; j < 31; j++) {
-		u += a[j] + b[j];
-		out[j] = u & 255;
-		u >>= 8;
-	}
-
-	u += a[31] + b[31];
-	out[31] = u;
-}
-
-/**
- * Subtracts two unpacked integers (modulo p)
- *
- * b must be \em squeezed.
- */
-static void sub(uint32_t out[32], const uint32_t a[32], const uint32_t b[32]) {
-	unsigned int j;
-	uint32_t u;
-
-	u = 218;
-
-	for (j = 0;j < 31;++j) {
-		u += a[j] + UINT32_C(65280) - b[j];
-		out[j] = u & 255;
-		u >>= 8;
-	}
+/** Internal representation of a \ref ecc_25519_work_t with unpacked integers of the field backend */
+typedef struct {
+	fe X, Y, Z, T;
+} point_t;
 
-	u += a[31] - b[31];
-	out[31] = u;
-}
 
-/**
- * Performs carry and reduce on an unpacked integer
- *
- * The result is not always fully reduced, but it will be significantly smaller than \f$ 2p \f$.
- */
-static void squeeze(uint32_t a[32]) {
+/** Copies an unpacked integer */
+static void copy(fe out, const fe a) {
 	unsigned int j;
-	uint32_t u;
-
-	u = 0;
-
-	for (j = 0;j < 31;++j) {
-		u += a[j];
-		a[j] = u & 255;
-		u >>= 8;
-	}
 
-	u += a[31];
-	a[31] = u & 127;
-	u = 19 * (u >> 7);
-
-	for (j = 0;j < 31;++j) {
-		u += a[j];
-		a[j] = u & 255;
-		u >>= 8;
-	}
-
-	u += a[31];
-	a[31] = u;
+	for (j = 0; j < FE_LIMBS; j++)
+		out[j] = a[j];
 }
 
+/** Checks for the equality of two unpacked integers (modulo p) */
+static int check_equal(const fe x, const fe y) {
+	uint32_t xf[32], yf[32];
+	uint32_t differentbits = 0;
+	int i;
 
-static const uint32_t minusp[32] = {
-	19, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 128
-};
-
-/**
- * Ensures that the output of a previous \ref squeeze is fully reduced
- *
- * After a \ref freeze, only the lower byte of each integer part holds a meaningful value.
- */
-static void freeze(uint32_t a[32]) {
-	uint32_t aorig[32];
-	unsigned int j;
-	uint32_t negative;
+	freeze(xf, x);
+	freeze(yf, y);
 
-	for (j = 0; j < 32; j++)
-		aorig[j] = a[j];
-	add(a, a, minusp);
-	negative = -((a[31] >> 7) & 1);
+	for (i = 0; i < 32; i++)
+		differentbits |= xf[i] ^ yf[i];
 
-	for (j = 0; j < 32; j++)
-		a[j] ^= negative & (aorig[j] ^ a[j]);
+	return (1 & ((differentbits - 1) >> 16));
 }
 
-/**
- * Returns the parity (lowest bit of the fully reduced value) of a
- *
- * The input must be \em squeezed.
- */
-static int parity(const uint32_t a[32]) {
-	uint32_t b[32];
-
-	add(b, a, minusp);
-	return (a[0] ^ (b[31] >> 7) ^ 1) & 1;
+/** Checks if an unpacked integer equals zero (modulo p) */
+static int check_zero(const fe x) {
+	return check_equal(x, zero);
 }
 
-/**
- * Multiplies two unpacked integers (modulo p)
- *
- * The result will be \em squeezed.
- */
-static void mult(uint32_t out[32], const uint32_t a[32], const uint32_t b[32]) {
-	unsigned int i, j;
-	uint32_t u;
-
-	for (i = 0; i < 32; ++i) {
-		u = 0;
-
-		for (j = 0; j <= i; j++)
-			u += a[j] * b[i - j];
-
-		for (j = i + 1; j < 32; j++)
-			u += 38 * a[j] * b[i + 32 - j];
-
-		out[i] = u;
-	}
+/** Returns the parity (lowest bit of the fully reduced value) of a */
+static int parity(const fe a) {
+	uint32_t af[32];
 
-	squeeze(out);
+	freeze(af, a);
+	return af[0] & 1;
 }
 
-/**
- * Multiplies an unpacked integer with a small integer (modulo p)
- *
- * The result will be \em squeezed.
- */
-static void mult_int(uint32_t out[32], uint32_t n, const uint32_t a[32]) {
+/** Copies r to out when b == 0, s when b == 1 */
+static void select(fe out, const fe r, const fe s, uint32_t b) {
 	unsigned int j;
-	uint32_t u;
-
-	u = 0;
-
-	for (j = 0; j < 31; j++) {
-		u += n * a[j];
-		out[j] = u & 255;
-		u >>= 8;
-	}
+	fe_limb t;
+	fe_limb bminus1;
 
-	u += n * a[31]; out[31] = u & 127;
-	u = 19 * (u >> 7);
-
-	for (j = 0; j < 31; j++) {
-		u += out[j];
-		out[j] = u & 255;
-		u >>= 8;
+	bminus1 = (fe_limb)b - 1;
+	for (j = 0; j < FE_LIMBS; ++j) {
+		t = bminus1 & (r[j] ^ s[j]);
+		out[j] = s[j] ^ t;
 	}
-
-	u += out[j];
-	out[j] = u;
 }
 
-/**
- * Squares an unpacked integer
- *
- * The result will be sqeezed.
- */
-static void square(uint32_t out[32], const uint32_t a[32]) {
-	unsigned int i, j;
-	uint32_t u;
-
-	for (i = 0; i < 32; i++) {
-		u = 0;
-
-		for (j = 0; j < i - j; j++)
-			u += a[j] * a[i - j];
-
-		for (j = i + 1; j < i + 32 - j; j++)
-			u += 38 * a[j] * a[i + 32 - j];
-
-		u *= 2;
-
-		if ((i & 1) == 0) {
-			u += a[i / 2] * a[i / 2];
-			u += 38 * a[i / 2 + 16] * a[i / 2 + 16];
-		}
-
-		out[i] = u;
-	}
-
-	squeeze(out);
+/** Copies r to out when b == 0, s when b == 1 */
+static void selectw(point_t *out, const point_t *r, const point_t *s, uint32_t b) {
+	select(out->X, r->X, s->X, b);
+	select(out->Y, r->Y, s->Y, b);
+	select(out->Z, r->Z, s->Z, b);
+	select(out->T, r->T, s->T, b);
 }
 
-/** Checks for the equality of two unpacked integers */
-static int check_equal(const uint32_t x[32], const uint32_t y[32]) {
-	uint32_t differentbits = 0;
-	int i;
-
-	for (i = 0; i < 32; i++) {
-		differentbits |= ((x[i] ^ y[i]) & 0xffff);
-		differentbits |= ((x[i] ^ y[i]) >> 16);
-	}
-
-	return (1 & ((differentbits - 1) >> 16));
+/** Converts a work structure to the internal representation */
+static void point_unpack(point_t *out, const ecc_25519_work_t *in) {
+	unpack(out->X, in->X);
+	unpack(out->Y, in->Y);
+	unpack(out->Z, in->Z);
+	unpack(out->T, in->T);
 }
 
-/**
- * Checks if an unpacked integer equals zero (modulo p)
- *
- * The integer must be squeezed before.
- */
-static int check_zero(const uint32_t x[32]) {
-	static const uint32_t p[32] = {
-		0xed, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f
-	};
-
-	return (check_equal(x, zero) | check_equal(x, p));
+/** Converts a point from the internal representation to a work structure */
+static void point_pack(ecc_25519_work_t *out, const point_t *in) {
+	pack(out->X, in->X);
+	pack(out->Y, in->Y);
+	pack(out->Z, in->Z);
+	pack(out->T, in->T);
 }
 
-/** Copies r to out when b == 0, s when b == 1 */
-static void selectw(ecc_25519_work_t *out, const ecc_25519_work_t *r, const ecc_25519_work_t *s, uint32_t b) {
-	unsigned int j;
-	uint32_t t;
-	uint32_t bminus1;
-
-	bminus1 = b - 1;
-	for (j = 0; j < 32; ++j) {
-		t = bminus1 & (r->X[j] ^ s->X[j]);
-		out->X[j] = s->X[j] ^ t;
-
-		t = bminus1 & (r->Y[j] ^ s->Y[j]);
-		out->Y[j] = s->Y[j] ^ t;
-
-		t = bminus1 & (r->Z[j] ^ s->Z[j]);
-		out->Z[j] = s->Z[j] ^ t;
-
-		t = bminus1 & (r->T[j] ^ s->T[j]);
-		out->T[j] = s->T[j] ^ t;
-	}
-}
+/** Unpacks an integer given as 32 bytes */
+static void unpack_bytes(fe out, const uint8_t in[32], uint8_t mask31) {
+	uint32_t tmp[32];
+	int i;
 
-/** Copies r to out when b == 0, s when b == 1 */
-static void select(uint32_t out[32], const uint32_t r[32], const uint32_t s[32], uint32_t b) {
-	unsigned int j;
-	uint32_t t;
-	uint32_t bminus1;
+	for (i = 0; i < 31; i++)
+		tmp[i] = in[i];
+	tmp[31] = in[31] & mask31;
 
-	bminus1 = b - 1;
-	for (j = 0;j < 32;++j) {
-		t = bminus1 & (r[j] ^ s[j]);
-		out[j] = s[j] ^ t;
-	}
+	unpack(out, tmp);
 }
 
 /**
@@ -409,7 +284,7 @@ static void select(uint32_t out[32], const uint32_t r[32], const uint32_t s[32],
  *
  * If the given integer has no square root, 0 is returned, 1 otherwise.
  */
-static int square_root(uint32_t out[32], const uint32_t z[32]) {
+static int square_root(fe out, const fe z) {
 	static const uint32_t rho_s[32] = {
 		0xb0, 0xa0, 0x0e, 0x4a, 0x27, 0x1b, 0xee, 0xc4,
 		0x78, 0xe4, 0x2f, 0xad, 0x06, 0x18, 0x43, 0x2f,
@@ -419,18 +294,19 @@ static int square_root(uint32_t out[32], const uint32_t z[32]) {
 
 	/* raise z to power (2^252-2), check if power (2^253-5) equals -1 */
 
-	uint32_t z2[32];
-	uint32_t z9[32];
-	uint32_t z11[32];
-	uint32_t z2_5_0[32];
-	uint32_t z2_10_0[32];
-	uint32_t z2_20_0[32];
-	uint32_t z2_50_0[32];
-	uint32_t z2_100_0[32];
-	uint32_t t0[32];
-	uint32_t t1[32];
-	uint32_t z2_252_1[32];
-	uint32_t z2_252_1_rho_s[32];
+	fe z2;
+	fe z9;
+	fe z11;
+	fe z2_5_0;
+	fe z2_10_0;
+	fe z2_20_0;
+	fe z2_50_0;
+	fe z2_100_0;
+	fe t0;
+	fe t1;
+	fe z2_252_1;
+	fe z2_252_1_rho_s;
+	fe c;
 	int i;
 
 	/* 2 */ square(z2, z);
@@ -486,9 +362,11 @@ static int square_root(uint32_t out[32], const uint32_t z[32]) {
 	/* 2^253 - 6 */ mult(t0, t1, z2);
 	/* 2^253 - 5 */ mult(t1, t0, z);
 
-	mult(z2_252_1_rho_s, z2_252_1, rho_s);
+	unpack(c, rho_s);
+	mult(z2_252_1_rho_s, z2_252_1, c);
 
-	select(out, z2_252_1, z2_252_1_rho_s, check_equal(t1, minus1));
+	unpack(c, minus1);
+	select(out, z2_252_1, z2_252_1_rho_s, check_equal(t1, c));
 
 	/* Check the root */
 	square(t0, out);
@@ -496,17 +374,17 @@ static int square_root(uint32_t out[32], const uint32_t z[32]) {
 }
 
 /** Computes the reciprocal of an unpacked integer (in the prime field modulo p) */
-static void recip(uint32_t out[32], const uint32_t z[32]) {
-	uint32_t z2[32];
-	uint32_t z9[32];
-	uint32_t z11[32];
-	uint32_t z2_5_0[32];
-	uint32_t z2_10_0[32];
-	uint32_t z2_20_0[32];
-	uint32_t z2_50_0[32];
-	uint32_t z2_100_0[32];
-	uint32_t t0[32];
-	uint32_t t1[32];
+static void recip(fe out, const fe z) {
+	fe z2;
+	fe z9;
+	fe z11;
+	fe z2_5_0;
+	fe z2_10_0;
+	fe z2_20_0;
+	fe z2_50_0;
+	fe z2_100_0;
+	fe t0;
+	fe t1;
 	int i;
 
 	/* 2 */ square(z2, z);
@@ -562,19 +440,52 @@ static void recip(uint32_t out[32], const uint32_t z[32]) {
 	/* 2^255 - 21 */ mult(out, t1, z11);
 }
 
+/** Maximum number of integers sharing one inversion in \ref recip_batch */
+#define RECIP_BATCH 32
+
+/**
+ * Computes the reciprocals of n unpacked integers with a single \ref recip
+ *
+ * n must not exceed RECIP_BATCH and out must not overlap in.
+ */
+static void recip_batch(fe out[], const fe in[], size_t n) {
+	fe prod[RECIP_BATCH];
+	fe inv, tmp;
+	size_t i;
+
+	if (n == 0)
+		return;
+
+	/* prod[i] = in[0] * ... * in[i] */
+	copy(prod[0], in[0]);
+	for (i = 1; i < n; i++)
+		mult(prod[i], prod[i - 1], in[i]);
+
+	/* inv = 1/(in[0] * ... * in[i]), walking down */
+	recip(inv, prod[n - 1]);
+	for (i = n - 1; 0 < i; i--) {
+		mult(out[i], inv, prod[i - 1]);
+		mult(tmp, inv, in[i]);
+		copy(inv, tmp);
+	}
+	copy(out[0], inv);
+}
+
+
 /**
- * Checks if the X and Y coordinates of a work structure represent a valid point of the curve
+ * Checks if the X and Y coordinates of a point represent a valid point of the curve
  *
  * Also fills in the T coordinate.
  */
-static int check_load_xy(ecc_25519_work_t *val) {
-	uint32_t X2[32], Y2[32], dX2[32], dX2Y2[32], Y2_X2[32], Y2_X2_1[32], r[32];
+static int check_load_xy(point_t *val) {
+	fe X2, Y2, dX2, dX2Y2, Y2_X2, Y2_X2_1, r, D;
 
 	/* Check validity */
 	square(X2, val->X);
 	square(Y2, val->Y);
 
-	mult(dX2, d, X2);
+	unpack(D, d);
+	mult(dX2, D, X2);
 	mult(dX2Y2, dX2, Y2);
 
 	sub(Y2_X2, Y2, X2);
@@ -592,30 +503,37 @@ static int check_load_xy(ecc_25519_work_t *val) {
 }
 
 int ecc_25519_load_xy_ed25519(ecc_25519_work_t *out, const ecc_int256_t *x, const ecc_int256_t *y) {
-	int i;
+	point_t P;
+	int ret;
 
-	for (i = 0; i < 32; i++) {
-		out->X[i] = x->p[i];
-		out->Y[i] = y->p[i];
-		out->Z[i] = (i == 0);
-	}
+	unpack_bytes(P.X, x->p, 0xff);
+	unpack_bytes(P.Y, y->p, 0xff);
+	copy(P.Z, one);
+	copy(P.T, zero);
 
-	return check_load_xy(out);
+	ret = check_load_xy(&P);
+	point_pack(out, &P);
+
+	return ret;
 }
 
 int ecc_25519_load_xy_legacy(ecc_25519_work_t *out, const ecc_int256_t *x, const ecc_int256_t *y) {
-	int i;
-	uint32_t tmp[32];
+	point_t P;
+	fe tmp, L;
+	int ret;
 
-	for (i = 0; i < 32; i++) {
-		tmp[i] = x->p[i];
-		out->Y[i] = y->p[i];
-		out->Z[i] = (i == 0);
-	}
+	unpack_bytes(tmp, x->p, 0xff);
+	unpack_bytes(P.Y, y->p, 0xff);
+	copy(P.Z, one);
+	copy(P.T, zero);
+
+	unpack(L, legacy_to_ed25519);
+	mult(P.X, tmp, L);
 
-	mult(out->X, tmp, legacy_to_ed25519);
+	ret = check_load_xy(&P);
+	point_pack(out, &P);
 
-	return check_load_xy(out);
+	return ret;
 }
 
 int ecc_25519_load_xy(ecc_25519_work_t *out, const ecc_int256_t *x, const ecc_int256_t *y) {
@@ -623,46 +541,83 @@ int ecc_25519_load_xy(ecc_25519_work_t *out, const ecc_int256_t *x, const ecc_in
 }
 
 
-void ecc_25519_store_xy_ed25519(ecc_int256_t *x, ecc_int256_t *y, const ecc_25519_work_t *in) {
-	uint32_t X[32], Y[32], Z[32];
+/** Stores the x and y coordinates of a point, given the reciprocal of its Z coordinate */
+static void store_xy_ed25519(ecc_int256_t *x, ecc_int256_t *y, const ecc_25519_work_t *in, const fe Z) {
+	uint32_t out[32];
+	fe X, Y, tmp;
 	int i;
 
-	recip(Z, in->Z);
-
 	if (x) {
-		mult(X, Z, in->X);
-		freeze(X);
+		unpack(tmp, in->X);
+		mult(X, Z, tmp);
+		freeze(out, X);
 		for (i = 0; i < 32; i++)
-			x->p[i] = X[i];
+			x->p[i] = out[i];
 	}
 
 	if (y) {
-		mult(Y, Z, in->Y);
-		freeze(Y);
+		unpack(tmp, in->Y);
+		mult(Y, Z, tmp);
+		freeze(out, Y);
 		for (i = 0; i < 32; i++)
-			y->p[i] = Y[i];
+			y->p[i] = out[i];
+	}
+}
+
+void ecc_25519_store_xy_ed25519(ecc_int256_t *x, ecc_int256_t *y, const ecc_25519_work_t *in) {
+	fe Z, tmp;
+
+	unpack(tmp, in->Z);
+	recip(Z, tmp);
+
+	store_xy_ed25519(x, y, in, Z);
+}
+
+void ecc_25519_store_xy_ed25519_batch(ecc_int256_t *x, ecc_int256_t *y, const ecc_25519_work_t *in, size_t n) {
+	fe Z[RECIP_BATCH], Zi[RECIP_BATCH];
+	size_t i, m;
+
+	for (; 0 < n; n -= m, in += m) {
+		m = n < RECIP_BATCH ? n : RECIP_BATCH;
+
+		for (i = 0; i < m; i++)
+			unpack(Z[i], in[i].Z);
+		recip_batch(Zi, Z, m);
+
+		for (i = 0; i < m; i++)
+			store_xy_ed25519(x ? x + i : NULL, y ? y + i : NULL, in + i, Zi[i]);
+
+		if (x)
+			x += m;
+		if (y)
+			y += m;
 	}
 }
 
 void ecc_25519_store_xy_legacy(ecc_int256_t *x, ecc_int256_t *y, const ecc_25519_work_t *in) {
-	uint32_t X[32], tmp[32], Y[32], Z[32];
+	uint32_t out[32];
+	fe X, Y, Z, L, tmp;
 	int i;
 
-	recip(Z, in->Z);
+	unpack(tmp, in->Z);
+	recip(Z, tmp);
 
 	if (x) {
-		mult(tmp, Z, in->X);
-		mult(X, tmp, ed25519_to_legacy);
-		freeze(X);
+		unpack(X, in->X);
+		mult(tmp, Z, X);
+		unpack(L, ed25519_to_legacy);
+		mult(X, tmp, L);
+		freeze(out, X);
 		for (i = 0; i < 32; i++)
-			x->p[i] = X[i];
+			x->p[i] = out[i];
 	}
 
 	if (y) {
-		mult(Y, Z, in->Y);
-		freeze(Y);
+		unpack(tmp, in->Y);
+		mult(Y, Z, tmp);
+		freeze(out, Y);
 		for (i = 0; i < 32; i++)
-			y->p[i] = Y[i];
+			y->p[i] = out[i];
 	}
 }
 
@@ -672,19 +627,16 @@ void ecc_25519_store_xy(ecc_int256_t *x, ecc_int256_t *y, const ecc_25519_work_t
 
 
 int ecc_25519_load_packed_ed25519(ecc_25519_work_t *out, const ecc_int256_t *in) {
-	int i;
-	uint32_t Y2[32] /* Y^2 */, dY2[32] /* dY^2 */, Y2_1[32] /* Y^2-1 */, dY2_1[32] /* dY^2+1 */, _1_dY2_1[32] /* 1/(dY^2+1) */;
-	uint32_t X2[32] /* X^2 */, X[32], Xt[32];
-
-	for (i = 0; i < 32; i++) {
-		out->Y[i] = in->p[i];
-		out->Z[i] = (i == 0);
-	}
+	point_t P;
+	fe Y2 /* Y^2 */, dY2 /* dY^2 */, Y2_1 /* Y^2-1 */, dY2_1 /* dY^2+1 */, _1_dY2_1 /* 1/(dY^2+1) */;
+	fe X2 /* X^2 */, X, Xt, D;
 
-	out->Y[31] &= 0x7f;
+	unpack_bytes(P.Y, in->p, 0x7f);
+	copy(P.Z, one);
 
-	square(Y2, out->Y);
-	mult(dY2, d, Y2);
+	square(Y2, P.Y);
+	unpack(D, d);
+	mult(dY2, D, Y2);
 	sub(Y2_1, Y2, one);
 	add(dY2_1, dY2, one);
 	recip(_1_dY2_1, dY2_1);
@@ -696,24 +648,22 @@ int ecc_25519_load_packed_ed25519(ecc_25519_work_t *out, const ecc_int256_t *in)
 	/* No squeeze is necessary after subtractions from zero if the subtrahend is squeezed */
 	sub(Xt, zero, X);
 
-	select(out->X, X, Xt, (in->p[31] >> 7) ^ parity(X));
+	select(P.X, X, Xt, (in->p[31] >> 7) ^ parity(X));
 
-	mult(out->T, out->X, out->Y);
+	mult(P.T, P.X, P.Y);
+
+	point_pack(out, &P);
 
 	return 1;
 }
 
 int ecc_25519_load_packed_legacy(ecc_25519_work_t *out, const ecc_int256_t *in) {
-	int i;
-	uint32_t X2[32] /* X^2 */, aX2[32] /* aX^2 */, dX2[32] /* dX^2 */, _1_aX2[32] /* 1-aX^2 */, _1_dX2[32] /* 1-aX^2 */;
-	uint32_t _1_1_dX2[32]  /* 1/(1-aX^2) */, Y2[32] /* Y^2 */, Y[32], Yt[32], X_legacy[32];
-
-	for (i = 0; i < 32; i++) {
-		X_legacy[i] = in->p[i];
-		out->Z[i] = (i == 0);
-	}
+	point_t P;
+	fe X2 /* X^2 */, aX2 /* aX^2 */, dX2 /* dX^2 */, _1_aX2 /* 1-aX^2 */, _1_dX2 /* 1-aX^2 */;
+	fe _1_1_dX2  /* 1/(1-aX^2) */, Y2 /* Y^2 */, Y, Yt, X_legacy, L;
 
-	X_legacy[31] &= 0x7f;
+	unpack_bytes(X_legacy, in->p, 0x7f);
+	copy(P.Z, one);
 
 	square(X2, X_legacy);
 	mult_int(aX2, UINT32_C(486664), X2);
@@ -729,10 +679,13 @@ int ecc_25519_load_packed_legacy(ecc_25519_work_t *out, const ecc_int256_t *in)
 	/* No squeeze is necessary after subtractions from zero if the subtrahend is squeezed */
 	sub(Yt, zero, Y);
 
-	select(out->Y, Y, Yt, (in->p[31] >> 7) ^ parity(Y));
+	select(P.Y, Y, Yt, (in->p[31] >> 7) ^ parity(Y));
+
+	unpack(L, legacy_to_ed25519);
+	mult(P.X, X_legacy, L);
+	mult(P.T, P.X, P.Y);
 
-	mult(out->X, X_legacy, legacy_to_ed25519);
-	mult(out->T, out->X, out->Y);
+	point_pack(out, &P);
 
 	return 1;
 }
@@ -762,29 +715,30 @@ void ecc_25519_store_packed(ecc_int256_t *out, const ecc_25519_work_t *in) {
 
 
 int ecc_25519_is_identity(const ecc_25519_work_t *in) {
-	uint32_t Y_Z[32];
+	point_t P;
+	fe Y_Z;
 
-	sub(Y_Z, in->Y, in->Z);
+	point_unpack(&P, in);
+
+	sub(Y_Z, P.Y, P.Z);
 	squeeze(Y_Z);
 
-	return (check_zero(in->X)&check_zero(Y_Z));
+	return (check_zero(P.X)&check_zero(Y_Z));
 }
 
-void ecc_25519_negate(ecc_25519_work_t *out, const ecc_25519_work_t *in) {
-	int i;
-
-	for (i = 0; i < 32; i++) {
-		out->Y[i] = in->Y[i];
-		out->Z[i] = in->Z[i];
-	}
+/** Negates a point of the Elliptic Curve */
+static void point_negate(point_t *out, const point_t *in) {
+	copy(out->Y, in->Y);
+	copy(out->Z, in->Z);
 
 	/* No squeeze is necessary after subtractions from zero if the subtrahend is squeezed */
 	sub(out->X, zero, in->X);
 	sub(out->T, zero, in->T);
 }
 
-void ecc_25519_double(ecc_25519_work_t *out, const ecc_25519_work_t *in) {
-	uint32_t A[32], B[32], C[32], D[32], E[32], F[32], G[32], H[32], t0[32], t1[32];
+/** Doubles a point of the Elliptic Curve */
+static void point_double(point_t *out, const point_t *in) {
+	fe A, B, C, D, E, F, G, H, t0, t1;
 
 	square(A, in->X);
 
@@ -810,10 +764,11 @@ void ecc_25519_double(ecc_25519_work_t *out, const ecc_25519_work_t *in) {
 	mult(out->Z, F, G);
 }
 
-void ecc_25519_add(ecc_25519_work_t *out, const ecc_25519_work_t *in1, const ecc_25519_work_t *in2) {
+/** Adds two points of the Elliptic Curve */
+static void point_add(point_t *out, const point_t *in1, const point_t *in2) {
 	const uint32_t j = UINT32_C(60833);
 	const uint32_t k = UINT32_C(121665);
-	uint32_t A[32], B[32], C[32], D[32], E[32], F[32], G[32], H[32], t0[32], t1[32];
+	fe A, B, C, D, E, F, G, H, t0, t1;
 
 	sub(t0, in1->Y, in1->X);
 	mult_int(t1, j, t0);
@@ -842,11 +797,38 @@ void ecc_25519_add(ecc_25519_work_t *out, const ecc_25519_work_t *in1, const ecc
 	mult(out->Z, F, G);
 }
 
+void ecc_25519_negate(ecc_25519_work_t *out, const ecc_25519_work_t *in) {
+	point_t P;
+
+	point_unpack(&P, in);
+	point_negate(&P, &P);
+	point_pack(out, &P);
+}
+
+void ecc_25519_double(ecc_25519_work_t *out, const ecc_25519_work_t *in) {
+	point_t P;
+
+	point_unpack(&P, in);
+	point_double(&P, &P);
+	point_pack(out, &P);
+}
+
+void ecc_25519_add(ecc_25519_work_t *out, const ecc_25519_work_t *in1, const ecc_25519_work_t *in2) {
+	point_t P1, P2;
+
+	point_unpack(&P1, in1);
+	point_unpack(&P2, in2);
+	point_add(&P1, &P1, &P2);
+	point_pack(out, &P1);
+}
+
+#ifdef UECC_NO_BASE_TABLE
+
 /** Adds two points of the Elliptic Curve, assuming that in2->Z == 1 */
-static void ecc_25519_add1(ecc_25519_work_t *out, const ecc_25519_work_t *in1, const ecc_25519_work_t *in2) {
+static void point_add1(point_t *out, const point_t *in1, const point_t *in2) {
 	const uint32_t j = UINT32_C(60833);
 	const uint32_t k = UINT32_C(121665);
-	uint32_t A[32], B[32], C[32], D[32], E[32], F[32], G[32], H[32], t0[32], t1[32];
+	fe A, B, C, D, E, F, G, H, t0, t1;
 
 	sub(t0, in1->Y, in1->X);
 	mult_int(t1, j, t0);
@@ -874,58 +856,316 @@ static void ecc_25519_add1(ecc_25519_work_t *out, const ecc_25519_work_t *in1, c
 	mult(out->Z, F, G);
 }
 
+#endif /* UECC_NO_BASE_TABLE */
+
 void ecc_25519_sub(ecc_25519_work_t *out, const ecc_25519_work_t *in1, const ecc_25519_work_t *in2) {
-	ecc_25519_work_t in2_neg;
+	point_t P1, P2;
 
-	ecc_25519_negate(&in2_neg, in2);
-	ecc_25519_add(out, in1, &in2_neg);
+	point_unpack(&P1, in1);
+	point_unpack(&P2, in2);
+	point_negate(&P2, &P2);
+	point_add(&P1, &P1, &P2);
+	point_pack(out, &P1);
 }
 
 void ecc_25519_scalarmult_bits(ecc_25519_work_t *out, const ecc_int256_t *n, const ecc_25519_work_t *base, unsigned bits) {
-	ecc_25519_work_t Q2, Q2p;
-	ecc_25519_work_t cur = ecc_25519_work_identity;
+	point_t Q2, Q2p, B, cur;
 	int b, pos;
 
 	if (bits > 256)
 		bits = 256;
 
+	point_unpack(&B, base);
+	point_unpack(&cur, &ecc_25519_work_identity);
+
 	for (pos = bits - 1; pos >= 0; --pos) {
 		b = n->p[pos / 8] >> (pos & 7);
 		b &= 1;
 
-		ecc_25519_double(&Q2, &cur);
-		ecc_25519_add(&Q2p, &Q2, base);
+		point_double(&Q2, &cur);
+		point_add(&Q2p, &Q2, &B);
 		selectw(&cur, &Q2, &Q2p, b);
 	}
 
-	*out = cur;
+	point_pack(out, &cur);
 }
 
 void ecc_25519_scalarmult(ecc_25519_work_t *out, const ecc_int256_t *n, const ecc_25519_work_t *base) {
 	ecc_25519_scalarmult_bits(out, n, base, 256);
 }
 
+/*
+ * Window tables: tab[w][i-1] holds \f$ i \cdot 16^w \cdot P \f$
+ * for the 64 windows \f$ w \f$ and \f$ i = 1..15 \f$ as affine points,
+ * pre-multiplied for \ref point_add_table as
+ * \f$ (j(Y+X), j(Y-X), kT) \f$, each value as 32 bytes little endian.
+ * A scalar multiplication with such a table needs one addition per 4 bit
+ * window and no doubling. The table of the default base point is
+ * generated by ec25519_gentab.c, tables of other points are built at
+ * run time by \ref ecc_25519_table_init.
+ */
+
+/** Stores an unpacked integer as 32 bytes (fully reduced) */
+static void pack_bytes(uint8_t out[32], const fe a) {
+	uint32_t tmp[32];
+	int i;
+
+	freeze(tmp, a);
+	for (i = 0; i < 32; i++)
+		out[i] = tmp[i];
+}
+
+/** Selects entry b of a table window in constant time (b == 0 is the identity) */
+static void table_select(fe ypx, fe ymx, fe kt, const uint8_t (*tab)[96], uint32_t b) {
+	uint8_t e[96] = {0xa1, 0xed}; /* identity: j(1+0), j(1-0), k0 */
+	unsigned int i, j;
+	uint32_t mask;
+
+	e[32] = 0xa1;
+	e[33] = 0xed;
+
+	for (i = 1; i < 16; i++) {
+		mask = ((b ^ i) - 1) >> 8; /* all ones iff b == i (b, i < 256) */
+		mask &= 0xff;
+		for (j = 0; j < 96; j++)
+			e[j] ^= mask & (e[j] ^ tab[i - 1][j]);
+	}
+
+	unpack_bytes(ypx, e, 0xff);
+	unpack_bytes(ymx, e + 32, 0xff);
+	unpack_bytes(kt, e + 64, 0xff);
+}
+
+/** Adds a point from a window table (see \ref table_select) */
+static void point_add_table(point_t *out, const point_t *in1, const fe ypx, const fe ymx, const fe kt) {
+	const uint32_t j = UINT32_C(60833);
+	fe A, B, C, D, E, F, G, H, t0;
+
+	sub(t0, in1->Y, in1->X);
+	mult(A, t0, ymx);
+
+	add(t0, in1->Y, in1->X);
+	mult(B, t0, ypx);
+
+	mult(C, in1->T, kt);
+
+	mult_int(D, 2*j, in1->Z);
+
+	sub(E, B, A);
+	add(F, D, C);
+	sub(G, D, C);
+	add(H, B, A);
+
+	mult(out->X, E, F);
+	mult(out->Y, G, H);
+	mult(out->T, E, H);
+	mult(out->Z, F, G);
+}
+
+/** Stores the 15 points of a table window as affine (j(Y+X), j(Y-X), kT) sharing one inversion */
+static void table_window(uint8_t out[15][96], const point_t P[15]) {
+	const uint32_t j = UINT32_C(60833);
+	const uint32_t k = UINT32_C(121665);
+	fe Z[15], Zi[15];
+	fe X, Y, T, t0, t1;
+	unsigned int i;
+
+	for (i = 0; i < 15; i++)
+		copy(Z[i], P[i].Z);
+	recip_batch(Zi, Z, 15);
+
+	for (i = 0; i < 15; i++) {
+		mult(X, P[i].X, Zi[i]);
+		mult(Y, P[i].Y, Zi[i]);
+		mult(T, X, Y);
+
+		add(t0, Y, X);
+		mult_int(t1, j, t0);
+		pack_bytes(out[i], t1);
+
+		sub(t0, Y, X);
+		mult_int(t1, j, t0);
+		pack_bytes(out[i] + 32, t1);
+
+		mult_int(t1, k, T);
+		pack_bytes(out[i] + 64, t1);
+	}
+}
+
+void ecc_25519_table_init(ecc_25519_table_t *out, const ecc_25519_work_t *base) {
+	point_t P[15];
+	unsigned int w, i;
+
+	point_unpack(&P[0], base);
+
+	for (w = 0; w < 64; w++) {
+		/* P[i] = (i+1) 16^w base */
+		for (i = 1; i < 15; i++)
+			point_add(&P[i], &P[i - 1], &P[0]);
+		table_window(out->p[w], P);
+
+		/* 16^(w+1) base */
+		point_add(&P[0], &P[14], &P[0]);
+	}
+}
+
+/** Does a scalar multiplication with a window table */
+static void scalarmult_table(ecc_25519_work_t *out, const ecc_int256_t *n, const uint8_t (*tab)[15][96], unsigned bits) {
+	point_t cur;
+	fe ypx, ymx, kt;
+	uint8_t s[32];
+	unsigned int i, w;
+
+	if (bits > 256)
+		bits = 256;
+
+	/* only the lower bits of the scalar are used */
+	for (i = 0; i < 32; i++) {
+		if (8*i + 8 <= bits)
+			s[i] = n->p[i];
+		else if (8*i < bits)
+			s[i] = n->p[i] & ((1 << (bits - 8*i)) - 1);
+		else
+			s[i] = 0;
+	}
+
+	point_unpack(&cur, &ecc_25519_work_identity);
+
+	/* one table lookup and addition per 4 bit window, no doubling */
+	for (w = 0; w < 64; w++) {
+		table_select(ypx, ymx, kt, tab[w], (s[w / 2] >> (4 * (w & 1))) & 15);
+		point_add_table(&cur, &cur, ypx, ymx, kt);
+	}
+
+	point_pack(out, &cur);
+}
+
+void ecc_25519_scalarmult_table_bits(ecc_25519_work_t *out, const ecc_int256_t *n, const ecc_25519_table_t *table, unsigned bits) {
+	scalarmult_table(out, n, table->p, bits);
+}
+
+void ecc_25519_scalarmult_table(ecc_25519_work_t *out, const ecc_int256_t *n, const ecc_25519_table_t *table) {
+	scalarmult_table(out, n, table->p, 256);
+}
+
+#ifndef UECC_NO_BASE_TABLE
+
+/** Window table of the default base point, generated by ec25519_gentab.c */
+#include "ec25519_base.h"
+
+void ecc_25519_scalarmult_base_bits(ecc_25519_work_t *out, const ecc_int256_t *n, unsigned bits) {
+	scalarmult_table(out, n, base_table, bits);
+}
+
+#else /* UECC_NO_BASE_TABLE */
+
 void ecc_25519_scalarmult_base_bits(ecc_25519_work_t *out, const ecc_int256_t *n, unsigned bits) {
-	ecc_25519_work_t Q2, Q2p;
-	ecc_25519_work_t cur = ecc_25519_work_identity;
+	point_t Q2, Q2p, B, cur;
 	int b, pos;
 
 	if (bits > 256)
 		bits = 256;
 
+	point_unpack(&B, &ecc_25519_work_default_base);
+	point_unpack(&cur, &ecc_25519_work_identity);
+
 	for (pos = bits - 1; pos >= 0; --pos) {
 		b = n->p[pos / 8] >> (pos & 7);
 		b &= 1;
 
-		ecc_25519_double(&Q2, &cur);
-		ecc_25519_add1(&Q2p, &Q2, &ecc_25519_work_default_base);
+		point_double(&Q2, &cur);
+		point_add1(&Q2p, &Q2, &B);
 		selectw(&cur, &Q2, &Q2p, b);
 	}
 
-	*out = cur;
+	point_pack(out, &cur);
 }
 
+#endif /* UECC_NO_BASE_TABLE */
+
 void ecc_25519_scalarmult_base(ecc_25519_work_t *out, const ecc_int256_t *n) {
 	ecc_25519_scalarmult_base_bits(out, n, 256);
 }
 
+void ecc_25519_store_x25519(ecc_int256_t *out, const ecc_25519_work_t *in) {
+	fe Y, Z, t0, t1, t2, u;
+
+	/* u = (1 + y)/(1 - y) = (Z + Y)/(Z - Y) */
+	unpack(Y, in->Y);
+	unpack(Z, in->Z);
+	add(t0, Z, Y);
+	sub(t1, Z, Y);
+	recip(t2, t1);
+	mult(u, t0, t2);
+
+	pack_bytes(out->p, u);
+}
+
+/** Swaps a and b when b == 1, leaves them alone when b == 0 */
+static void cswap(fe a, fe b, uint32_t swap) {
+	fe t;
+
+	select(t, a, b, swap);
+	select(b, b, a, swap);
+	copy(a, t);
+}
+
+int ecc_25519_x25519_ed25519(ecc_int256_t *out, const ecc_int256_t *n, const ecc_int256_t *in) {
+	const uint32_t a24 = UINT32_C(121665);
+	fe x1, x2, z2, x3, z3;
+	fe A, AA, B, BB, C, D, E, DA, CB, t0, t1;
+	uint32_t bit, swap = 0, nz = 0;
+	int pos, i;
+
+	/* u = (1 + y)/(1 - y), the sign of x does not matter */
+	unpack_bytes(t0, in->p, 0x7f);
+	add(t1, one, t0);
+	sub(A, one, t0);
+	recip(B, A);
+	mult(x1, t1, B);
+
+	copy(x2, one);
+	copy(z2, zero);
+	copy(x3, x1);
+	copy(z3, one);
+
+	for (pos = 255; pos >= 0; --pos) {
+		bit = (n->p[pos / 8] >> (pos & 7)) & 1;
+		swap ^= bit;
+		cswap(x2, x3, swap);
+		cswap(z2, z3, swap);
+		swap = bit;
+
+		add(A, x2, z2);
+		square(AA, A);
+		sub(B, x2, z2);
+		square(BB, B);
+		sub(E, AA, BB);
+		add(C, x3, z3);
+		sub(D, x3, z3);
+		mult(DA, D, A);
+		mult(CB, C, B);
+
+		add(t0, DA, CB);
+		square(x3, t0);
+		sub(t0, DA, CB);
+		square(t1, t0);
+		mult(z3, x1, t1);
+
+		mult(x2, AA, BB);
+		mult_int(t0, a24, E);
+		add(t1, AA, t0);
+		mult(z2, E, t1);
+	}
+	cswap(x2, x3, swap);
+	cswap(z2, z3, swap);
+
+	recip(t0, z2);
+	mult(t1, x2, t0);
+	pack_bytes(out->p, t1);
+
+	for (i = 0; i < 32; i++)
+		nz |= out->p[i];
+
+	return (nz + 255) >> 8;
+}
@@ -0,0 +1,242 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Field arithmetic backend with 10 limbs of alternating 26 and 25 bits
+ * (radix 2^25.5, UECC_FIELD == 25), included by ec25519.c. Only needs
+ * 32x32->64 bit multiplications.
+ *
+ * An unpacked integer a represents a[0] + a[1] 2^26 + a[2] 2^51 + ...
+ * + a[9] 2^230, limb i being 26 bits wide for even and 25 bits wide for
+ * odd i. After a \ref squeeze (and thus after every arithmetic operation
+ * below) all limbs are within their width, except a[1] which may exceed
+ * it by a small carry.
+ */
+
+/** Unpacked integer */
+typedef uint32_t fe[10];
+typedef uint32_t fe_limb;
+
+#define FE_LIMBS 10
+
+#define WIDTH(i) (26 - ((i) & 1))
+#define MASK(i)  ((UINT32_C(1) << WIDTH(i)) - 1)
+
+/** Performs carry and reduce on an unpacked integer, limbs must be below 2^31 */
+static void squeeze(fe a) {
+	unsigned int i;
+
+	for (i = 0; i < 9; i++) {
+		a[i + 1] += a[i] >> WIDTH(i);
+		a[i] &= MASK(i);
+	}
+
+	a[0] += 19 * (a[9] >> 25);
+	a[9] &= MASK(9);
+
+	a[1] += a[0] >> 26;
+	a[0] &= MASK(0);
+}
+
+/** Carries the 64 bit limb products into out */
+static void squeeze_wide(fe out, uint64_t t[10]) {
+	unsigned int i;
+
+	for (i = 0; i < 9; i++) {
+		t[i + 1] += t[i] >> WIDTH(i);
+		out[i] = t[i] & MASK(i);
+	}
+
+	t[0] = out[0] + 19 * (t[9] >> 25);
+	out[9] = t[9] & MASK(9);
+
+	out[1] += t[0] >> 26;
+	out[0] = t[0] & MASK(0);
+}
+
+/** Adds two unpacked integers (modulo p) */
+static void add(fe out, const fe a, const fe b) {
+	unsigned int i;
+
+	for (i = 0; i < 10; i++)
+		out[i] = a[i] + b[i];
+	squeeze(out);
+}
+
+/** Subtracts two unpacked integers (modulo p), computed as a + 4p - b */
+static void sub(fe out, const fe a, const fe b) {
+	static const uint32_t fourp[10] = {
+		0xfffffb4, 0x7fffffc, 0xffffffc, 0x7fffffc, 0xffffffc,
+		0x7fffffc, 0xffffffc, 0x7fffffc, 0xffffffc, 0x7fffffc
+	};
+	unsigned int i;
+
+	for (i = 0; i < 10; i++)
+		out[i] = a[i] + fourp[i] - b[i];
+	squeeze(out);
+}
+
+/**
+ * Multiplies two unpacked integers (modulo p)
+ *
+ * The product of limbs i and j goes to limb i + j. It is doubled if both
+ * i and j are odd (the half bits of the radix) and multiplied with 19 if
+ * it wraps around at 2^255.
+ */
+static void mult(fe out, const fe a, const fe b) {
+	uint32_t b2[10], b19[10], b38[10];
+	uint64_t t[10] = {0};
+	unsigned int i, j;
+
+	for (i = 0; i < 10; i++) {
+		b2[i] = 2 * b[i];
+		b19[i] = 19 * b[i];
+		b38[i] = 38 * b[i];
+	}
+
+	for (i = 0; i < 10; i += 2) {
+		for (j = 0; j < 10 - i; j++)
+			t[i + j] += (uint64_t)a[i] * b[j];
+		for (j = 10 - i; j < 10; j++)
+			t[i + j - 10] += (uint64_t)a[i] * b19[j];
+	}
+
+	for (i = 1; i < 10; i += 2) {
+		for (j = 0; j < 10 - i; j++)
+			t[i + j] += (uint64_t)a[i] * ((j & 1) ? b2[j] : b[j]);
+		for (j = 10 - i; j < 10; j++)
+			t[i + j - 10] += (uint64_t)a[i] * ((j & 1) ? b38[j] : b19[j]);
+	}
+
+	squeeze_wide(out, t);
+}
+
+/** Squares an unpacked integer */
+static void square(fe out, const fe a) {
+	uint32_t a2[10];
+	uint64_t t[10] = {0};
+	uint64_t u;
+	unsigned int i, j;
+
+	for (i = 0; i < 10; i++)
+		a2[i] = 2 * a[i];
+
+	for (i = 0; i < 10; i++) {
+		/* a[i]^2, doubled for odd i */
+		u = (uint64_t)a[i] * ((i & 1) ? a2[i] : a[i]);
+		if (2 * i < 10)
+			t[2 * i] += u;
+		else
+			t[2 * i - 10] += 19 * u;
+
+		/* 2 a[i] a[j] for j > i, doubled again if both are odd */
+		for (j = i + 1; j < 10; j++) {
+			u = (uint64_t)a2[i] * ((i & j & 1) ? a2[j] : a[j]);
+			if (i + j < 10)
+				t[i + j] += u;
+			else
+				t[i + j - 10] += 19 * u;
+		}
+	}
+
+	squeeze_wide(out, t);
+}
+
+/** Multiplies an unpacked integer with a small integer (modulo p) */
+static void mult_int(fe out, uint32_t n, const fe a) {
+	uint64_t t[10];
+	unsigned int i;
+
+	for (i = 0; i < 10; i++)
+		t[i] = (uint64_t)n * a[i];
+
+	squeeze_wide(out, t);
+}
+
+/** Unpacks 32 integer parts of 8 bits (or more, if \em squeezed) */
+static void unpack(fe out, const uint32_t in[32]) {
+	uint64_t acc = 0;
+	unsigned int i, j = 0, bits = 0;
+
+	for (i = 0; i < 9; i++) {
+		while (bits < WIDTH(i)) {
+			acc += (uint64_t)in[j++] << bits;
+			bits += 8;
+		}
+		out[i] = acc & MASK(i);
+		acc >>= WIDTH(i);
+		bits -= WIDTH(i);
+	}
+
+	/* the last limb takes all remaining bits, reduced above 2^255 */
+	while (j < 32) {
+		acc += (uint64_t)in[j++] << bits;
+		bits += 8;
+	}
+	out[9] = acc & MASK(9);
+	out[0] += 19 * (acc >> 25);
+
+	squeeze(out);
+}
+
+/** Stores the fully reduced value of an unpacked integer as 32 bytes in out */
+static void freeze(uint32_t out[32], const fe a) {
+	fe t;
+	uint32_t q;
+	uint64_t acc = 0;
+	unsigned int i, j = 0, bits = 0;
+
+	for (i = 0; i < 10; i++)
+		t[i] = a[i];
+	squeeze(t);
+
+	/* q = 1 if t >= p, i.e. t + 19 >= 2^255 */
+	q = 19;
+	for (i = 0; i < 10; i++)
+		q = (t[i] + q) >> WIDTH(i);
+
+	/* t - q p = t + 19 q - q 2^255 */
+	t[0] += 19 * q;
+	for (i = 0; i < 9; i++) {
+		t[i + 1] += t[i] >> WIDTH(i);
+		t[i] &= MASK(i);
+	}
+	t[9] &= MASK(9);
+
+	for (i = 0; i < 10; i++) {
+		acc |= (uint64_t)t[i] << bits;
+		bits += WIDTH(i);
+		while (bits >= 8 && j < 32) {
+			out[j++] = acc & 255;
+			acc >>= 8;
+			bits -= 8;
+		}
+	}
+	out[31] = acc;
+}
+
+/** Packs an unpacked integer into 32 integer parts of 8 bits, the result is fully reduced */
+static void pack(uint32_t out[32], const fe a) {
+	freeze(out, a);
+}
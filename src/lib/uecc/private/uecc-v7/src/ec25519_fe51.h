@@ -0,0 +1,189 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Field arithmetic backend with 5 limbs of 51 bits (UECC_FIELD == 51),
+ * included by ec25519.c. Products are accumulated in unsigned __int128.
+ *
+ * An unpacked integer a represents a[0] + a[1] 2^51 + ... + a[4] 2^204.
+ * After a \ref squeeze (and thus after every arithmetic operation below)
+ * all limbs are below 2^51, except a[1] which may exceed it by a small
+ * carry. These bounds are what the products and \ref sub rely on.
+ */
+
+/** Unpacked integer */
+typedef uint64_t fe[5];
+typedef uint64_t fe_limb;
+
+#define FE_LIMBS 5
+
+typedef unsigned __int128 fe_wide;
+
+#define MASK51 ((UINT64_C(1) << 51) - 1)
+
+/** Performs carry and reduce on an unpacked integer, limbs must be below 2^63 */
+static void squeeze(fe a) {
+	uint64_t c;
+
+	c = a[0] >> 51; a[0] &= MASK51; a[1] += c;
+	c = a[1] >> 51; a[1] &= MASK51; a[2] += c;
+	c = a[2] >> 51; a[2] &= MASK51; a[3] += c;
+	c = a[3] >> 51; a[3] &= MASK51; a[4] += c;
+	c = a[4] >> 51; a[4] &= MASK51; a[0] += 19 * c;
+	c = a[0] >> 51; a[0] &= MASK51; a[1] += c;
+}
+
+/** Carries the 128 bit limb products into out */
+static void squeeze_wide(fe out, fe_wide t0, fe_wide t1, fe_wide t2, fe_wide t3, fe_wide t4) {
+	uint64_t c;
+
+	t1 += (uint64_t)(t0 >> 51); out[0] = (uint64_t)t0 & MASK51;
+	t2 += (uint64_t)(t1 >> 51); out[1] = (uint64_t)t1 & MASK51;
+	t3 += (uint64_t)(t2 >> 51); out[2] = (uint64_t)t2 & MASK51;
+	t4 += (uint64_t)(t3 >> 51); out[3] = (uint64_t)t3 & MASK51;
+	c = (uint64_t)(t4 >> 51);   out[4] = (uint64_t)t4 & MASK51;
+
+	out[0] += 19 * c;
+	c = out[0] >> 51; out[0] &= MASK51; out[1] += c;
+}
+
+/** Adds two unpacked integers (modulo p) */
+static void add(fe out, const fe a, const fe b) {
+	out[0] = a[0] + b[0];
+	out[1] = a[1] + b[1];
+	out[2] = a[2] + b[2];
+	out[3] = a[3] + b[3];
+	out[4] = a[4] + b[4];
+	squeeze(out);
+}
+
+/** Subtracts two unpacked integers (modulo p), computed as a + 4p - b */
+static void sub(fe out, const fe a, const fe b) {
+	out[0] = a[0] + UINT64_C(0x1fffffffffffb4) - b[0];
+	out[1] = a[1] + UINT64_C(0x1ffffffffffffc) - b[1];
+	out[2] = a[2] + UINT64_C(0x1ffffffffffffc) - b[2];
+	out[3] = a[3] + UINT64_C(0x1ffffffffffffc) - b[3];
+	out[4] = a[4] + UINT64_C(0x1ffffffffffffc) - b[4];
+	squeeze(out);
+}
+
+/** Multiplies two unpacked integers (modulo p) */
+static void mult(fe out, const fe a, const fe b) {
+	uint64_t b1_19 = 19 * b[1], b2_19 = 19 * b[2], b3_19 = 19 * b[3], b4_19 = 19 * b[4];
+	fe_wide t0, t1, t2, t3, t4;
+
+	t0 = (fe_wide)a[0] * b[0] + (fe_wide)a[1] * b4_19 + (fe_wide)a[2] * b3_19 + (fe_wide)a[3] * b2_19 + (fe_wide)a[4] * b1_19;
+	t1 = (fe_wide)a[0] * b[1] + (fe_wide)a[1] * b[0]  + (fe_wide)a[2] * b4_19 + (fe_wide)a[3] * b3_19 + (fe_wide)a[4] * b2_19;
+	t2 = (fe_wide)a[0] * b[2] + (fe_wide)a[1] * b[1]  + (fe_wide)a[2] * b[0]  + (fe_wide)a[3] * b4_19 + (fe_wide)a[4] * b3_19;
+	t3 = (fe_wide)a[0] * b[3] + (fe_wide)a[1] * b[2]  + (fe_wide)a[2] * b[1]  + (fe_wide)a[3] * b[0]  + (fe_wide)a[4] * b4_19;
+	t4 = (fe_wide)a[0] * b[4] + (fe_wide)a[1] * b[3]  + (fe_wide)a[2] * b[2]  + (fe_wide)a[3] * b[1]  + (fe_wide)a[4] * b[0];
+
+	squeeze_wide(out, t0, t1, t2, t3, t4);
+}
+
+/** Squares an unpacked integer */
+static void square(fe out, const fe a) {
+	uint64_t a0_2 = 2 * a[0], a1_2 = 2 * a[1], a2_38 = 38 * a[2], a3_19 = 19 * a[3], a4_19 = 19 * a[4], a4_38 = 38 * a[4];
+	fe_wide t0, t1, t2, t3, t4;
+
+	t0 = (fe_wide)a[0] * a[0] + (fe_wide)a[1] * a4_38 + (fe_wide)a[3] * a2_38;
+	t1 = (fe_wide)a[1] * a0_2 + (fe_wide)a[2] * a4_38 + (fe_wide)a[3] * a3_19;
+	t2 = (fe_wide)a[2] * a0_2 + (fe_wide)a[1] * a[1]  + (fe_wide)a[3] * a4_38;
+	t3 = (fe_wide)a[3] * a0_2 + (fe_wide)a[2] * a1_2  + (fe_wide)a[4] * a4_19;
+	t4 = (fe_wide)a[4] * a0_2 + (fe_wide)a[3] * a1_2  + (fe_wide)a[2] * a[2];
+
+	squeeze_wide(out, t0, t1, t2, t3, t4);
+}
+
+/** Multiplies an unpacked integer with a small integer (modulo p) */
+static void mult_int(fe out, uint32_t n, const fe a) {
+	squeeze_wide(out, (fe_wide)n * a[0], (fe_wide)n * a[1], (fe_wide)n * a[2], (fe_wide)n * a[3], (fe_wide)n * a[4]);
+}
+
+/** Unpacks 32 integer parts of 8 bits (or more, if \em squeezed) */
+static void unpack(fe out, const uint32_t in[32]) {
+	uint64_t acc = 0;
+	unsigned int i, j = 0, bits = 0;
+
+	for (i = 0; i < 4; i++) {
+		while (bits < 51) {
+			acc += (uint64_t)in[j++] << bits;
+			bits += 8;
+		}
+		out[i] = acc & MASK51;
+		acc >>= 51;
+		bits -= 51;
+	}
+
+	/* the last limb takes all remaining bits */
+	while (j < 32) {
+		acc += (uint64_t)in[j++] << bits;
+		bits += 8;
+	}
+	out[4] = acc;
+
+	squeeze(out);
+}
+
+/** Stores the fully reduced value of an unpacked integer as 32 bytes in out */
+static void freeze(uint32_t out[32], const fe a) {
+	fe t;
+	uint64_t q, acc = 0;
+	unsigned int i, j = 0, bits = 0;
+
+	for (i = 0; i < 5; i++)
+		t[i] = a[i];
+	squeeze(t);
+
+	/* q = 1 if t >= p, i.e. t + 19 >= 2^255 */
+	q = (t[0] + 19) >> 51;
+	q = (t[1] + q) >> 51;
+	q = (t[2] + q) >> 51;
+	q = (t[3] + q) >> 51;
+	q = (t[4] + q) >> 51;
+
+	/* t - q p = t + 19 q - q 2^255 */
+	t[0] += 19 * q;
+	t[1] += t[0] >> 51; t[0] &= MASK51;
+	t[2] += t[1] >> 51; t[1] &= MASK51;
+	t[3] += t[2] >> 51; t[2] &= MASK51;
+	t[4] += t[3] >> 51; t[3] &= MASK51;
+	t[4] &= MASK51;
+
+	for (i = 0; i < 5; i++) {
+		acc |= t[i] << bits;
+		bits += 51;
+		while (bits >= 8 && j < 32) {
+			out[j++] = acc & 255;
+			acc >>= 8;
+			bits -= 8;
+		}
+	}
+	out[31] = acc;
+}
+
+/** Packs an unpacked integer into 32 integer parts of 8 bits, the result is fully reduced */
+static void pack(uint32_t out[32], const fe a) {
+	freeze(out, a);
+}
@@ -0,0 +1,238 @@
+/*
+  Copyright (c) 2012-2015, Matthias Schiffer <mschiffer@universe-factory.net>
+  Partly based on public domain code by Matthew Dempsky and D. J. Bernstein.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice,
+       this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** \file
+ * Field arithmetic backend with 32 limbs of 8 bits (UECC_FIELD == 8), the
+ * original libuecc representation. Included by ec25519.c.
+ *
+ * An unpacked integer is the same array of 32 integers as used by
+ * \ref ecc_25519_work_t, so \ref unpack and \ref pack are plain copies.
+ */
+
+/** Unpacked integer */
+typedef uint32_t fe[32];
+typedef uint32_t fe_limb;
+
+#define FE_LIMBS 32
+
+/** Adds two unpacked integers (modulo p) */
+static void add(uint32_t out[32], const uint32_t a[32], const uint32_t b[32]) {
+	unsigned int j;
+	uint32_t u;
+
+	u = 0;
+
+	for (j = 0; j < 31; j++) {
+		u += a[j] + b[j];
+		out[j] = u & 255;
+		u >>= 8;
+	}
+
+	u += a[31] + b[31];
+	out[31] = u;
+}
+
+/**
+ * Subtracts two unpacked integers (modulo p)
+ *
+ * b must be \em squeezed.
+ */
+static void sub(uint32_t out[32], const uint32_t a[32], const uint32_t b[32]) {
+	unsigned int j;
+	uint32_t u;
+
+	u = 218;
+
+	for (j = 0;j < 31;++j) {
+		u += a[j] + UINT32_C(65280) - b[j];
+		out[j] = u & 255;
+		u >>= 8;
+	}
+
+	u += a[31] - b[31];
+	out[31] = u;
+}
+
+/**
+ * Performs carry and reduce on an unpacked integer
+ *
+ * The result is not always fully reduced, but it will be significantly smaller than \f$ 2p \f$.
+ */
+static void squeeze(uint32_t a[32]) {
+	unsigned int j;
+	uint32_t u;
+
+	u = 0;
+
+	for (j = 0;j < 31;++j) {
+		u += a[j];
+		a[j] = u & 255;
+		u >>= 8;
+	}
+
+	u += a[31];
+	a[31] = u & 127;
+	u = 19 * (u >> 7);
+
+	for (j = 0;j < 31;++j) {
+		u += a[j];
+		a[j] = u & 255;
+		u >>= 8;
+	}
+
+	u += a[31];
+	a[31] = u;
+}
+
+
+static const uint32_t minusp[32] = {
+	19, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 128
+};
+
+/**
+ * Stores the fully reduced value of an unpacked integer as 32 bytes in out
+ *
+ * Only the lower byte of each integer part of out holds a value.
+ */
+static void freeze(uint32_t out[32], const uint32_t a[32]) {
+	uint32_t aorig[32];
+	unsigned int j;
+	uint32_t negative;
+
+	for (j = 0; j < 32; j++)
+		aorig[j] = a[j];
+	squeeze(aorig);
+	add(out, aorig, minusp);
+	negative = -((out[31] >> 7) & 1);
+
+	for (j = 0; j < 32; j++)
+		out[j] ^= negative & (aorig[j] ^ out[j]);
+	out[31] &= 255;
+}
+
+/* Field multiplication and squaring, bound at run time to the variant
+ * compiled for the best instruction set supported by the CPU (see the
+ * cpu/private/cpu_dispatch.h in the enclosing project.) */
+
+#define FE_ATTR
+#define FE_NAME(n) n ## _portable
+#include "ec25519_mult.h"
+#undef FE_ATTR
+#undef FE_NAME
+
+#if HAVE_CPU_DISPATCH && CPU_HAVE_X86
+#define FE_ATTR CPU_TARGET("avx2")
+#define FE_NAME(n) n ## _avx2
+#include "ec25519_mult.h"
+#undef FE_ATTR
+#undef FE_NAME
+#endif
+
+static void mult_resolve(uint32_t out[32], const uint32_t a[32], const uint32_t b[32]);
+static void square_resolve(uint32_t out[32], const uint32_t a[32]);
+
+static void (*mult)(uint32_t out[32], const uint32_t a[32], const uint32_t b[32]) = mult_resolve;
+static void (*square)(uint32_t out[32], const uint32_t a[32]) = square_resolve;
+
+static void fe_bind(void) {
+	mult = mult_portable;
+	square = square_portable;
+
+#if HAVE_CPU_DISPATCH && CPU_HAVE_X86
+	if (cpu_features() & CPU_AVX2) {
+		mult = mult_avx2;
+		square = square_avx2;
+	}
+#endif
+}
+
+static void mult_resolve(uint32_t out[32], const uint32_t a[32], const uint32_t b[32]) {
+	ecc_25519_dispatch_init();
+	mult(out, a, b);
+}
+
+static void square_resolve(uint32_t out[32], const uint32_t a[32]) {
+	ecc_25519_dispatch_init();
+	square(out, a);
+}
+
+void ecc_25519_dispatch_init(void) {
+#if HAVE_CPU_DISPATCH
+	cpu_dispatch_register(fe_bind);
+#else
+	fe_bind();
+#endif
+}
+
+/**
+ * Multiplies an unpacked integer with a small integer (modulo p)
+ *
+ * The result will be \em squeezed.
+ */
+static void mult_int(uint32_t out[32], uint32_t n, const uint32_t a[32]) {
+	unsigned int j;
+	uint32_t u;
+
+	u = 0;
+
+	for (j = 0; j < 31; j++) {
+		u += n * a[j];
+		out[j] = u & 255;
+		u >>= 8;
+	}
+
+	u += n * a[31]; out[31] = u & 127;
+	u = 19 * (u >> 7);
+
+	for (j = 0; j < 31; j++) {
+		u += out[j];
+		out[j] = u & 255;
+		u >>= 8;
+	}
+
+	u += out[j];
+	out[j] = u;
+}
+
+
+/** Unpacks 32 integer parts of 8 bits (or more, if \em squeezed) */
+static void unpack(uint32_t out[32], const uint32_t in[32]) {
+	unsigned int j;
+
+	for (j = 0; j < 32; j++)
+		out[j] = in[j];
+}
+
+/** Packs an unpacked integer into 32 integer parts of 8 bits, the result is \em squeezed */
+static void pack(uint32_t out[32], const uint32_t a[32]) {
+	unsigned int j;
+
+	for (j = 0; j < 32; j++)
+		out[j] = a[j];
+}
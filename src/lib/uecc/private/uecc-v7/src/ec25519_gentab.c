@@ -0,0 +1,63 @@
+/* -*- linux-c -*-
+ *
+ * $Id$
+ *
+ * Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * The author or authors of this code dedicate any and all copyright interest
+ * in this code to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and successors.
+ * We intend this dedication to be an overt act of relinquishment in
+ * perpetuity of all present and future rights to this code under copyright
+ * law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Generator for the fixed-base table ec25519_base.h used by
+ * ecc_25519_scalarmult_base(), run as
+ *
+ *   cc -I../include -o ec25519_gentab ec25519_gentab.c
+ *   ./ec25519_gentab > ec25519_base.h
+ *
+ * It includes ec25519.c without the table and computes the table with
+ * ecc_25519_table_init().
+ */
+
+#define UECC_NO_BASE_TABLE
+#include "ec25519.c"
+
+#include <stdio.h>
+
+int main(void) {
+	static ecc_25519_table_t tab;
+	int w, i, n;
+
+	ecc_25519_table_init(&tab, &ecc_25519_work_default_base);
+
+	printf("/* ec25519_base.h -- generated by ec25519_gentab.c, do not edit */\n\n");
+	printf("static const uint8_t base_table[64][15][96] = {\n");
+
+	for (w = 0; w < 64; w++) {
+		printf("  { /* 16^%d B */\n", w);
+		for (i = 0; i < 15; i++) {
+			printf("    {");
+			for (n = 0; n < 96; n++)
+				printf("%s0x%02x%s", n % 12 ? " " : "\n      ", tab.p[w][i][n], n < 95 ? "," : "");
+			printf("\n    }%s\n", i < 14 ? "," : "");
+		}
+		printf("  }%s\n", w < 63 ? "," : "");
+	}
+
+	printf("};\n");
+	return 0;
+}
@@ -27,6 +27,7 @@
 #
 
 import
+  cpu  / [cpu],
   misc / [prjcfg],
   uecc / [ueccdesc]
 
@@ -44,9 +45,24 @@ proc ueccPath(s: string = nil): string {.compileTime.} =
 const
   ueccHeader = "include/libuecc/ecc.h".ueccPath
 
+const
+  ueccField {.intdefine.} = 0
+    ## Field arithmetic backend, 8, 25 or 51 bit limbs (see
+    ## src/ec25519.c.) The default 0 leaves the choice to the C compiler,
+    ## i.e. 51 if it supports 128 bit integers, 25 otherwise. Set with
+    ## "nim c -d:ueccField=8 ..."
+
 {.passC: "-I " & "include".ueccPath.}
+when ueccField != 0:
+  {.passC: "-DUECC_FIELD=" & $ueccField.}
+{.passC: "-I " & "../cpu/private".nimSrcDirname & " -DHAVE_CPU_DISPATCH=1".}
 {.compile: "src/ec25519.c"    .ueccPath.}
 {.compile: "src/ec25519_gf.c" .ueccPath.}
+{.compile: "private/ecc_pool.c".nimSrcDirname.}
+{.passL: "-lpthread".}
+
+const
+  ueccPoolHeader = "private/ecc_pool.h".nimSrcDirname
 
 # ----------------------------------------------------------------------------
 # Uecc library interface
@@ -110,6 +126,35 @@ proc ecc_25519_store_xy_ed25519*(x: ptr UEccScalar;
   {.cdecl, header: ueccHeader, importc.}
 
 
+# Stores the x and y coordinates of n points of the Ed25519 curve. Same as
+# ecc_25519_store_xy_ed25519() for each point but the field inversions are
+# combined into one (Montgomery's trick.)
+#
+# Params:
+#    x -- Returns the x coordinates of the points. May be NULL.
+#    y -- Returns the y coordinates of the points. May be NULL.
+#    w -- Input, the unpacked points to store.
+#    n -- Input, the number of points.
+#
+proc ecc_25519_store_xy_ed25519_batch*(x: ptr UEccScalar;
+                                       y: ptr UEccScalar;
+                                       w: ptr UEccWorker; n: csize)
+  {.cdecl, header: ueccHeader, importc.}
+
+
+# Stores the u coordinate of the Montgomery form (Curve25519) of a point of
+# the Ed25519 curve, u = (1 + y)/(1 - y). This is the coordinate used by
+# X25519.
+#
+# Params:
+#    u -- Returns the u coordinate of the point.
+#    w -- Input, the unpacked point to store.
+#
+proc ecc_25519_store_x25519*(u: ptr UEccScalar;
+                             w: ptr UEccWorker)
+  {.cdecl, header: ueccHeader, importc.}
+
+
 # Loads a packed point of the Ed25519 curve into its unpacked representation
 #
 # The packed format is different from the legacy one: the legacy format
@@ -269,7 +314,9 @@ proc ecc_25519_scalarmult*(u: ptr UEccWorker;
 #            2^{252} + 27742317777372353535851937790883648493.
 #
 # ecc_25519_scalarmult_base_bits(out,n,bits) is faster than
-# ecc_25519_scalarmult_bits(out,n,&ecc_25519_work_default_base, bits).
+# ecc_25519_scalarmult_bits(out,n,&ecc_25519_work_default_base, bits). It
+# uses a precomputed table of base point multiples (one addition per 4 bit
+# window, no doubling) and runs in constant time.
 #
 # See the notes about 'ecc_25519_scalarmult_bits' before using this function.
 #
@@ -301,6 +348,116 @@ proc ecc_25519_scalarmult_base*(u: ptr UEccWorker;
                                 n: ptr UEccScalar)
   {.cdecl, header: ueccHeader, importc.}
 
+
+# Computes the window table of a point of the Elliptic Curve. This costs
+# about as much as six calls of ecc_25519_scalarmult().
+#
+# Params:
+#   t -- Output
+#   p -- Input, point
+#
+proc ecc_25519_table_init*(t: ptr UEccTable;
+                           p: ptr UEccWorker)
+  {.cdecl, header: ueccHeader, importc.}
+
+
+# Does a scalar multiplication of a point given by its window table with an
+# integer of a given bit length
+#
+# ecc_25519_scalarmult_table_bits(out,n,table,bits) gives the same result as
+# ecc_25519_scalarmult_bits(out,n,base,bits) for the point base the table
+# was computed from, but is several times faster. It runs in constant time.
+#
+# Params:
+#   u -- Output
+#   n -- Input, scalar
+#   t -- Input, window table
+#   b -- #bits for n
+#
+proc ecc_25519_scalarmult_table_bits*(u: ptr UEccWorker;
+                                      n: ptr UEccScalar;
+                                      t: ptr UEccTable;
+                                      b: cuint)
+  {.cdecl, header: ueccHeader, importc.}
+
+
+# Does a scalar multiplication of a point given by its window table with an
+# integer
+#
+# Params:
+#   u -- Output
+#   n -- Input, scalar
+#   t -- Input, window table
+#
+proc ecc_25519_scalarmult_table*(u: ptr UEccWorker;
+                                 n: ptr UEccScalar;
+                                 t: ptr UEccTable)
+  {.cdecl, header: ueccHeader, importc.}
+
+
+# Does an X25519 scalar multiplication (Montgomery ladder) of a point given
+# in packed Ed25519 format. Only the y coordinate is used, so the point is
+# neither unpacked nor checked. The result is the u coordinate of the product
+# as ecc_25519_store_x25519() would store it, at about half the cost of
+# ecc_25519_load_packed_ed25519() and ecc_25519_scalarmult().
+#
+# Params:
+#   u -- Output, u coordinate of the product
+#   n -- Input, scalar
+#   p -- Input, packed point
+# Return:
+#   1 -- ok, 0 if the result is zero (p is of small order or not valid)
+#
+proc ecc_25519_x25519_ed25519*(u: ptr UEccScalar;
+                               n: ptr UEccScalar;
+                               p: ptr UEccScalar): cint
+  {.cdecl, header: ueccHeader, importc.}
+
+# Binds the field arithmetic to the variant best suited for the CPU (see
+# cpu module.) Only the 8 bit field backend has such variants. This is done
+# implicitly on first use, calling it early avoids races when the first use
+# happens concurrently in several threads.
+#
+proc ecc_25519_dispatch_init()
+  {.cdecl, header: ueccHeader, importc.}
+
+# ----------------------------------------------------
+# Pool of ephemeral key pairs filled by a background
+# thread (the pool handle is an opaque pointer)
+# ----------------------------------------------------
+
+# Starts the background thread
+#
+# Params:
+#   n -- Input, number of key pairs kept (rounded up to a power of two)
+# Return:
+#   pool handle, or nil if the thread could not be started
+#
+proc ecc_pool_new*(n: cuint): pointer
+  {.cdecl, header: ueccPoolHeader, importc.}
+
+# Takes the next key pair and wipes the pool copy, does not block
+#
+# Params:
+#   p -- Input, pool handle (may be nil)
+#   d -- Output, secret key
+#   Q -- Output, public key in packed format
+# Return:
+#   1 -- ok, 0 if the pool is empty
+#
+proc ecc_pool_take*(p: pointer; d, Q: ptr UEccScalar): cint
+  {.cdecl, header: ueccPoolHeader, importc.}
+
+# Number of key pairs ready
+#
+proc ecc_pool_level*(p: pointer): cuint
+  {.cdecl, header: ueccPoolHeader, importc.}
+
+# Stops the thread, wipes the key pairs and frees the pool
+#
+proc ecc_pool_free*(p: pointer)
+  {.cdecl, header: ueccPoolHeader, importc.}
+
 # ----------------------------------------------------
 # gf_ops Prime field operations for the order of the
 # base point of the Elliptic Curve
@@ -410,6 +567,23 @@ proc ecc_25519_gf_sanitize_secret*(u: ptr UEccScalar;
 ## For an explanation how it works see
 ##   //en.wikipedia.org/wiki/Elliptic_curve_Diffie-Hellman
 
+type
+  UEccSessKeyItem* = tuple     ## argument record for uEccSessionKeyBatch()
+    X:  UEccScalar              ## output, session key
+    d:  ptr UEccScalar          ## input, own secret (skipped if nil)
+    Q:  ptr UEccScalar          ## input, other public key (skipped if nil)
+    ok: bool                    ## output, true if X was set
+
+const
+  uEccBatchLen = 32             # session keys sharing a field inversion
+
+proc notZero(X: UEccScalar): bool {.inline.} =
+  ## constant time test for a non-zero key
+  var acc = 0u8
+  for n in 0..<X.len:
+    acc = acc or X[n]
+  acc != 0
+
 proc uEccSanitise*(d: var UEccScalar) {.inline.} =
   ## sanitise secret d ready for use as secret key
   # var dPtr = cast[ptr UEccScalar](addr d[0])
@@ -441,6 +615,148 @@ proc uEccSessionKey*(X: var UEccScalar;
     (addr y).zeroMem(y.sizeof)
   (addr wObj).zeroMem(wObj.sizeof)
 
+
+proc uEccPrepKey*(W: var UEccWorker;
+                  Q: ptr UEccScalar): bool {.discardable,inline.} =
+  ## given another public key Q (in packed format), set W to the unpacked
+  ## point for repeated use with uEccSessionKey(); this saves the square
+  ## root needed for unpacking Q on every call. Returns false if Q is not a
+  ## valid point and sets W to the identity element.
+  result = ecc_25519_load_packed_ed25519(addr W, Q) == 1
+  if not result:
+    W = eccWorkIdentity
+
+proc uEccRndPoint*(X: var UEccScalar): bool =
+  ## given random data X, replace X by a public key (in packed format) that
+  ## is a valid point of the prime order subgroup like the result of
+  ## uEccPubKey(), without a known secret. This costs a point expansion and
+  ## three doublings rather than a scalar multiplication. Returns false if
+  ## the data X do not encode a point in which case X must be refilled.
+  var wObj: UEccWorker
+  if ecc_25519_load_packed_ed25519(addr wObj, addr X) == 1:
+    ecc_25519_double(addr wObj, addr wObj)                   # clear the
+    ecc_25519_double(addr wObj, addr wObj)                   # cofactor 8
+    ecc_25519_double(addr wObj, addr wObj)
+    if ecc_25519_is_identity(addr wObj) == 0:
+      ecc_25519_store_packed_ed25519(addr X, addr wObj)
+      result = true
+  (addr wObj).zeroMem(wObj.sizeof)
+
+proc uEccSessionKey*(X: var UEccScalar;
+                     d: ptr UEccScalar;
+                     W: ptr UEccWorker) {.inline.} =
+  ## given secret d and another public key W prepared by uEccPrepKey(),
+  ## set X as session key in packed format
+  var
+    wObj: UEccWorker
+    y: UEccScalar
+  ecc_25519_scalarmult(addr wObj, d, W)                      # => d * W
+  ecc_25519_store_xy_ed25519(addr X, addr y, addr wObj)      # compress
+  (addr y).zeroMem(y.sizeof)
+  (addr wObj).zeroMem(wObj.sizeof)
+
+proc uEccPrepTable*(T: var UEccTable;
+                    Q: ptr UEccScalar): bool {.discardable.} =
+  ## given another public key Q (in packed format), set T to its window
+  ## table for repeated use with uEccSessionKey(); this costs about six
+  ## session keys and makes each following one several times faster.
+  ## Returns false if Q is not a valid point.
+  var wObj: UEccWorker
+  result = ecc_25519_load_packed_ed25519(addr wObj, Q) == 1
+  if not result:
+    wObj = eccWorkIdentity
+  ecc_25519_table_init(addr T, addr wObj)
+  (addr wObj).zeroMem(wObj.sizeof)
+
+proc uEccSessionKey*(X: var UEccScalar;
+                     d: ptr UEccScalar;
+                     T: ptr UEccTable) {.inline.} =
+  ## given secret d and another public key T prepared by uEccPrepTable(),
+  ## set X as session key in packed format
+  var
+    wObj: UEccWorker
+    y: UEccScalar
+  ecc_25519_scalarmult_table(addr wObj, d, T)                # => d * Q
+  ecc_25519_store_xy_ed25519(addr X, addr y, addr wObj)      # compress
+  (addr y).zeroMem(y.sizeof)
+  (addr wObj).zeroMem(wObj.sizeof)
+
+proc uEccSessionKeyX25519*(X: var UEccScalar;
+                           d: ptr UEccScalar;
+                           Q: ptr UEccScalar): bool {.discardable,inline.} =
+  ## given secret d and another public key Q (in packed format), set X as
+  ## X25519 session key, the Montgomery u coordinate of d * Q. This is
+  ## computed by a ladder straight from the packed key which is cheaper than
+  ## uEccSessionKey(). Returns false if the key is not usable.
+  result = ecc_25519_x25519_ed25519(addr X, d, Q) == 1
+
+proc uEccSessionKeyX25519*(X: var UEccScalar;
+                           d: ptr UEccScalar;
+                           W: ptr UEccWorker): bool {.discardable,inline.} =
+  ## same as uEccSessionKeyX25519() for a public key prepared by
+  ## uEccPrepKey(), returns false if the session key is zero
+  var wObj: UEccWorker
+  ecc_25519_scalarmult(addr wObj, d, W)                      # => d * W
+  ecc_25519_store_x25519(addr X, addr wObj)
+  (addr wObj).zeroMem(wObj.sizeof)
+  result = X.notZero
+
+proc uEccSessionKeyX25519*(X: var UEccScalar;
+                           d: ptr UEccScalar;
+                           T: ptr UEccTable): bool {.discardable,inline.} =
+  ## same as uEccSessionKeyX25519() for a public key prepared by
+  ## uEccPrepTable(), returns false if the session key is zero
+  var wObj: UEccWorker
+  ecc_25519_scalarmult_table(addr wObj, d, T)                # => d * Q
+  ecc_25519_store_x25519(addr X, addr wObj)
+  (addr wObj).zeroMem(wObj.sizeof)
+  result = X.notZero
+
+template itemAt(p: ptr UEccSessKeyItem; n: int): ptr UEccSessKeyItem =
+  cast[ptr UEccSessKeyItem](cast[ByteAddress](p) + n * UEccSessKeyItem.sizeof)
+
+proc uEccSessionKeyBatch*(keys: ptr UEccSessKeyItem;
+                          n: int): int {.discardable.} =
+  ## same as uEccSessionKey() for n argument records starting at keys,
+  ## returns the number of session keys set
+  var
+    wObj: array[uEccBatchLen,UEccWorker]
+    xObj: array[uEccBatchLen,UEccScalar]
+    inx:  array[uEccBatchLen,int]
+    m = 0
+  for i in 0..<n:
+    var k = keys.itemAt(i)
+    k.ok = false
+    if not k.d.isNil and not k.Q.isNil:
+      if ecc_25519_load_packed_ed25519(addr wObj[m], k.Q) == 1:    # expand Q
+        ecc_25519_scalarmult(addr wObj[m], k.d, addr wObj[m])      # => d * Q
+        inx[m] = i
+        m.inc
+    if 0 < m and (m == uEccBatchLen or i == n - 1):                 # compress
+      ecc_25519_store_xy_ed25519_batch(addr xObj[0], nil, addr wObj[0], m)
+      for j in 0..<m:
+        keys.itemAt(inx[j]).X = xObj[j]
+        keys.itemAt(inx[j]).ok = true
+      result += m
+      m = 0
+  (addr wObj).zeroMem(wObj.sizeof)
+  (addr xObj).zeroMem(xObj.sizeof)
+
+proc uEccSessionKeyBatch*(keys: var openArray[UEccSessKeyItem]): int
+                         {.discardable,inline.} =
+  ## Batch version of uEccSessionKey(), derives a session key for each
+  ## argument record. The scalar multiplications are done one by one but
+  ## the costly final field inversion is shared by up to 32 keys. Returns
+  ## the number of session keys set.
+  if 0 < keys.len:
+    result = uEccSessionKeyBatch(addr keys[0], keys.len)
+
+# ----------------------------------------------------------------------------
+# Initialisation
+# ----------------------------------------------------------------------------
+
+ecc_25519_dispatch_init() # bind kernels before any threads are started
+
 # ----------------------------------------------------------------------------
 # Tests
 # ----------------------------------------------------------------------------
@@ -478,6 +794,100 @@ when isMainModule:
       echo ">> ", Q1.pp, " >> ", k1.pp
     assert k0 == k1
 
+    block:                                       # prepared keys must
+      var                                        # agree with packed ones
+        W1: UEccWorker
+        k2: UEccScalar
+      doAssert W1.uEccPrepKey(addr Q1)
+      k2.uEccSessionKey(addr d0, addr W1)
+      doAssert k2 == k0
+
+    block:                                       # window tables too
+      var
+        T1: ref UEccTable
+        k2: UEccScalar
+      T1.new
+      doAssert T1[].uEccPrepTable(addr Q1)
+      k2.uEccSessionKey(addr d0, addr T1[])
+      doAssert k2 == k0
+
+    block:                                       # X25519 keys must agree
+      var                                        # in all variants
+        W1: UEccWorker
+        T1: ref UEccTable
+        x0, x1, x2, x3: UEccScalar
+      T1.new
+      doAssert x0.uEccSessionKeyX25519(addr d0, addr Q1)
+      doAssert x1.uEccSessionKeyX25519(addr d1, addr Q0)
+      doAssert W1.uEccPrepKey(addr Q1)
+      doAssert T1[].uEccPrepTable(addr Q1)
+      x2.uEccSessionKeyX25519(addr d0, addr W1)
+      x3.uEccSessionKeyX25519(addr d0, addr T1[])
+      doAssert x0 == x1
+      doAssert x0 == x2
+      doAssert x0 == x3
+      doAssert x0 != k0
+
+    block:                                       # batch session keys must
+      var                                        # agree with single ones
+        keys: array[40,UEccSessKeyItem]
+        dd: array[40,UEccScalar]
+      for i in 0..<keys.len:
+        for n in 0..31: dd[i][n] = (7 * i + n).uint8
+        dd[i].uEccSanitise
+        keys[i].d = addr dd[i]
+        keys[i].Q = if i mod 3 == 0: addr Q0 else: addr Q1
+      keys[5].Q = nil
+      doAssert keys.uEccSessionKeyBatch == keys.len - 1
+      for i in 0..<keys.len:
+        doAssert keys[i].ok == (i != 5)
+        if keys[i].ok:
+          var k: UEccScalar
+          k.uEccSessionKey(keys[i].d, keys[i].Q)
+          doAssert k == keys[i].X
+
+    for bits in [256, 255, 131, 64, 7, 0]:      # fixed-base table must
+      var                                        # agree with the generic
+        wBase, wGen: UEccWorker                  # scalar multiplication
+        xBase, xGen, yBase, yGen, sc: UEccScalar
+        eccBase = eccWorkDefaultBase
+      for n in 0..31: sc[n] = (0xff - 5 * n).uint8
+      ecc_25519_scalarmult_base_bits(addr wBase, addr sc, bits.cuint)
+      ecc_25519_scalarmult_bits(addr wGen, addr sc, addr eccBase, bits.cuint)
+      ecc_25519_store_xy_ed25519(addr xBase, addr yBase, addr wBase)
+      ecc_25519_store_xy_ed25519(addr xGen,  addr yGen,  addr wGen)
+      doAssert xBase == xGen
+      doAssert yBase == yGen
+
+    block:                                       # random points are in
+      var                                        # the prime order group
+        R, P, k2, k3: UEccScalar
+        order = eccGfOrder
+        wObj: UEccWorker
+        n = 0
+      for i in 0..31: R[i] = (13 * i + 1).uint8
+      while not R.uEccRndPoint:
+        R[0].inc
+        n.inc
+      doAssert n < 64
+      doAssert ecc_25519_load_packed_ed25519(addr wObj, addr R) == 1
+      ecc_25519_scalarmult(addr wObj, addr order, addr wObj) # L * R
+      doAssert ecc_25519_is_identity(addr wObj) == 1
+      k2.uEccSessionKey(addr d0, addr R)         # usable as public key
+      P = R
+      doAssert P.uEccRndPoint and P != R         # multiplies by 8 again
+      k3.uEccSessionKey(addr d0, addr P)
+      doAssert k3 != k2
+
+    for level in ["scalar", "avx2"]:             # all field arithmetic
+      cpuSelect(level)                           # variants must agree
+      var k2, Q2: UEccScalar
+      Q2.uEccPubKey(addr d1)
+      k2.uEccSessionKey(addr d0, addr Q2)
+      doAssert Q2 == Q1
+      doAssert k2 == k0
+    cpuSelect()
+
     var
       Q0e = encode Q0
       Q0d = decode Q0e
@@ -48,6 +48,12 @@ type                                           # A 256 bit integer
     Z: UEccWorkRow
     T: UEccWorkRow
 
+  # A window table of multiples of a point for fast scalar multiplication,
+  # entry p[w][i-1] holds i * 16^w * P (about 90k, so keep it off the stack)
+  #
+  UEccTable* = tuple                           # renamed from ecc_25519_table_t
+    p: array[64,array[15,array[96,uint8]]]
+
 const
   workIdentityEasy =
     [[   0,    0,    0,    0,    0,    0,    0,    0,
@@ -0,0 +1,604 @@
+# -*- nim -*-
+#
+# $Id$
+#
+# Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+# All rights reserved.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# The author or authors of this code dedicate any and all copyright interest
+# in this code to the public domain. We make this dedication for the benefit
+# of the public at large and to the detriment of our heirs and successors.
+# We intend this dedication to be an overt act of relinquishment in
+# perpetuity of all present and future rights to this code under copyright
+# law.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+#
+#
+## This module provides an authenticated container format on top of the
+## raw session data of the 'xcrypt' module. The plain text is split into
+## chunks of fixed size (the last one may be shorter.) Every chunk is
+## stored as a frame with its chunk index and a Poly1305 tag, so a chunk
+## can be verified and decrypted on its own, e.g. by several threads or
+## for a ranged read, and a stream can be processed with memory bounded
+## by the chunk size.
+##
+## Container layout:
+##
+## * raw session header as returned by getXRawEncrypt()
+## * chunk descriptor (16 bytes): "XCHUNK\\0\\1", chunk size (32 bit
+##   little endian), zero (32 bit); encrypted as the first payload bytes
+## * frames: chunk index (64 bit little endian, bit 63 set for the final
+##   chunk), data length (32 bit little endian), cipher data, Poly1305 tag
+##
+## The cipher data of chunk i are the raw session data at payload offset
+## 16 + i * chunk size. The one-time Poly1305 key of chunk i is taken from
+## the ChaCha20 key stream block 2^62 + i which is never used for the
+## cipher data. The tag covers the descriptor, the frame header and the
+## cipher data, so chunks cannot be re-ordered, dropped at the end, or
+## moved to another container.
+##
+## Data encrypted with the plain 'xcrypt' raw functions (i.e. without the
+## chunk descriptor) are rejected by getXChunkDecrypt() unless explicitly
+## allowed. They can then be read with the same streaming functions, albeit
+## without authentication, so xChunkStreamDecryptDone() never succeeds for
+## them.
+##
+## Example:
+##
+## .. code-block::
+##
+##    import
+##      xchunk
+##
+##    proc encrypt(s: string; pub: ptr EccPubKey): string =
+##      var
+##        ctx:  XChunkCtx
+##        keys = [pub, nil, nil]
+##        chl  = getXVerfier()
+##      result = ctx.getXChunkEncrypt(addr keys, addr chl) &
+##               ctx.xChunkStreamEncrypt(s) &
+##               ctx.xChunkStreamEncryptDone
+##      ctx.clearXChunk
+##
+##    proc decrypt(s: string; prv: ptr EccPrvKey): string =
+##      var
+##        ctx: XChunkCtx
+##        chl = getXVerfier()
+##        pre = ctx.getXChunkDecrypt(s, prv, addr chl)
+##      doAssert 0 < pre
+##      result = ctx.xChunkStreamDecrypt(s[pre..<s.len])
+##      doAssert ctx.xChunkStreamDecryptDone
+##      ctx.clearXChunk
+##
+
+import
+  endians, xcrypt,
+  chacha / [chacha, poly1305]
+
+export
+  xcrypt
+
+const
+  xChunkLen*       = 64 * 1024         ## default chunk size
+  xChunkMaxLen*    = 16 * 1024 * 1024  ## largest chunk size accepted
+  xChunkDescLen    = 16
+  xChunkHeaderLen* = xRawHeaderLen + xChunkDescLen ## header + descriptor
+  xChunkFrameHdr   = 12
+  xChunkOverhead*  = xChunkFrameHdr + poly1305TagLen ## frame bytes added
+  xChunkMagic      = "XCHUNK\x00\x01"
+  xChunkFinal      = 1u64 shl 63
+  xChunkPolyBlk    = 1u64 shl 62      # key stream blocks for Poly1305 keys
+
+type
+  XChunkDesc = array[xChunkDescLen, uint8]
+
+  XChunkCtx* = tuple                    ## chunked container context
+    x:        XCryptCtx
+    desc:     XChunkDesc                # plain chunk descriptor
+    chunkLen: int                       # zero for legacy raw session data
+    hdrLen:   int                       # session header + descriptor
+    index:    uint64                    # next chunk index (streaming)
+    buf:      string                    # pending data (streaming)
+    final:    bool                      # final frame seen (decrypting)
+    failed:   bool                      # invalid frame seen (decrypting)
+
+# ----------------------------------------------------------------------------
+# Private helpers
+# ----------------------------------------------------------------------------
+
+proc `+!`(p: pointer; n: int): pointer {.inline.} =
+  cast[pointer](cast[ByteAddress](p) + n)
+
+proc polyKey(c: XChunkCtx; index: uint64; key: var Poly1305Key) =
+  var
+    ccc = c.x.ccc
+    blk: ChaChaBlk
+  ccc.chachaBlockSeek(xChunkPolyBlk + index)
+  ccc.chachaBlock(addr blk)
+  (addr key[0]).copyMem(addr blk.data[0], key.sizeof)
+  (addr blk).zeroMem(blk.sizeof)
+  (addr ccc).zeroMem(ccc.sizeof)
+
+proc frameTag(c: XChunkCtx; index: uint64;
+              frame: pointer; n: int; tag: var Poly1305Tag) =
+  ## tag of a frame with n cipher data bytes
+  var
+    key: Poly1305Key
+    mac: Poly1305Ctx
+  c.polyKey(index, key)
+  mac.getPoly1305(addr key)
+  mac.poly1305Update(unsafeAddr c.desc[0], c.desc.len)
+  mac.poly1305Update(frame, xChunkFrameHdr)
+  mac.poly1305Pad16
+  mac.poly1305Update(frame +! xChunkFrameHdr, n)
+  mac.poly1305Finish(tag)
+  (addr key).zeroMem(key.sizeof)
+
+proc cryptAt(c: XChunkCtx; index: uint64; dst, src: pointer; n: int) =
+  ## en/decrypt chunk data on a copy of the cipher context
+  if 0 < n:
+    var x = c.x
+    x.xRawDecryptAt(xChunkDescLen.uint64 + index * c.chunkLen.uint64,
+                    dst, src, n)
+    x.clearXCrypt
+
+proc frameOk(c: XChunkCtx; index: uint64;
+             frame: pointer; n: int; final: var bool): int =
+  ## check frame header and tag, returns the data length or -1
+  var
+    idx: uint64
+    size: uint32
+    tag: Poly1305Tag
+  if n < xChunkOverhead:
+    return -1
+  littleEndian64(addr idx, frame)
+  littleEndian32(addr size, frame +! 8)
+  final = (idx and xChunkFinal) != 0
+  if (idx and not xChunkFinal) != index or
+     n != xChunkOverhead + size.int or
+     c.chunkLen < size.int or
+     (not final and size.int != c.chunkLen):
+    return -1
+  c.frameTag(index, frame, size.int, tag)
+  var want: Poly1305Tag
+  (addr want[0]).copyMem(frame +! (n - poly1305TagLen), poly1305TagLen)
+  if not tag.poly1305Verify(want):
+    return -1
+  size.int
+
+proc startChunks(c: var XChunkCtx; hdr: var string; chunkLen: int) =
+  ## append the encrypted chunk descriptor to the session header
+  var
+    size = chunkLen.uint32
+    hLen = hdr.len
+  for n in 0..<xChunkMagic.len:
+    c.desc[n] = xChunkMagic[n].uint8
+  littleEndian32(addr c.desc[8], addr size)
+  c.chunkLen = chunkLen
+  c.hdrLen = hLen + xChunkDescLen
+  c.index = 0
+  c.buf = ""
+  c.final = false
+  c.failed = false
+  hdr.setLen(c.hdrLen)
+  var x = c.x
+  x.xRawDecryptAt(0, addr hdr[hLen], addr c.desc[0], xChunkDescLen)
+  x.clearXCrypt
+
+proc addBytes(buf: var string; p: pointer; n: int) =
+  ## append n bytes at p to the stream buffer
+  if 0 < n:
+    let start = buf.len
+    buf.setLen(start + n)
+    (addr buf[start]).copyMem(p, n)
+
+proc dropBytes(buf: var string) =
+  ## wipe and empty the stream buffer
+  if 0 < buf.len:
+    (addr buf[0]).zeroMem(buf.len)
+    buf.setLen(0)
+
+proc streamFrame(c: var XChunkCtx; frame: pointer; n: int;
+                 plain: var string): int =
+  ## verify the next frame at the start of the n bytes at 'frame' and
+  ## append its plain data, returns the frame length or zero if the frame
+  ## is incomplete or invalid (then c.failed is set)
+  if n < xChunkFrameHdr:
+    return 0
+  var size: uint32
+  littleEndian32(addr size, frame +! 8)
+  if c.final or c.chunkLen < size.int:        # nothing after the final chunk
+    c.failed = true
+    return 0
+  let frameLen = size.int + xChunkOverhead
+  if n < frameLen:
+    return 0
+  var final: bool
+  if c.frameOk(c.index, frame, frameLen, final) < 0:
+    c.failed = true
+    return 0
+  if 0 < size:
+    let dst = plain.len
+    plain.setLen(dst + size.int)
+    c.cryptAt(c.index, addr plain[dst], frame +! xChunkFrameHdr, size.int)
+  c.index.inc
+  c.final = final
+  frameLen
+
+# ----------------------------------------------------------------------------
+# Public functions
+# ----------------------------------------------------------------------------
+
+proc xChunkFrameLen*(n: int): int {.inline.} =
+  ## size of a frame holding n bytes of plain data
+  n + xChunkOverhead
+
+proc xChunkOffset*(c: XChunkCtx; index: int|uint64): int {.inline.} =
+  ## container offset of the frame of chunk 'index' (counted from the
+  ## start of the session header)
+  c.hdrLen + index.int * xChunkFrameLen(c.chunkLen)
+
+proc xChunkIsLegacy*(c: XChunkCtx): bool {.inline.} =
+  ## true if getXChunkDecrypt() found raw session data without chunks
+  c.chunkLen == 0
+
+
+proc getXChunkEncrypt*(c: var XChunkCtx;
+                       pub: ptr array[3,ptr EccPubKey];
+                       challenge: ptr XPattern;
+                       version = sessHdrLegacy;
+                       chunkLen = xChunkLen): string =
+  ## Start a chunked container, see getXRawEncrypt() for the arguments.
+  ## It returns the session header followed by the encrypted chunk
+  ## descriptor, i.e. xChunkHeaderLen bytes.
+  doAssert 0 < chunkLen and chunkLen <= xChunkMaxLen
+  result = c.x.getXRawEncrypt(pub, challenge, version)
+  c.startChunks(result, chunkLen)
+
+proc getXChunkEncrypt*(c: var XChunkCtx;
+                       pub: openArray[ptr EccPubKey];
+                       challenge: ptr XPattern;
+                       version = sessHdrMulti;
+                       chunkLen = xChunkLen): string =
+  ## Same as getXChunkEncrypt() above for any number of recipients. The
+  ## header returned is xRawHeaderSize() plus 16 descriptor bytes long.
+  doAssert 0 < chunkLen and chunkLen <= xChunkMaxLen
+  result = c.x.getXRawEncrypt(pub, challenge, version)
+  c.startChunks(result, chunkLen)
+
+
+proc getXChunkDecrypt*(c: var XChunkCtx;
+                       bin: string;
+                       prv: ptr EccPrvKey;
+                       challenge: ptr XPattern;
+                       allowLegacy = false): int =
+  ## Start reading a container from its first bytes in 'bin' which must
+  ## include the chunk descriptor. It returns the length of the header
+  ## consumed (e.g. xChunkHeaderLen), or zero if the session header does
+  ## not match the private key or no valid chunk descriptor follows.
+  ##
+  ## With 'allowLegacy' set, raw session data without a valid descriptor
+  ## are accepted and the result is the session header length (see
+  ## xChunkIsLegacy().) As the descriptor is not authenticated before it
+  ## is checked, a corrupted container is indistinguishable from such
+  ## data, which are decrypted without any verification.
+  c.chunkLen = 0
+  c.index = 0
+  c.buf = ""
+  c.final = false
+  c.failed = false
+  result = c.x.getXRawDecrypt(bin, prv, challenge)
+  c.hdrLen = result
+  if result <= 0:
+    return 0
+
+  if result + xChunkDescLen <= bin.len:
+    var
+      d: XChunkDesc
+      size: uint32
+      x = c.x
+    x.xRawDecryptAt(0, addr d[0], unsafeAddr bin[result], d.len)
+    x.clearXCrypt
+    littleEndian32(addr size, addr d[8])
+    var magic = true
+    for n in 0..<xChunkMagic.len:
+      magic = magic and d[n] == xChunkMagic[n].uint8
+    if magic and
+       d[12] == 0 and d[13] == 0 and d[14] == 0 and d[15] == 0 and
+       0u32 < size and size <= xChunkMaxLen.uint32:
+      c.desc = d
+      c.chunkLen = size.int
+      result.inc(xChunkDescLen)
+      c.hdrLen = result
+
+  if c.chunkLen == 0 and not allowLegacy:
+    c.x.clearXCrypt
+    c.hdrLen = 0
+    result = 0
+
+
+proc xChunkEncryptAt*(c: XChunkCtx; index: int|uint64; final: bool;
+                      dst, src: pointer; n: int) =
+  ## Encrypt the n bytes of plain data at src as chunk 'index' into the
+  ## frame at dst of xChunkFrameLen(n) bytes. All chunks but the final one
+  ## must have the chunk size. The context is not modified, so chunks can
+  ## be encrypted in any order or by several threads.
+  doAssert n <= c.chunkLen and (final or n == c.chunkLen)
+  var
+    idx = index.uint64 or (if final: xChunkFinal else: 0u64)
+    size = n.uint32
+    tag: Poly1305Tag
+  littleEndian64(dst, addr idx)
+  littleEndian32(dst +! 8, addr size)
+  c.cryptAt(index.uint64, dst +! xChunkFrameHdr, src, n)
+  c.frameTag(index.uint64, dst, n, tag)
+  (dst +! (xChunkFrameHdr + n)).copyMem(addr tag[0], tag.len)
+
+proc xChunkDecryptAt*(c: XChunkCtx; index: int|uint64;
+                      dst, src: pointer; n: int): int =
+  ## Verify the n bytes frame of chunk 'index' at src and decrypt its data
+  ## into dst (at least n - xChunkOverhead bytes.) It returns the number of
+  ## plain bytes, or -1 if the frame is invalid in which case nothing is
+  ## written. As with xChunkEncryptAt(), the context is not modified.
+  var final: bool
+  result = c.frameOk(index.uint64, src, n, final)
+  if 0 < result:
+    c.cryptAt(index.uint64, dst, src +! xChunkFrameHdr, result)
+
+proc xChunkIsFinal*(src: pointer; n: int): bool =
+  ## true if the frame at src is marked as final chunk (not verified)
+  if xChunkFrameHdr <= n:
+    var idx: uint64
+    littleEndian64(addr idx, src)
+    result = (idx and xChunkFinal) != 0
+
+
+proc xChunkStreamEncrypt*(c: var XChunkCtx; p: pointer; n: int): string =
+  ## Encrypt plain data, returns the frames of all chunks completed. Data
+  ## of an incomplete chunk are kept until the next call.
+  result = ""
+  var pos = 0
+  if 0 < c.buf.len and 0 < n:                 # complete the pending chunk
+    pos = min(n, c.chunkLen - c.buf.len)
+    c.buf.addBytes(p, pos)
+    if c.buf.len == c.chunkLen and pos < n:
+      result = newString(xChunkFrameLen(c.chunkLen))
+      c.xChunkEncryptAt(c.index, false,
+                        addr result[0], addr c.buf[0], c.chunkLen)
+      c.index.inc
+      c.buf.dropBytes
+
+  while c.chunkLen < n - pos:                 # keep the last chunk for done
+    let start = result.len
+    result.setLen(start + xChunkFrameLen(c.chunkLen))
+    c.xChunkEncryptAt(c.index, false,
+                      addr result[start], p +! pos, c.chunkLen)
+    c.index.inc
+    pos.inc(c.chunkLen)
+
+  if pos < n:
+    c.buf.addBytes(p +! pos, n - pos)
+
+proc xChunkStreamEncrypt*(c: var XChunkCtx; s: string): string {.inline.} =
+  ## same as xChunkStreamEncrypt() above for a string argument
+  c.xChunkStreamEncrypt(unsafeAddr s[0], s.len)
+
+proc xChunkStreamEncryptDone*(c: var XChunkCtx): string =
+  ## Flush the final chunk frame (possibly without data.)
+  result = newString(xChunkFrameLen(c.buf.len))
+  c.xChunkEncryptAt(c.index, true,
+                    addr result[0], addr c.buf[0], c.buf.len)
+  c.index.inc
+  (addr c.buf[0]).zeroMem(c.buf.len)
+  c.buf = ""
+
+
+proc xChunkStreamDecrypt*(c: var XChunkCtx; p: pointer; n: int): string =
+  ## Verify and decrypt container data following the header, returns the
+  ## plain data of all complete frames. Incomplete frames are kept until
+  ## the next call. After an invalid frame nothing more is returned and
+  ## xChunkStreamDecryptDone() fails. Legacy raw session data are
+  ## decrypted as they are.
+  result = ""
+  if c.xChunkIsLegacy:
+    if 0 < n:
+      result = c.x.xRawDecrypt(p, n)
+    return
+  if c.failed or n <= 0:
+    return
+
+  var pos = 0
+  while 0 < c.buf.len and pos < n and not c.failed: # complete pending frame
+    var want = xChunkFrameHdr
+    if xChunkFrameHdr <= c.buf.len:
+      var size: uint32
+      littleEndian32(addr size, addr c.buf[8])
+      want = xChunkFrameLen(min(size.int, c.chunkLen))
+    let k = min(want - c.buf.len, n - pos)
+    c.buf.addBytes(p +! pos, k)
+    pos.inc(k)
+    if 0 < c.streamFrame(addr c.buf[0], c.buf.len, result):
+      c.buf.dropBytes
+
+  while pos < n and not c.failed:             # frames straight from input
+    let k = c.streamFrame(p +! pos, n - pos, result)
+    if k == 0:
+      break
+    pos.inc(k)
+
+  if pos < n and not c.failed:
+    c.buf.addBytes(p +! pos, n - pos)
+
+proc xChunkStreamDecrypt*(c: var XChunkCtx; s: string): string {.inline.} =
+  ## same as xChunkStreamDecrypt() above for a string argument
+  c.xChunkStreamDecrypt(unsafeAddr s[0], s.len)
+
+proc xChunkStreamDecryptDone*(c: var XChunkCtx): bool =
+  ## Returns true if all data were valid and the final chunk was seen, i.e.
+  ## the stream was not truncated. It is always false for legacy data which
+  ## cannot be verified.
+  not c.xChunkIsLegacy and c.final and not c.failed and c.buf.len == 0
+
+proc clearXChunk*(c: var XChunkCtx) =
+  ## clean up after the session has finished
+  c.x.clearXCrypt
+  if not c.buf.isNil and 0 < c.buf.len:
+    (addr c.buf[0]).zeroMem(c.buf.len)
+  c.buf = nil
+  (addr c).zeroMem(c.sizeof)
+
+# ----------------------------------------------------------------------------
+# Tests
+# ----------------------------------------------------------------------------
+
+when isMainModule:
+
+  var
+    prv: EccPrvKey
+    pub: EccPubKey
+    keys = [addr pub, nil, nil]
+    chl  = "Hello Chunks!".getXVerfier
+    text = newString(5000)
+
+  prv.getEccPrvKey
+  pub.getEccPubKey(addr prv)
+  for n in 0..<text.len:
+    text[n] = ((n * 13 + n div 256) and 255).chr
+
+  proc encrypt(s: string; chunkLen: int; step = 0): string =
+    var c: XChunkCtx
+    result = c.getXChunkEncrypt(addr keys, addr chl, chunkLen = chunkLen)
+    if step == 0:
+      result &= c.xChunkStreamEncrypt(s)
+    else:
+      var n = 0
+      while n < s.len:
+        result &= c.xChunkStreamEncrypt(s[n..<min(n + step, s.len)])
+        n.inc(step)
+    result &= c.xChunkStreamEncryptDone
+    c.clearXChunk
+
+  proc decrypt(s: string; ok: var bool; step = 0; legacy = false): string =
+    var
+      c: XChunkCtx
+      pre = c.getXChunkDecrypt(s, addr prv, addr chl, legacy)
+    doAssert 0 < pre
+    if step == 0:
+      result = c.xChunkStreamDecrypt(s[pre..<s.len])
+    else:
+      result = ""
+      var n = pre
+      while n < s.len:
+        result &= c.xChunkStreamDecrypt(s[n..<min(n + step, s.len)])
+        n.inc(step)
+    ok = c.xChunkStreamDecryptDone
+    c.clearXChunk
+
+  var ok: bool
+
+  # round trip, various chunk sizes and stream splits
+  for chunkLen in [1, 64, 1000, 5000, xChunkLen]:
+    for step in [0, 1, 77, 4096]:
+      if chunkLen == 1 and step == 1:
+        continue                                       # too slow
+      let enc = text.encrypt(chunkLen, step)
+      doAssert enc.len == xChunkHeaderLen +
+                 (text.len + chunkLen - 1) div chunkLen * xChunkOverhead +
+                 text.len
+      doAssert enc.decrypt(ok, step) == text and ok
+
+  # empty text, final frame only
+  block:
+    let enc = "".encrypt(100)
+    doAssert enc.len == xChunkHeaderLen + xChunkOverhead
+    doAssert enc.decrypt(ok) == "" and ok
+
+  # random access and tamper detection
+  block:
+    var
+      c: XChunkCtx
+      enc = text.encrypt(1000)
+      buf = newString(1000)
+    doAssert c.getXChunkDecrypt(enc, addr prv, addr chl) == xChunkHeaderLen
+    for index in [3, 0, 4, 1]:
+      let
+        pos = c.xChunkOffset(index)
+        n = xChunkFrameLen(1000)
+      doAssert c.xChunkDecryptAt(index, addr buf[0], addr enc[pos], n) == 1000
+      doAssert buf == text[index * 1000 ..< index * 1000 + 1000]
+      doAssert c.xChunkDecryptAt(index + 1, addr buf[0], addr enc[pos], n) < 0
+    doAssert xChunkIsFinal(addr enc[c.xChunkOffset(4)], 12)
+
+    for pos in [xChunkHeaderLen, xChunkHeaderLen + 8,
+                xChunkHeaderLen + 100, c.xChunkOffset(1) - 1]:
+      var bad = enc
+      bad[pos] = (bad[pos].ord xor 1).chr
+      doAssert bad.decrypt(ok) == "" and not ok      # first chunk invalid
+
+    for pos in [xRawHeaderLen, xChunkHeaderLen - 1]: # descriptor
+      var
+        d: XChunkCtx
+        bad = enc
+      bad[pos] = (bad[pos].ord xor 1).chr
+      doAssert d.getXChunkDecrypt(bad, addr prv, addr chl) == 0
+      doAssert d.getXChunkDecrypt(bad, addr prv, addr chl,
+                                  allowLegacy = true) == xRawHeaderLen
+      doAssert d.xChunkIsLegacy
+      discard d.xChunkStreamDecrypt(bad[xRawHeaderLen..<bad.len])
+      doAssert not d.xChunkStreamDecryptDone
+      d.clearXChunk
+
+    discard enc[0 ..< c.xChunkOffset(4)].decrypt(ok) # truncated
+    doAssert not ok
+
+    var swap = enc                                   # re-ordered
+    for n in 0..<xChunkFrameLen(1000):
+      swap[c.xChunkOffset(1) + n] = enc[c.xChunkOffset(2) + n]
+      swap[c.xChunkOffset(2) + n] = enc[c.xChunkOffset(1) + n]
+    doAssert swap.decrypt(ok) == text[0..<1000] and not ok
+    c.clearXChunk
+
+  # legacy raw session data are only readable on request
+  block:
+    var
+      c: XChunkCtx
+      x: XCryptCtx
+      enc = x.getXRawEncrypt(addr keys, addr chl) & x.xRawEncrypt(text)
+    x.clearXCrypt
+    doAssert enc.decrypt(ok, legacy = true) == text and not ok
+    doAssert c.getXChunkDecrypt(enc, addr prv, addr chl) == 0
+    doAssert c.getXChunkDecrypt(enc, addr prv, addr chl,
+                                allowLegacy = true) == xRawHeaderLen
+    doAssert c.xChunkIsLegacy
+    c.clearXChunk
+
+  # container for a list of recipients
+  block:
+    var
+      c, d: XChunkCtx
+      enc = c.getXChunkEncrypt([addr pub], addr chl, chunkLen = 1000)
+      hLen = enc.len
+    doAssert hLen == enc.xRawHeaderSize + 16
+    enc &= c.xChunkStreamEncrypt(text) & c.xChunkStreamEncryptDone
+    doAssert enc.decrypt(ok) == text and ok
+    doAssert d.getXChunkDecrypt(enc, addr prv, addr chl) == hLen
+    doAssert d.xChunkOffset(0) == hLen
+    c.clearXChunk
+    d.clearXChunk
+
+  when not defined(check_run):
+    echo "*** xchunk OK"
+
+# ----------------------------------------------------------------------------
+# End
+# ----------------------------------------------------------------------------
@@ -30,7 +30,9 @@
 ## or can be left raw.
 ##
 ## The scheme supports three key public slots so there are up to three
-## different private key holder destinations possible.
+## different private key holder destinations possible. Sessions for any
+## number of recipients can be started by passing an open array of public
+## keys instead.
 ##
 ## This software is ment to work on small systems using little
 ## system resources. It is not supposed to be used for serious security
@@ -167,18 +169,39 @@
 ##   defined for streams smaller than 2^70 bytes (no re-keying implemented
 ##   here).
 ##
+## * A session for a list of recipients uses the sessHdrMulti header from
+##   the 'sesskey' module. All slots share one ephemeral key, so the sender
+##   derives one session key per recipient while the receiver derives a
+##   single one and tries it on every slot. The header is padded with
+##   random bytes to full lines, its length is found with xRawHeaderSize()
+##   from the first line and returned by the decryption functions.
+##
+##   With the sessHdrHinted header, each slot carries the fingerprint of
+##   its public key. The receiver then decodes its own slot only, and a
+##   header not addressed to it is rejected without deriving a session key.
+##   This makes the recipients visible to anyone who knows their public
+##   keys.
+##
+## * Raw session data can be decrypted at any offset without running
+##   through the data before, see xRawSeek() and xRawDecryptAt(). This
+##   does not apply to base64 data where the number of line breaks and
+##   padded chunks before an offset is unknown.
+##
 
 import
-  base64, ecckey, rnd64, sesskey, strutils,
+  ecckey, rnd64, sesskey, strutils,
+  b64    / [b64],
   chacha / [chacha]
 
 export
-  ecckey
+  ecckey, SessHdrVersion, sessHdrLegacy, sessHdrX25519, sessHdrMulti,
+  sessHdrHinted, sessMultiMax
 
 const
   InLinelen  = 57
-  OutLineLen = 76
+  OutLineLen = b64LineLen
   OutLineBlk = 5 * OutLineLen
+  XChunkLen  = 8 * 64           # key stream generated in one go
   xIntroLen*     = InLinelen
   xRawHeaderLen* = 5 * InLinelen
 
@@ -190,6 +213,7 @@ type
   XPattern* = array[xIntroLen, int8] ## pattern for checking key validity
   XCryptCtx* = tuple                 ## stream cipher context
     ccc: ChaChaCtx
+    b64: B64State                    # base64 state carried between calls
 
   XCryptData = tuple
     nonce: SessNonce
@@ -198,67 +222,213 @@ type
     iLine: array[xIntroLen, uint8] # base64 sucks - crashes on int8 array
     oLine: array[xIntroLen, uint8]
 
+# ----------------------------------------------------------------------------
+# Private helpers
+# ----------------------------------------------------------------------------
+
+const
+  b64Alphabet = {'A'..'Z', 'a'..'z', '0'..'9', '+', '/'}
+
+proc b64HeaderEnd(b64: string; chars = OutLineBlk): int =
+  ## find the end of the line after the first 'chars' characters of a
+  ## base64 encoded header, returns 0 if there is none
+  var n = 0
+  for i in 0..<b64.len:
+    if n < chars:
+      if b64[i] in b64Alphabet:
+        n.inc
+    elif b64[i] == '\l':
+      return i + 1
+
+proc rawHeaderSize(bin: string): int =
+  ## session header padded to full lines plus the xpattern line
+  let n = bin.getSessHdrLen
+  if 0 < n:
+    result = (n + InLinelen - 1) div InLinelen * InLinelen + InLinelen
+
 # ----------------------------------------------------------------------------
 # Private functions
 # ----------------------------------------------------------------------------
 
-proc startXEncrypt(ctx: var XCryptCtx;
-                   xdt: var XCryptData;
-                   pub: ptr array[3,ptr EccPubKey];
-                   intro: ptr XPattern): string =
+proc doB64Encrypt(ctx: var XCryptCtx; st: var B64State;
+                  trg, src: pointer; n: int): int =
+  ## encrypt n bytes at src and write them base64 encoded to trg, lines of
+  ## OutLineLen characters separated by CRLF; up to two bytes are kept in
+  ## st. The key stream is generated a chunk at a time and XORed within
+  ## the encoder, so the cipher text is never stored. Returns the number of
+  ## characters written.
+  var
+    ks: array[XChunkLen, uint8]
+    d = cast[ByteAddress](trg)
+    s = cast[ByteAddress](src)
+    m = n
+  while 0 < m:
+    let k = min(m, ks.len)
+    chachaKeyStream(ctx.ccc, addr ks[0], k)
+    d.inc(st.b64EncodeXor(cast[pointer](d), cast[pointer](s), addr ks[0], k))
+    s.inc(k)
+    m.dec(k)
+  (addr ks).zeroMem(ks.sizeof)
+  result = d - cast[ByteAddress](trg)
+
+proc doB64Encrypt(ctx: var XCryptCtx; trg, src: pointer; n: int): int =
+  ## same as doB64Encrypt() above for a complete text, i.e. the last quad
+  ## is padded; returns xB64EncryptLen(n)
+  var st: B64State
+  result = ctx.doB64Encrypt(st, trg, src, n)
+  result.inc(st.b64EncodeDone(cast[pointer](cast[ByteAddress](trg) + result)))
+
+proc doB64Decrypt(ctx: var XCryptCtx; st: var B64State;
+                  trg, src: pointer; n: int): int =
+  ## decode n base64 characters at src into trg and decrypt them in place,
+  ## a chunk at a time while it is still in the L1 cache (the length of the
+  ## decoded chunk, hence of the key stream is known only afterwards); an
+  ## incomplete quad is kept in st. Returns the number of bytes written, at
+  ## most xB64DecryptLen(n + 3).
+  var
+    d = cast[ByteAddress](trg)
+    s = cast[ByteAddress](src)
+    m = n
+  while 0 < m:
+    let
+      k = min(m, 4 * XChunkLen div 3)
+      r = st.b64Decode(cast[pointer](d), cast[pointer](s), k)
+    if 0 < r:
+      chachaAnyCrypt(ctx.ccc, cast[pointer](d), cast[pointer](d), r)
+    d.inc(r)
+    s.inc(k)
+    m.dec(k)
+  result = d - cast[ByteAddress](trg)
+
+proc doB64Decrypt(ctx: var XCryptCtx; trg, src: pointer; n: int): int =
+  ## same as doB64Decrypt() above for a complete text, at most
+  ## xB64DecryptLen(n) bytes are written
+  var st: B64State
+  result = ctx.doB64Decrypt(st, trg, src, n)
+  let
+    d = cast[pointer](cast[ByteAddress](trg) + result)
+    r = st.b64DecodeDone(d)
+  if 0 < r:
+    chachaAnyCrypt(ctx.ccc, d, d, r)
+  result.inc(r)
+
+proc appendIntro(ctx: var XCryptCtx;
+                 xdt: var XCryptData;
+                 hdr: var string;
+                 intro: ptr XPattern) =
+  ## start the cipher and append the encrypted xpattern line to the header
   var
     kPtr = cast[ptr ChaChaKey](addr xdt.key[0])
     nPtr = cast[ptr ChaChaIV](addr xdt.nonce)
+    hLen = hdr.len
 
-  result = xdt.key[0].getRawSessHeader(xdt.nonce,pub) # session parameters
+  (addr ctx.b64).zeroMem(ctx.b64.sizeof)              # no base64 carry
 
-  for n, w in rnd8items(xdt.oLine.len):               # first output line
-    if intro[n] == 0:                                 # generated by pattern
-      xdt.iLine[n] = w.uint8
-    else:
+  xdt.iLine.rnd64Fill                                 # first output line
+  for n in 0..<xdt.iLine.len:                         # generated by pattern
+    if intro[n] != 0:
       xdt.iLine[n] = intro[n].uint8
 
   getChaCha(ctx.ccc, kPtr, nPtr)
   chachaAnyCrypt(ctx.ccc, addr xdt.oLine, addr xdt.iLine, InLinelen)
 
   # append xpattern line
-  result.setLen(5 * InLinelen)
-  (addr result[4 * InLinelen]).copyMem(addr xdt.oLine[0], InLinelen)
+  hdr.setLen(hLen + InLinelen)
+  (addr hdr[hLen]).copyMem(addr xdt.oLine[0], InLinelen)
 
+proc startXEncrypt(ctx: var XCryptCtx;
+                   xdt: var XCryptData;
+                   pub: ptr array[3,ptr EccPubKey];
+                   intro: ptr XPattern;
+                   version: SessHdrVersion): string =
+  result = xdt.key[0].getRawSessHeader(xdt.nonce,     # session parameters
+                                       pub, version)
+  ctx.appendIntro(xdt, result, intro)
 
-proc startXDecrypt(ctx: var XCryptCtx;
+proc startXEncrypt(ctx: var XCryptCtx;
                    xdt: var XCryptData;
-                   hdr: string;
-                   prv: ptr EccPrvKey; vfy: ptr XPattern): bool =
+                   pub: openArray[ptr EccPubKey];
+                   intro: ptr XPattern;
+                   version: SessHdrVersion): string =
+  result = xdt.key[0].getRawSessHeader(xdt.nonce,     # session parameters
+                                       pub, version)
+  let
+    hLen = result.len
+    pLen = (hLen + InLinelen - 1) div InLinelen * InLinelen
+  if hLen < pLen:                                     # fill up the last
+    result.setLen(pLen)                               # base64 line
+    rnd64Fill(addr result[hLen], pLen - hLen)
+  ctx.appendIntro(xdt, result, intro)
+
+
+proc tryXDecrypt(ctx: var XCryptCtx;
+                 xdt: var XCryptData;
+                 keys: openArray[SessKey];
+                 line: pointer;
+                 vfy: ptr XPattern): bool =
   var
     zero: SessKey                                     # compare key == zero
     nPtr = cast[ptr ChaChaIV](addr xdt.nonce)
 
-  if InLinelen <= 5 * hdr.len:
-    xdt.prv[0] = prv
-    xdt.prv[1] = prv
-    xdt.prv[2] = prv
+  # try for each key to decrypt the challenge data
+  for n in 0..<keys.len:
+    if keys[n] == zero:                               # ignore zero key slot
+      continue
 
-    # extract keys from stream header
-    xdt.key.extrRawSessMsg(xdt.nonce, hdr, addr xdt.prv)
+    # decrypt challenge with current key
+    var kPtr = cast[ptr ChaChaKey](unsafeAddr keys[n])
+    getChaCha(ctx.ccc, kPtr, nPtr)                    # try key for decryption
+    chachaAnyCrypt(ctx.ccc, addr xdt.oLine, line, InLinelen) # decrypt line
 
-    # try for each key to decrypt the challenge data
-    for n in 0..<xdt.key.len:
-      if xdt.key[n] == zero:                          # ignore zero key slot
-        continue
+    block verify:
+      for n in 0..<xdt.oLine.len:                     # check verifier pattern
+        if vfy[n] != 0 and xdt.oLine[n] != vfy[n].uint8:
+          break verify
+      return true                                     # found matching key
+      # end block verify
 
-      # decrypt challenge with current key
-      var kPtr = cast[ptr ChaChaKey](addr xdt.key[n])
-      getChaCha(ctx.ccc, kPtr, nPtr)                  # try key for decryption
-      chachaAnyCrypt(ctx.ccc, addr xdt.oLine,         # decrypt line
-                     unsafeAddr hdr[4 * InLinelen], InLinelen)
+proc tryXDecrypt(ctx: var XCryptCtx;
+                 xdt: var XCryptData;
+                 hdr: string;
+                 vfy: ptr XPattern; version: SessHdrVersion): bool =
+  # extract keys from stream header
+  xdt.key.extrRawSessMsg(xdt.nonce, hdr, addr xdt.prv, version)
+  ctx.tryXDecrypt(xdt, xdt.key, unsafeAddr hdr[4 * InLinelen], vfy)
 
-      block verify:
-        for n in 0..<xdt.oLine.len:                   # check verifier pattern
-          if vfy[n] != 0 and xdt.oLine[n] != vfy[n].uint8:
-            break verify
-        return true                                   # found matching key
-        # end block verify
+
+proc startXDecrypt(ctx: var XCryptCtx;
+                   xdt: var XCryptData;
+                   hdr: string;
+                   prv: ptr EccPrvKey; vfy: ptr XPattern;
+                   fpr: ptr EccFingerprint): int =
+  ## returns the header length if the key matches, or 0
+  let hLen = hdr.rawHeaderSize
+
+  (addr ctx.b64).zeroMem(ctx.b64.sizeof)              # no base64 carry
+
+  if 0 < hLen and hLen <= hdr.len:
+    if hdr.getSessHdrVersion in {sessHdrMulti, sessHdrHinted}:
+      var keys: seq[SessKey]
+      keys.extrRawSessMsg(xdt.nonce, hdr, prv, fpr)   # one S(p,W) for all
+      let ok = ctx.tryXDecrypt(xdt, keys,
+                               unsafeAddr hdr[hLen - InLinelen], vfy)
+      if 0 < keys.len:
+        (addr keys[0]).zeroMem(keys.len * SessKey.sizeof)
+      if ok:
+        return hLen
+
+    else:
+      xdt.prv[0] = prv
+      xdt.prv[1] = prv
+      xdt.prv[2] = prv
+
+      # a tagged header is most likely an X25519 one, fall back to the
+      # legacy format if the verifier does not match
+      if hdr.getSessHdrVersion == sessHdrX25519 and
+         ctx.tryXDecrypt(xdt, hdr, vfy, sessHdrX25519):
+        return hLen
+      if ctx.tryXDecrypt(xdt, hdr, vfy, sessHdrLegacy):
+        return hLen
 
     (addr ctx).zeroMem(ctx.sizeof)                    # clean up key
     # end if
@@ -267,6 +437,22 @@ proc startXDecrypt(ctx: var XCryptCtx;
 # Public functions
 # ----------------------------------------------------------------------------
 
+proc xRawHeaderSize*(bin: string): int {.inline.} =
+  ## Length of the raw session header starting with 'bin', i.e.
+  ## xRawHeaderLen for headers with three key slots, or the size of a
+  ## header with any number of recipients from getXRawEncrypt(). At least
+  ## the first 8 header bytes are needed, 0 is returned if 'bin' is shorter.
+  bin.rawHeaderSize
+
+proc xB64EncryptLen*(n: int): int =
+  ## the number of characters xB64Encrypt() produces for n bytes of data
+  b64EncodeLen(n)
+
+proc xB64DecryptLen*(n: int): int =
+  ## an upper bound for the number of bytes xB64Decrypt() produces for n
+  ## base64 characters
+  b64DecodeLen(n)
+
 proc getXVerfier*(s = "HELLO WORLD"): XPattern =
   ## creates a key validity checker needed for the instantiation
   ## session protocol
@@ -280,63 +466,127 @@ proc getXVerfier*(s = "HELLO WORLD"): XPattern =
 
 proc getXB64Encrypt*(ctx: var XCryptCtx;
                      pub: ptr array[3,ptr EccPubKey];
-                     challenge: ptr XPattern): string =
+                     challenge: ptr XPattern;
+                     version = sessHdrLegacy): string =
   ## Start a new encryption session. It returns a base64 encoded text
-  ## header, the initial part of the cipher data stream.
+  ## header, the initial part of the cipher data stream. The session header
+  ## format 'version' sessHdrX25519 is cheaper to create and to decode but
+  ## cannot be read by older versions of this module; the decryption
+  ## functions detect the format on their own.
   var xdt: XCryptData
-  result = ctx.startXEncrypt(xdt, pub, challenge).encode
-
-  if result[result.len-1] != '\l':                   # make sure message
-    result &= "\r\l"                                 # terminates with CRLF
+  result = ctx.startXEncrypt(xdt, pub, challenge, version).b64Encode
+  result &= "\r\l"                                   # terminate with CRLF
   (addr xdt).zeroMem(xdt.sizeof)                     # clear key data
 
 
 proc getXRawEncrypt*(ctx: var XCryptCtx;
                      pub: ptr array[3,ptr EccPubKey];
-                     challenge: ptr XPattern): string =
+                     challenge: ptr XPattern;
+                     version = sessHdrLegacy): string =
   ## same as getXB64Encrypt() but returns binary instead of base64 data
   var xdt: XCryptData
-  result = ctx.startXEncrypt(xdt, pub, challenge)
+  result = ctx.startXEncrypt(xdt, pub, challenge, version)
+  (addr xdt).zeroMem(xdt.sizeof)                     # clear key data
+
+
+proc getXB64Encrypt*(ctx: var XCryptCtx;
+                     pub: openArray[ptr EccPubKey];
+                     challenge: ptr XPattern;
+                     version = sessHdrMulti): string =
+  ## Start a new encryption session for any number of recipients (at least
+  ## one, none of the keys nil.) The session header has the sessHdrMulti
+  ## or sessHdrHinted 'version' format, it is padded to full base64 lines
+  ## and can be read only by the current version of this module.
+  var xdt: XCryptData
+  result = ctx.startXEncrypt(xdt, pub, challenge, version).b64Encode
+  result &= "\r\l"                                   # terminate with CRLF
+  (addr xdt).zeroMem(xdt.sizeof)                     # clear key data
+
+
+proc getXRawEncrypt*(ctx: var XCryptCtx;
+                     pub: openArray[ptr EccPubKey];
+                     challenge: ptr XPattern;
+                     version = sessHdrMulti): string =
+  ## same as getXB64Encrypt() but returns binary instead of base64 data, the
+  ## header length is xRawHeaderSize()
+  var xdt: XCryptData
+  result = ctx.startXEncrypt(xdt, pub, challenge, version)
   (addr xdt).zeroMem(xdt.sizeof)                     # clear key data
 
 
+proc xB64HeaderDecode*(b64: string; bin: var string): int =
+  ## Decode the session header lines at the start of the base64 encoded
+  ## cipher data stream 'b64' into 'bin'. It returns the number of
+  ## characters consumed, or zero if the header is incomplete.
+  var inx = b64.b64HeaderEnd(OutLineLen)             # end of first line
+  if 0 < inx:                                        # get header size
+    bin = newString(xB64DecryptLen(inx))
+    bin.setLen(b64Decode(addr bin[0], unsafeAddr b64[0], inx))
+    let size = bin.rawHeaderSize
+    inx = if 0 < size: b64.b64HeaderEnd(size div InLinelen * OutLineLen)
+          else: 0                                    # end of header lines
+
+    if 0 < inx:
+      bin.setLen(xB64DecryptLen(inx))
+      bin.setLen(b64Decode(addr bin[0], unsafeAddr b64[0], inx))
+      result = inx
+
+
 proc getXB64Decrypt*(ctx: var XCryptCtx;
                      b64: string;
                      prv: ptr EccPrvKey;
-                     challenge: ptr XPattern): int =
+                     challenge: ptr XPattern;
+                     fpr: ptr EccFingerprint = nil): int =
   ## Start a decryption session by decoding the base 64encoded header of
-  ## the cipher data stream. It returns the length consumed.
+  ## the cipher data stream. It returns the length consumed. Only the header
+  ## lines are decoded, pass the result as start offset to xB64Decrypt().
+  ## The fingerprint 'fpr' of the public key for 'prv' saves deriving it
+  ## for a sessHdrHinted header (optional.)
   var
     xdt: XCryptData
-    data = b64.decode
+    data: string
+    inx = b64.xB64HeaderDecode(data)
 
-  if ctx.startXDecrypt(xdt, data, prv, challenge):
-
-    # find end of base64 encoded block (format considerations apply)
-    var inx = b64.find('\l', start = OutLineBlk)
-    if 0 < inx:
-      result = 1 + inx                               # found matching key
-    else:
-      (addr ctx).zeroMem(ctx.sizeof)                 # reset key material
+  if 0 < inx and 0 < ctx.startXDecrypt(xdt, data, prv, challenge, fpr):
+    result = inx                                     # found matching key
 
   (addr xdt).zeroMem(xdt.sizeof)                     # clear key data
 
 
 proc getXRawDecrypt*(ctx: var XCryptCtx;
                      bin: string;
-                     prv: ptr EccPrvKey; challenge: ptr XPattern): int =
+                     prv: ptr EccPrvKey; challenge: ptr XPattern;
+                     fpr: ptr EccFingerprint = nil): int =
   ## same as getXB64Decrypt() but for binary header data instead of base64
   var xdt: XCryptData
-  if ctx.startXDecrypt(xdt, bin, prv, challenge):
-    result = 5 * InLinelen
+  result = ctx.startXDecrypt(xdt, bin, prv, challenge, fpr)
   (addr xdt).zeroMem(xdt.sizeof)                     # clear key data
 
 
 proc xB64Encrypt*(ctx: var XCryptCtx; p: pointer; n: int): string {.inline.} =
   ## encrypt next base64 session data
-  var buf = newString(n)
-  chachaAnyCrypt(ctx.ccc, addr buf[0], p, n)
-  result = buf.encode
+  result = newString(xB64EncryptLen(n))
+  if 0 < n:
+    discard ctx.doB64Encrypt(addr result[0], p, n)
+
+proc xB64Encrypt*(ctx: var XCryptCtx;
+                  trg: pointer; trgLen: int; src: pointer; n: int): int =
+  ## encrypt next base64 session data into the caller buffer trg of size
+  ## trgLen. Returns the number of characters written, or -1 (and nothing
+  ## is encrypted) if trgLen is smaller than xB64EncryptLen(n).
+  if trgLen < xB64EncryptLen(n):
+    return -1
+  ctx.doB64Encrypt(trg, src, n)
+
+proc xB64Encrypt*(ctx: var XCryptCtx;
+                  trg: var openArray[char]; src: openArray[uint8]): int =
+  ## same as xB64Encrypt() above for an array of bytes, the result is
+  ## written to trg
+  if src.len == 0:
+    return 0
+  if trg.len < xB64EncryptLen(src.len):
+    return -1
+  ctx.doB64Encrypt(addr trg[0], unsafeAddr src[0], src.len)
 
 proc xB64Encrypt*(ctx: var XCryptCtx; s: string): string =
   ## encrypt next base64 session data
@@ -350,11 +600,49 @@ proc xRawEncrypt*(ctx: var XCryptCtx; p: pointer; n: int): string {.inline.} =
 proc xRawEncrypt*(ctx: var XCryptCtx; s: string): string =
   ctx.xRawEncrypt(unsafeAddr s[0], s.len)
 
+proc xRawEncrypt*(ctx: var XCryptCtx;
+                  trg: var openArray[uint8]; src: openArray[uint8]): int =
+  ## encrypt binary session data into the caller buffer trg, returns the
+  ## number of bytes written or -1 if trg is smaller than src
+  if trg.len < src.len:
+    return -1
+  if 0 < src.len:
+    chachaAnyCrypt(ctx.ccc, addr trg[0], unsafeAddr src[0], src.len)
+  src.len
+
+
+proc xB64Decrypt*(ctx: var XCryptCtx; b64Enc: string; start: int): string =
+  ## decrypt base64 session data starting at b64Enc[start], typically with
+  ## the result of getXB64Decrypt() as start offset; this saves copying the
+  ## payload off the header
+  result = ""
+  if start < b64Enc.len:
+    result = newString(xB64DecryptLen(b64Enc.len - start))
+    result.setLen(ctx.doB64Decrypt(addr result[0], unsafeAddr b64Enc[start],
+                                   b64Enc.len - start))
 
 proc xB64Decrypt*(ctx: var XCryptCtx; b64Enc: string): string {.inline.} =
   ## decrypt base64 session data
-  result = b64Enc.decode
-  chachaAnyCrypt(ctx.ccc, addr result[0], addr result[0], result.len)
+  ctx.xB64Decrypt(b64Enc, 0)
+
+proc xB64Decrypt*(ctx: var XCryptCtx;
+                  trg: pointer; trgLen: int; src: pointer; n: int): int =
+  ## decrypt n characters of base64 session data at src into the caller
+  ## buffer trg of size trgLen. Returns the number of bytes written, or -1
+  ## (and nothing is decrypted) if trgLen is smaller than xB64DecryptLen(n).
+  if trgLen < xB64DecryptLen(n):
+    return -1
+  ctx.doB64Decrypt(trg, src, n)
+
+proc xB64Decrypt*(ctx: var XCryptCtx;
+                  trg: var openArray[uint8]; src: openArray[char]): int =
+  ## same as xB64Decrypt() above for an array of characters, the result is
+  ## written to trg
+  if src.len == 0:
+    return 0
+  if trg.len < xB64DecryptLen(src.len):
+    return -1
+  ctx.xB64Decrypt(addr trg[0], trg.len, unsafeAddr src[0], src.len)
 
 proc xRawDecrypt*(ctx: var XCryptCtx; p: pointer; n: int): string {.inline.} =
   ## decrypt binary session data
@@ -365,6 +653,110 @@ proc xRawDecrypt*(ctx: var XCryptCtx; trg, src: pointer; n: int) {.inline.} =
   ## decrypt binary session data
   chachaAnyCrypt(ctx.ccc, trg, src, n)
 
+proc xRawDecrypt*(ctx: var XCryptCtx;
+                  trg: var openArray[uint8]; src: openArray[uint8]): int =
+  ## decrypt binary session data into the caller buffer trg, returns the
+  ## number of bytes written or -1 if trg is smaller than src
+  ctx.xRawEncrypt(trg, src)                   # same as xRawEncrypt()
+
+proc xRawEncryptParallel*(ctx: var XCryptCtx; p: pointer; n: int): string =
+  ## Same as xRawEncrypt() using a pool of worker threads for large data,
+  ## the result is the same. See xParallelSetup() for the number of
+  ## threads and the minimum size.
+  result = newString(n)
+  if 0 < n:
+    chachaParallelCrypt(ctx.ccc, addr result[0], p, n)
+
+proc xRawEncryptParallel*(ctx: var XCryptCtx; s: string): string =
+  ctx.xRawEncryptParallel(unsafeAddr s[0], s.len)
+
+proc xRawEncryptParallel*(ctx: var XCryptCtx;
+                          trg: var openArray[uint8];
+                          src: openArray[uint8]): int =
+  ## same as xRawEncrypt() into a caller buffer, using worker threads
+  if trg.len < src.len:
+    return -1
+  if 0 < src.len:
+    chachaParallelCrypt(ctx.ccc, addr trg[0], unsafeAddr src[0], src.len)
+  src.len
+
+proc xRawDecryptParallel*(ctx: var XCryptCtx; p: pointer; n: int): string =
+  ## Same as xRawDecrypt() using a pool of worker threads for large data
+  ctx.xRawEncryptParallel(p, n)               # same as xRawEncrypt()
+
+proc xRawDecryptParallel*(ctx: var XCryptCtx; trg, src: pointer; n: int) =
+  ## decrypt binary session data in place or into a caller buffer
+  chachaParallelCrypt(ctx.ccc, trg, src, n)
+
+proc xParallelSetup*(threads = 0; threshold = chachaParallelMin) =
+  ## Set the number of threads used by the xRaw*Parallel() functions
+  ## including the caller (0 for the number of CPUs, 1 for no threads) and
+  ## the data size below which the data are processed serially.
+  chachaParallelSetup(threads, threshold)
+
+proc xRawSeek*(ctx: var XCryptCtx; offset: int|uint64) =
+  ## Set the raw session data position to byte 'offset' of the payload
+  ## (i.e. counted from the end of the session header) so the next
+  ## xRawDecrypt() or xRawEncrypt() starts there. This takes constant
+  ## time, independent of the offset which must not be negative.
+  when offset is int:
+    doAssert 0 <= offset
+  chachaSeek(ctx.ccc, InLinelen.uint64 + offset.uint64) # after verifier line
+
+proc xRawDecryptAt*(ctx: var XCryptCtx;
+                    offset: int|uint64; trg, src: pointer; n: int) =
+  ## decrypt the n bytes at src which were found at byte 'offset' of the
+  ## payload, e.g. for a ranged read of an encrypted file. The position
+  ## is left after the decrypted bytes.
+  ctx.xRawSeek(offset)
+  chachaAnyCrypt(ctx.ccc, trg, src, n)
+
+proc xRawDecryptAt*(ctx: var XCryptCtx; offset: int|uint64; s: string): string =
+  ## same as xRawDecryptAt() above for a string argument
+  result = newString(s.len)
+  if 0 < s.len:
+    ctx.xRawDecryptAt(offset, addr result[0], unsafeAddr s[0], s.len)
+
+
+proc xB64StreamEncrypt*(ctx: var XCryptCtx; p: pointer; n: int): string =
+  ## Encrypt the next part of a base64 encoded stream. Unlike xB64Encrypt(),
+  ## up to two bytes are carried over to the next call rather than padded,
+  ## and the output is one continuous text of 76 column lines. So the parts
+  ## can be of any size, e.g. network reads. Finish the stream with
+  ## xB64StreamEncryptDone().
+  let q = (ctx.b64.nCarry.int + n) div 3                # number of quads
+  result = newString(4 * q + 2 * (q div (OutLineLen div 4) + 1))
+  result.setLen(ctx.doB64Encrypt(ctx.b64, addr result[0], p, n))
+
+proc xB64StreamEncrypt*(ctx: var XCryptCtx; s: string): string =
+  ## same as xB64StreamEncrypt() above for a string argument
+  ctx.xB64StreamEncrypt(unsafeAddr s[0], s.len)
+
+proc xB64StreamEncryptDone*(ctx: var XCryptCtx): string =
+  ## finish a base64 stream started with xB64StreamEncrypt(), returns the
+  ## padded last characters (if any)
+  result = newString(6)
+  result.setLen(ctx.b64.b64EncodeDone(addr result[0]))
+
+proc xB64StreamDecrypt*(ctx: var XCryptCtx; p: pointer; n: int): string =
+  ## Decrypt the next part of a base64 encoded stream of any size. A partial
+  ## quad of characters is carried over to the next call, and line breaks
+  ## may appear anywhere. Finish the stream with xB64StreamDecryptDone().
+  result = newString(xB64DecryptLen(n + 3))
+  result.setLen(ctx.doB64Decrypt(ctx.b64, addr result[0], p, n))
+
+proc xB64StreamDecrypt*(ctx: var XCryptCtx; s: string): string =
+  ## same as xB64StreamDecrypt() above for a string argument
+  ctx.xB64StreamDecrypt(unsafeAddr s[0], s.len)
+
+proc xB64StreamDecryptDone*(ctx: var XCryptCtx): string =
+  ## finish a base64 stream passed to xB64StreamDecrypt(), returns the bytes
+  ## of an unpadded last quad (if any)
+  result = newString(2)
+  result.setLen(ctx.b64.b64DecodeDone(addr result[0]))
+  if 0 < result.len:
+    chachaAnyCrypt(ctx.ccc, addr result[0], addr result[0], result.len)
+
 proc clearXCrypt*(ctx: var XCryptCtx) {.inline.} =
   ## clean up after session has finished
   (addr ctx).zeroMem(ctx.sizeof)
@@ -429,7 +821,7 @@ when isMainModule:
     var pre = getXB64Decrypt(oCtx, data, addr prv, addr pat)
     doAssert 0 < pre
 
-    var msg = oCtx.xB64Decrypt(data[pre..<data.len])
+    var msg = oCtx.xB64Decrypt(data, pre)
     for n in 0..nLoop:
       var a = msg[0..<text.len]
       msg   = msg[text.len..<data.len]
@@ -455,6 +847,170 @@ when isMainModule:
       doAssert a == text
     doAssert msg == ""
 
+  # X25519 session header version, detected by the decoder
+  if true:
+    var data = iCtx.getXB64Encrypt(addr pba, addr pat, sessHdrX25519)
+    data &= iCtx.xB64Encrypt(text)
+
+    var pre = getXB64Decrypt(oCtx, data, addr prv, addr pat)
+    doAssert 0 < pre
+    doAssert oCtx.xB64Decrypt(data[pre..<data.len]) == text
+
+  # padded chunks and line breaks in the middle of the payload
+  if true:
+    var data = iCtx.getXB64Encrypt(addr pba, addr pat)
+    for n in 1..4:
+      data &= iCtx.xB64Encrypt(text[0..<n]) & "\r\l"
+
+    var pre = getXB64Decrypt(oCtx, data, addr prv, addr pat)
+    doAssert 0 < pre
+    doAssert oCtx.xB64Decrypt(data, pre) == text[0..<1] & text[0..<2] &
+                                            text[0..<3] & text[0..<4]
+    doAssert getXB64Decrypt(oCtx, data[0..<300], addr prv, addr pat) == 0
+
+  # caller buffers, compared against the string functions
+  if true:
+    var
+      jCtx: XCryptCtx
+      small: array[3,uint8]
+      src = newSeq[uint8](3 * InLinelen + 7)
+      raw = newSeq[uint8](src.len)
+      b64 = newString(xB64EncryptLen(src.len))
+      bin = newSeq[uint8](xB64DecryptLen(b64.len))
+      data = iCtx.getXB64Encrypt(addr pba, addr pat)
+    for n in 0..<src.len:
+      src[n] = (n * 7).uint8
+    doAssert 0 < getXB64Decrypt(jCtx, data, addr prv, addr pat)
+
+    var chunk = iCtx.xB64Encrypt(addr src[0], src.len)
+    doAssert chunk.len == xB64EncryptLen(src.len)
+    doAssert chunk.split("\r\l")[0].len == OutLineLen
+    doAssert chunk.b64Decode.len == src.len
+
+    doAssert jCtx.xB64Decrypt(bin, chunk) == src.len
+    doAssert bin[0..<src.len] == src
+    doAssert jCtx.xB64Decrypt(small, chunk) == -1
+
+    doAssert jCtx.xB64Encrypt(b64, src) == b64.len   # same key stream as
+    doAssert b64 == iCtx.xB64Encrypt(addr src[0], src.len)  # iCtx now
+    doAssert jCtx.xRawEncrypt(raw, src) == src.len
+    doAssert raw.mapIt(it.char).join == iCtx.xRawEncrypt(addr src[0], src.len)
+
+  # encrypting on the fly over several key stream chunks gives the base64
+  # encoded raw cipher text
+  if true:
+    var
+      jCtx, kCtx: XCryptCtx
+      data = iCtx.getXB64Encrypt(addr pba, addr pat)
+      big = text.repeat(9)
+    doAssert XChunkLen < big.len
+    doAssert 0 < getXB64Decrypt(jCtx, data, addr prv, addr pat)
+    doAssert 0 < getXB64Decrypt(kCtx, data, addr prv, addr pat)
+
+    var b64 = iCtx.xB64Encrypt(big)
+    doAssert b64 == jCtx.xRawEncrypt(big).b64Encode
+    doAssert kCtx.xB64Decrypt(b64) == big
+
+  # parallel encryption gives the same as serial
+  if true:
+    var
+      jCtx, kCtx: XCryptCtx
+      data = iCtx.getXRawEncrypt(addr pba, addr pat)
+      big = text.repeat(600)
+    doAssert 0 < jCtx.getXRawDecrypt(data, addr prv, addr pat)
+    doAssert 0 < kCtx.getXRawDecrypt(data, addr prv, addr pat)
+    xParallelSetup(3, 1024)
+
+    var enc = iCtx.xRawEncryptParallel(big)
+    doAssert enc == jCtx.xRawEncrypt(big)
+    kCtx.xRawDecryptParallel(addr enc[0], addr enc[0], enc.len)
+    doAssert enc == big
+    xParallelSetup()
+
+  # random access to raw session data
+  if true:
+    var
+      jCtx: XCryptCtx
+      data = iCtx.getXRawEncrypt(addr pba, addr pat)
+      big = text.repeat(5)
+      enc = iCtx.xRawEncrypt(big)
+      pre = jCtx.getXRawDecrypt(data, addr prv, addr pat)
+    doAssert 0 < pre
+
+    for pos in [big.len - 1, 0, 1, 7, 63, 64, 1000, 6, big.len div 2]:
+      let n = min(big.len - pos, 150)
+      doAssert jCtx.xRawDecryptAt(pos, enc[pos..<pos+n]) == big[pos..<pos+n]
+
+    jCtx.xRawSeek(100)                              # continue after seek
+    doAssert jCtx.xRawDecrypt(addr enc[100], 10) == big[100..<110]
+    doAssert jCtx.xRawDecrypt(addr enc[110], 10) == big[110..<120]
+
+  # base64 streams in odd sized parts give the same text as one call
+  if true:
+    var
+      jCtx, kCtx: XCryptCtx
+      data = iCtx.getXB64Encrypt(addr pba, addr pat)
+      b64 = ""
+      txt = ""
+      pos = 0
+    doAssert 0 < getXB64Decrypt(jCtx, data, addr prv, addr pat)
+    doAssert 0 < getXB64Decrypt(kCtx, data, addr prv, addr pat)
+
+    for n in [1, 5, 0, 100, 2, 3, 4000]:
+      var part = text[min(pos,text.len)..<min(pos+n,text.len)]
+      b64 &= jCtx.xB64StreamEncrypt(part)
+      pos.inc(n)
+    b64 &= jCtx.xB64StreamEncryptDone
+    doAssert b64 == kCtx.xB64Encrypt(text)
+
+    pos = 0                                      # iCtx has the same key
+    for n in [7, 1, 77, 2, 2, 6000]:             # stream as jCtx here
+      var part = b64[min(pos,b64.len)..<min(pos+n,b64.len)]
+      txt &= iCtx.xB64StreamDecrypt(part)
+      pos.inc(n)
+    txt &= iCtx.xB64StreamDecryptDone
+    doAssert txt == text
+
+  # any number of recipients, each one can read the session
+  if true:
+    var
+      mPrv: array[5,EccPrvKey]
+      mPub: array[5,EccPubKey]
+      mPba: array[5,ptr EccPubKey]
+    for n in 0..<mPrv.len:
+      mPrv[n].getEccPrvKey
+      mPub[n].getEccPubKey(addr mPrv[n])
+      mPba[n] = addr mPub[n]
+    mPba[4] = addr pub
+
+    for version in [sessHdrMulti, sessHdrHinted]:
+      for m in [1, 2, 5]:
+        var
+          data = iCtx.getXRawEncrypt(mPba[5-m..4], addr pat, version)
+          hLen = data.len
+        data &= iCtx.xRawEncrypt(text)
+        doAssert hLen mod InLinelen == 0
+        doAssert hLen == data.xRawHeaderSize
+        doAssert hLen ==
+                 (sessMultiHdrLen(m, version) div InLinelen + 2) * InLinelen
+
+        var b64 = iCtx.getXB64Encrypt(mPba[5-m..4], addr pat, version)
+        b64 &= iCtx.xB64Encrypt(text)
+
+        for n in 5-m..<5:
+          var key = if n == 4: addr prv else: addr mPrv[n]
+          doAssert oCtx.getXRawDecrypt(data, key, addr pat) == hLen
+          doAssert oCtx.xRawDecrypt(addr data[hLen], text.len) == text
+
+          var pre = getXB64Decrypt(oCtx, b64, key, addr pat)
+          doAssert 0 < pre
+          doAssert oCtx.xB64Decrypt(b64, pre) == text
+
+        if m < 5:                                      # not a recipient
+          doAssert oCtx.getXRawDecrypt(data, addr mPrv[0], addr pat) == 0
+          doAssert getXB64Decrypt(oCtx, b64, addr mPrv[0], addr pat) == 0
+        doAssert oCtx.getXRawDecrypt(data[0..<hLen-1], addr prv, addr pat) == 0
+
 #  when not defined(check_run):
 #    echo "*** not yet"
 
@@ -0,0 +1,313 @@
+# -*- nim -*-
+#
+# $Id$
+#
+# Copyright (c) 2017 Jordan Hrycaj <jordan@teddy-net.com>
+# All rights reserved.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# The author or authors of this code dedicate any and all copyright interest
+# in this code to the public domain. We make this dedication for the benefit
+# of the public at large and to the detriment of our heirs and successors.
+# We intend this dedication to be an overt act of relinquishment in
+# perpetuity of all present and future rights to this code under copyright
+# law.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+#
+#
+## This module encrypts and decrypts files with the raw session format of
+## the 'xcrypt' module, i.e. the output file is the raw session header
+## followed by the raw cipher data. The files are memory mapped a window
+## at a time and the data are en/decrypted straight from the input window
+## into the output window (using the worker threads of
+## xRawEncryptParallel() for large windows.) So the memory used stays the
+## same regardless of the file size.
+##
+## Example:
+##
+## .. code-block::
+##
+##    import
+##      xfile
+##
+##    var
+##      prvKey: EccPrvKey
+##      pubKey: EccPubKey
+##      keys = [addr pubKey, nil, nil]
+##      chl  = getXVerfier()
+##
+##    prvKey.getEccPrvKey
+##    pubKey.getEccPubKey(addr prvKey)
+##
+##    doAssert xFileEncrypt("archive.log", "archive.xcr", addr keys, addr chl)
+##    doAssert xFileDecrypt("archive.xcr", "archive.out", addr prvKey, addr chl)
+##
+
+import
+  memfiles, os, xcrypt
+
+export
+  xcrypt
+
+when defined(posix):
+  import posix
+
+const
+  xFileWindow* = 16 * 1024 * 1024 ## bytes mapped at a time (in and out)
+  xFileAlign   = 64 * 1024         # mapping offset granularity (Windows)
+
+# ----------------------------------------------------------------------------
+# Private functions
+# ----------------------------------------------------------------------------
+
+proc cryptWindows(ctx: var XCryptCtx; fi, fo: var MemFile;
+                  iOff, oOff, n: int; window: int) =
+  ## en/decrypt n bytes of fi at iOff into fo at oOff, a window at a time
+  var pos = 0
+  while pos < n:
+    let
+      k  = min(n - pos, window)
+      ia = (iOff + pos) and not (xFileAlign - 1)       # aligned offsets
+      oa = (oOff + pos) and not (xFileAlign - 1)
+      il = iOff + pos - ia + k                         # mapped sizes
+      ol = oOff + pos - oa + k
+      ip = fi.mapMem(fmRead, il, ia)
+    try:
+      let op = fo.mapMem(fmReadWrite, ol, oa)
+      try:
+        when defined(posix):
+          discard posix_madvise(ip, il, POSIX_MADV_SEQUENTIAL)
+          discard posix_madvise(op, ol, POSIX_MADV_SEQUENTIAL)
+
+        ctx.xRawDecryptParallel(cast[pointer](cast[ByteAddress](op) + ol - k),
+                                cast[pointer](cast[ByteAddress](ip) + il - k),
+                                k)
+      finally:
+        fo.unmapMem(op, ol)
+    finally:
+      fi.unmapMem(ip, il)
+    pos.inc(k)
+
+proc dropFile(name: string) =
+  ## remove the partial output file 'name' after an error
+  try:
+    name.removeFile
+  except OSError:
+    discard
+
+proc encryptFile(ctx: var XCryptCtx;
+                 src, dst, hdr: string; window: int): bool =
+  ## write the session header 'hdr' followed by the encrypted file 'src',
+  ## a partial 'dst' is removed if this fails
+  let n = src.getFileSize.int
+  if n == 0:
+    dst.writeFile(hdr)
+  else:
+    var fi = memfiles.open(src, fmRead, min(n, xFileAlign))
+    try:
+      var fo: MemFile
+      try:
+        fo = memfiles.open(dst, fmReadWrite,            # covers the header
+                           max(hdr.len, min(hdr.len + n, xFileAlign)),
+                           newFileSize = hdr.len + n)
+        fo.mem.copyMem(unsafeAddr hdr[0], hdr.len)
+        ctx.cryptWindows(fi, fo, 0, hdr.len, n, window)
+        fo.close
+      except:
+        if not fo.mem.isNil:
+          fo.close
+        dst.dropFile
+        raise
+    finally:
+      fi.close
+  result = true
+
+proc decryptFile(ctx: var XCryptCtx;
+                 src, dst: string; hLen, n: int; window: int): bool =
+  ## decrypt the n bytes after the session header of the file 'src' into
+  ## the file 'dst', a partial 'dst' is removed if this fails
+  if n == 0:
+    dst.writeFile("")
+  else:
+    var fi = memfiles.open(src, fmRead, min(n + hLen, xFileAlign))
+    try:
+      var fo: MemFile
+      try:
+        fo = memfiles.open(dst, fmReadWrite, min(n, xFileAlign),
+                           newFileSize = n)
+        ctx.cryptWindows(fi, fo, hLen, 0, n, window)
+        fo.close
+      except:
+        if not fo.mem.isNil:
+          fo.close
+        dst.dropFile
+        raise
+    finally:
+      fi.close
+  result = true
+
+proc readHeader(src: string): string =
+  ## read the raw session header of the file 'src', the result is empty if
+  ## there is none
+  var f = system.open(src)
+  try:
+    result = newString(xIntroLen)
+    result.setLen(f.readBuffer(addr result[0], xIntroLen))
+    let size = result.xRawHeaderSize
+    if size == 0:
+      result = ""
+    else:
+      result.setLen(size)
+      f.setFilePos(0)
+      if f.readBuffer(addr result[0], size) < size:
+        result = ""
+  finally:
+    f.close
+
+# ----------------------------------------------------------------------------
+# Public functions
+# ----------------------------------------------------------------------------
+
+proc xFileEncrypt*(src, dst: string;
+                   pub: ptr array[3,ptr EccPubKey];
+                   challenge: ptr XPattern;
+                   version = sessHdrLegacy;
+                   window = xFileWindow): bool =
+  ## Encrypt the file 'src' into the new file 'dst' for the (up to three)
+  ## public keys, see getXRawEncrypt() for the arguments. The output is the
+  ## raw session header followed by the cipher data. Returns false if a
+  ## file could not be read or written.
+  var ctx: XCryptCtx
+  try:
+    let hdr = ctx.getXRawEncrypt(pub, challenge, version)
+    result = ctx.encryptFile(src, dst, hdr, window)
+  except OSError, IOError:
+    discard
+  ctx.clearXCrypt
+
+proc xFileEncrypt*(src, dst: string;
+                   pub: openArray[ptr EccPubKey];
+                   challenge: ptr XPattern;
+                   version = sessHdrMulti;
+                   window = xFileWindow): bool =
+  ## Same as xFileEncrypt() above for any number of recipients, the session
+  ## header is xRawHeaderSize() bytes long.
+  var ctx: XCryptCtx
+  try:
+    let hdr = ctx.getXRawEncrypt(pub, challenge, version)
+    result = ctx.encryptFile(src, dst, hdr, window)
+  except OSError, IOError:
+    discard
+  ctx.clearXCrypt
+
+proc xFileDecrypt*(src, dst: string;
+                   prv: ptr EccPrvKey;
+                   challenge: ptr XPattern;
+                   window = xFileWindow): bool =
+  ## Decrypt the file 'src' created by xFileEncrypt() (or any raw xcrypt
+  ## session data) into the new file 'dst'. Returns false if the session
+  ## header does not match the private key, or if a file could not be
+  ## read or written.
+  var ctx: XCryptCtx
+  try:
+    let
+      hdr  = src.readHeader
+      hLen = hdr.len
+      n    = src.getFileSize.int - hLen
+    if 0 < hLen and 0 <= n and 0 < ctx.getXRawDecrypt(hdr, prv, challenge):
+      result = ctx.decryptFile(src, dst, hLen, n, window)
+  except OSError, IOError:
+    result = false
+  ctx.clearXCrypt
+
+# ----------------------------------------------------------------------------
+# Tests
+# ----------------------------------------------------------------------------
+
+when isMainModule:
+
+  var
+    prv: EccPrvKey
+    pub: EccPubKey
+    keys = [addr pub, nil, nil]
+    chl  = "Hello File!".getXVerfier
+    data = newString(3 * xFileAlign + 12345)
+    plain = getTempDir() / "xfile-test.txt"
+    crypt = getTempDir() / "xfile-test.xcr"
+    clear = getTempDir() / "xfile-test.out"
+
+  prv.getEccPrvKey
+  pub.getEccPubKey(addr prv)
+  for n in 0..<data.len:
+    data[n] = ((n * 7 + n div 1000) and 255).chr
+  plain.writeFile(data)
+
+  for window in [xFileWindow, xFileAlign + 17, 1000]:
+    doAssert xFileEncrypt(plain, crypt, addr keys, addr chl, window = window)
+    doAssert crypt.getFileSize == xRawHeaderLen + data.len
+    doAssert xFileDecrypt(crypt, clear, addr prv, addr chl, window = window)
+    doAssert clear.readFile == data
+
+    # same as the in-memory functions
+    var
+      ctx: XCryptCtx
+      enc = crypt.readFile
+      pre = ctx.getXRawDecrypt(enc, addr prv, addr chl)
+    doAssert pre == xRawHeaderLen
+    doAssert ctx.xRawDecrypt(addr enc[pre], enc.len - pre) == data
+
+  # list of recipients, variable header length
+  if true:
+    var
+      other: EccPubKey
+      more: EccPrvKey
+    more.getEccPrvKey
+    other.getEccPubKey(addr more)
+    doAssert xFileEncrypt(plain, crypt, [addr other, addr pub], addr chl)
+    doAssert xFileDecrypt(crypt, clear, addr prv, addr chl)
+    doAssert clear.readFile == data
+    doAssert xFileDecrypt(crypt, clear, addr more, addr chl)
+    doAssert clear.readFile == data
+
+  # session header larger than the first mapping window
+  if true:
+    var
+      many = newSeq[EccPubKey](2100)
+      list = newSeq[ptr EccPubKey](many.len)
+    for n in 0..<many.len:
+      many[n] = pub
+      list[n] = addr many[n]
+    doAssert xFileEncrypt(plain, crypt, list, addr chl)
+    doAssert xFileAlign < crypt.getFileSize - data.len
+    doAssert xFileDecrypt(crypt, clear, addr prv, addr chl)
+    doAssert clear.readFile == data
+
+  # wrong key, empty and missing files
+  var other: EccPrvKey
+  other.getEccPrvKey
+  doAssert not xFileDecrypt(crypt, clear, addr other, addr chl)
+  doAssert not xFileEncrypt(plain, getTempDir() / "xfile-none" / "test.xcr",
+                            addr keys, addr chl)
+  doAssert not xFileDecrypt(crypt, getTempDir() / "xfile-none" / "test.out",
+                            addr prv, addr chl)
+  plain.writeFile("")
+  doAssert xFileEncrypt(plain, crypt, addr keys, addr chl)
+  doAssert xFileDecrypt(crypt, clear, addr prv, addr chl)
+  doAssert clear.readFile == ""
+  doAssert not xFileEncrypt(plain & ".none", crypt, addr keys, addr chl)
+
+  for f in [plain, crypt, clear]:
+    f.removeFile
+
+# ----------------------------------------------------------------------------
+# End
+# ----------------------------------------------------------------------------
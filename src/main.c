@@ -44,6 +44,9 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 /* see kris kristofferson: to beat the devil */
 static char kk [] =
@@ -55,8 +58,82 @@ static char kk [] =
 
 static void *prv_key, *pub_key, *plain_text, *cipher_text ;
 
+/* key files hold the raw key bytes */
+static unsigned char key_buf [64];
+
+/* a new key file is created with the given access mode, an existing
+ * file is never overwritten */
+static int save_key (const char *path, void *key, int mode)
+{
+	int fd = open (path, O_WRONLY|O_CREAT|O_EXCL, mode);
+	FILE *f = fd < 0 ? 0 : fdopen (fd, "wb");
+	int ok = f != 0 && fwrite (key, keylen (), 1, f) == 1;
+
+	if (f == 0 && fd >= 0)
+		close (fd);
+	if (f != 0 && fclose (f) != 0)
+		ok = 0 ;
+	if (!ok)
+		fprintf (stderr, "*** Cannot write key file %s\n", path);
+	return ok ;
+}
+
+static void *load_key (const char *path)
+{
+	FILE *f = fopen (path, "rb");
+	int ok = f != 0 && fread (key_buf, keylen (), 1, f) == 1;
+
+	if (f != 0)
+		fclose (f);
+	if (!ok) {
+		fprintf (stderr, "*** Cannot read key file %s\n", path);
+		return 0 ;
+	}
+	return key_buf ;
+}
+
+/* file modes: en/decrypt memory mapped files of any size */
+static int file_main (int argc, char**argv)
+{
+	void *key ;
+	int rc ;
+
+	if (argc == 4 && strcmp (argv [1], "keygen") == 0) {
+		prv_key = prvkey ();
+		pub_key = pubkey (prv_key);
+		rc = save_key (argv [2], prv_key, 0600) &&
+			save_key (argv [3], pub_key, 0644);
+		freekey (prv_key);
+		freekey (pub_key);
+		return rc ? 0 : 1 ;
+	}
+
+	if (argc == 5 && strcmp (argv [1], "encrypt") == 0) {
+		if ((key = load_key (argv [2])) == 0)
+			return 1 ;
+		rc = file_encrypt (argv [3], argv [4], key);
+	}
+	else if (argc == 5 && strcmp (argv [1], "decrypt") == 0) {
+		if ((key = load_key (argv [2])) == 0)
+			return 1 ;
+		rc = file_decrypt (argv [3], argv [4], key);
+	}
+	else {
+		return -1 ;
+	}
+
+	memset (key_buf, 0, sizeof (key_buf));
+	if (rc < 0) {
+		fprintf (stderr, "*** %s %s => %s failed\n",
+			 argv [1], argv [3], argv [4]);
+		return 1 ;
+	}
+	return 0 ;
+}
+
 int main(int argc, char**argv)
 {
+	int rc ;
 	char *text = argc < 2
 		? kk
 		: argv [1]
@@ -64,6 +141,9 @@ int main(int argc, char**argv)
 
 	NimMain ();
 
+	if (1 < argc && (rc = file_main (argc, argv)) >= 0)
+		return rc ;
+
 	/* generate keys */
 	prv_key = prvkey ();
 	pub_key = pubkey (prv_key);
@@ -81,7 +161,11 @@ int main(int argc, char**argv)
 
 	/* done */
 	printf ("\n*** Now try again with another message\n\n"
-		"Usage: %s <message>\n", argv [0]);
+		"Usage: %s <message>\n"
+		"       %s keygen <prvkey-file> <pubkey-file>\n"
+		"       %s encrypt <pubkey-file> <infile> <outfile>\n"
+		"       %s decrypt <prvkey-file> <infile> <outfile>\n",
+		argv [0], argv [0], argv [0], argv [0]);
 
 	freekey (prv_key);
 	freekey (pub_key);
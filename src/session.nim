@@ -31,7 +31,7 @@
 #
 
 import
-  xcrypt
+  xcrypt, xfile
 
 # ----------------------------------------------------------------------------
 # Private functions
@@ -82,12 +82,31 @@ proc pubkey*(prvKey: pointer): pointer {.exportc.} =
 proc freekey*(key: pointer) {.exportc.} =
   key.dealloc
 
+proc keylen*: cint {.exportc.} =
+  assert sizeof(EccPrvKey) == sizeof(EccPubKey)
+  sizeof(EccPrvKey).cint
+
+proc file_encrypt*(src, dst: cstring; pub: pointer): cint {.exportc.} =
+  ## encrypt file src => dst, returns 0 on success and -1 on error
+  var
+    keys = [cast[ptr EccPubKey](pub), nil, nil]
+    chl  = getXVerfier()
+  if xFileEncrypt($src, $dst, addr keys, addr chl): 0 else: -1
+
+proc file_decrypt*(src, dst: cstring; prv: pointer): cint {.exportc.} =
+  ## decrypt file src => dst, returns 0 on success and -1 on error
+  var chl = getXVerfier()
+  if xFileDecrypt($src, $dst, cast[ptr EccPrvKey](prv), addr chl): 0 else: -1
+
 # ----------------------------------------------------------------------------
 # Tests
 # ----------------------------------------------------------------------------
 
 when isMainModule:
 
+  import
+    os
+
   const
     txt = "Hi There"
   let
@@ -97,6 +116,17 @@ when isMainModule:
 
   doAssert txt == b64.b64_decrypt(prv)
 
+  block:
+    let
+      plain = getTempDir() / "session-test.txt"
+      crypt = getTempDir() / "session-test.xcr"
+    plain.writeFile(txt)
+    doAssert plain.file_encrypt(crypt, pub) == 0
+    doAssert crypt.file_decrypt(plain, prv) == 0
+    doAssert plain.readFile == txt
+    plain.removeFile
+    crypt.removeFile
+
   when not defined(check_run):
     echo "*** compiles OK"
 